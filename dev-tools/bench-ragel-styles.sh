@@ -0,0 +1,24 @@
+#!/bin/bash
+# Builds and runs bench_parser once for each ragel code style, so you can
+# see which is fastest on your machine and compiler.
+#
+# usage: dev-tools/bench-ragel-styles.sh [iterations [page.html]]
+#
+# Needs ragel on the path. Builds in /tmp/cdnalizer-bench-*.
+set -e
+
+source_dir=$(cd "$(dirname "$0")/.." && pwd)
+
+for style in -F1 -T0 -G2; do
+    build_dir=/tmp/cdnalizer-bench${style}
+    cmake -S "$source_dir" -B "$build_dir" -DCMAKE_BUILD_TYPE=Release \
+          -DRAGEL_CODE_STYLE=$style > /dev/null
+    cmake --build "$build_dir" --target bench_parser > /dev/null
+    echo "== ragel $style"
+    "$build_dir/src/parser/bench_parser" "$@"
+done
+
+# The generated headers go in the source tree, so put back each machine's
+# default style
+cmake -S "$source_dir" -B /tmp/cdnalizer-bench-default -DRAGEL_CODE_STYLE= > /dev/null
+cmake --build /tmp/cdnalizer-bench-default --target parser_code_generated > /dev/null
@@ -4,9 +4,94 @@
  **/
 #include "Config.hpp"
 
+#include <cstdint>
+
 namespace cdnalizer {
 
 /// Make sure the empty string is an empty string
 const std::string Config::empty = {};
 
+std::atomic<unsigned long> Config::lastGeneration{0};
+
+std::string Config::originOf(const std::string &url) {
+  size_t host = url.find("://");
+  if ((host != std::string::npos) &&
+      (url.find_first_of("/?#") < host))
+    host = std::string::npos;
+  if (host != std::string::npos)
+    host += 3;
+  else if (url.compare(0, 2, "//") == 0)
+    host = 2; // Protocol relative
+  else
+    return {};
+  size_t end = std::min(url.find_first_of("/?#", host), url.size());
+  // A wildcard capture; there's no telling which host it'll be
+  if ((end == host) || (url.find('$', host) < end))
+    return {};
+  return url.substr(0, end);
+}
+
+void Config::collectOrigins() {
+  cdnOrigins.clear();
+  auto add = [this](const std::string &url) {
+    std::string origin = originOf(url);
+    if (!origin.empty() &&
+        (std::find(cdnOrigins.begin(), cdnOrigins.end(), origin) ==
+         cdnOrigins.end()))
+      cdnOrigins.push_back(std::move(origin));
+  };
+  for (size_t i = 0; i != entries.size(); ++i)
+    for (size_t host = 0; host != hosts(i); ++host)
+      add(url(i, host));
+  for (const auto &pattern : path_patterns)
+    add(pattern.second);
+}
+
+size_t Config::pickHost(const std::string &path, size_t hosts) {
+  // FNV-1a over the path, without its query string or fragment
+  std::uint64_t key = 14695981039346656037ull;
+  for (char c : path) {
+    if ((c == '?') || (c == '#'))
+      break;
+    key = (key ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+  }
+  // Lamping and Veach's jump consistent hash
+  std::int64_t bucket = -1;
+  std::int64_t next = 0;
+  while (next < static_cast<std::int64_t>(hosts)) {
+    bucket = next;
+    key = key * 2862933555777941757ull + 1;
+    next = static_cast<std::int64_t>((bucket + 1) *
+                                     (static_cast<double>(1ll << 31) /
+                                      static_cast<double>((key >> 33) + 1)));
+  }
+  return static_cast<size_t>(bucket);
+}
+
+size_t Config::versionSplice(const std::string &path,
+                             std::string &insert) const {
+  if ((versioning == Versioning::off) || !uploaded)
+    return std::string::npos;
+  std::string version = uploaded->version(path);
+  if (version.empty())
+    return std::string::npos;
+  size_t end = std::min(path.find_first_of("?#"), path.size());
+  if (versioning == Versioning::query) {
+    // After any query string, before any fragment
+    bool hasQuery = (end != path.size()) && (path[end] == '?');
+    insert.assign(hasQuery ? "&v=" : "?v=");
+    insert.append(version);
+    return std::min(path.find('#'), path.size());
+  }
+  // Before the file name's extension; 'a.b.png' becomes 'a.b.3f9a1c.png'
+  insert.assign(".");
+  insert.append(version);
+  size_t name = (end == 0) ? 0 : path.rfind('/', end - 1) + 1;
+  size_t dot = (end == 0) ? std::string::npos : path.rfind('.', end - 1);
+  // Files like '.htaccess' or 'LICENSE' get it on the end
+  if ((dot == std::string::npos) || (dot <= name))
+    return end;
+  return dot;
+}
+
 }
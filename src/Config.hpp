@@ -17,7 +17,14 @@
 #include <string>
 #include <map>
 #include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
 
+#include "Manifest.hpp"
+#include "PathClassifier.hpp"
+#include "Wildcards.hpp"
 #include "pair.hpp"
 #include "utils.hpp"
 
@@ -32,6 +39,13 @@ using Container = std::map<std::string, std::string>;
 
 namespace cdnalizer {
 
+/// Where a path's manifest version goes in the urls we send to the CDN
+enum class Versioning {
+  off,   // Nowhere
+  query, // In the query string: /images/logo.png?v=3f9a1c
+  name   // In the file name: /images/logo.3f9a1c.png
+};
+
 class Config {
 public:
   /// A Pair type that *holds* 2 strings - used for search parameters
@@ -44,17 +58,96 @@ private:
   std::string base_location;
   /// Map of paths to urls, eg. {{"/images/", "http://cdn.supa.ws/images/"}}
   Container path_url;
+  /// Keys spread over several cdn urls (hosts), and all of those urls; the
+  /// first is also in path_url
+  std::map<std::string, std::vector<std::string>> path_hosts;
+  /// Keys with wildcards in them, and their cdn urls
+  Container path_patterns;
+  /// path_patterns compiled; nullptr if there are none. Copies share it.
+  std::shared_ptr<const Wildcards> wildcards;
+  /// Which paths are static, and so can go to the CDN
+  PathClassifier paths;
+  /// When set, only the paths in it are really on the CDN
+  std::shared_ptr<const Manifest> uploaded;
+  /// Where to put the manifest's versions
+  Versioning versioning = Versioning::off;
+  /// path_url in key order, so entries can be referred to by number
+  std::vector<Container::const_iterator> entries;
+  /// Each entry's path_hosts urls, or nullptr if it only has the one
+  std::vector<const std::vector<std::string> *> entryHosts;
+  /// Every cdn url's origin, once each; see origins()
+  std::vector<std::string> cdnOrigins;
+  /// A hash of everything in this config, see fingerprint()
+  size_t hash = 0;
+  /// Which version of the mappings this is, see generation()
+  unsigned long gen;
   static const std::string empty;
+  /// The last generation number handed out, process wide
+  static std::atomic<unsigned long> lastGeneration;
+  /// Call after every change: recompiles and takes a new generation number
+  void changed() {
+    compile();
+    gen = ++lastGeneration;
+  }
+  /// Rebuilds everything we derive from path_url
+  void compile() {
+    entries.clear();
+    entries.reserve(path_url.size());
+    entryHosts.clear();
+    entryHosts.reserve(path_url.size());
+    std::hash<std::string> hasher;
+    hash = hasher(base_location);
+    for (auto i = path_url.cbegin(); i != path_url.cend(); ++i) {
+      entries.push_back(i);
+      auto hosts = path_hosts.find(i->first);
+      entryHosts.push_back(hosts == path_hosts.end() ? nullptr
+                                                     : &hosts->second);
+      // boost::hash_combine's mixing
+      hash ^= hasher(i->first) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+      hash ^= hasher(i->second) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+      if (entryHosts.back() != nullptr)
+        for (const auto &url : *entryHosts.back())
+          hash ^= hasher(url) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    }
+    for (const auto &pattern : path_patterns) {
+      hash ^= hasher(pattern.first) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+      hash ^= hasher(pattern.second) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    }
+    hash ^= paths.hash() + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    if (uploaded)
+      hash ^= uploaded->fingerprint() + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    hash ^= static_cast<size_t>(versioning) + 0x9e3779b9 + (hash << 6) +
+            (hash >> 2);
+    collectOrigins();
+  }
+  /// Fills in cdnOrigins
+  void collectOrigins();
+  /// Rebuilds the DFA for path_patterns
+  void compilePatterns() {
+    if (path_patterns.empty())
+      wildcards.reset();
+    else
+      wildcards = std::make_shared<const Wildcards>(path_patterns);
+  }
   /// finds the best candidate for a match
   /// @returns the value or two empty strings if nothing is found
   CDNRefPair search(const Container &container, const std::string &path) const {
     // upper_bound always returns one after the one we want,
     // wether the key is an exact match or not
     auto result = upper_bound(container.cbegin(), container.cend(), path);
-    if (result == container.cbegin())
-      return {{}, {}};
-    --result;
-    return *result;
+    while (result != container.cbegin()) {
+      --result;
+      const std::string &key = result->first;
+      auto common = utils::mismatch(key.cbegin(), key.cend(), path.cbegin(),
+                                    path.cend());
+      if (common.first == key.cend())
+        return *result;
+      // It's just a neighbour, eg. '/images' for '/index.html'. Any key
+      // that is a prefix of path must be a prefix of what they share too.
+      result = upper_bound(container.cbegin(), result,
+                           std::string(path.cbegin(), common.second));
+    }
+    return {empty, empty};
   }
   /// Absolutelize a path/url in place
   void absolutelize(std::string &path) {
@@ -78,23 +171,188 @@ public:
   Config(Container &&path_url = {}, const char *base_location = "/")
       : base_location{base_location}, path_url(path_url) {
     ensureSlashOnEnd();
+    for (auto i = this->path_url.begin(); i != this->path_url.end();) {
+      if (Wildcards::isPattern(i->first)) {
+        path_patterns.insert(*i);
+        i = this->path_url.erase(i);
+      } else {
+        ++i;
+      }
+    }
+    compilePatterns();
+    changed();
+  }
+  /** Copy constructor. The copy has the same generation, as it holds the same
+   * mappings */
+  Config(const Config &other)
+      : base_location(other.base_location), path_url(other.path_url),
+        path_hosts(other.path_hosts), path_patterns(other.path_patterns),
+        wildcards(other.wildcards),
+        paths(other.paths), uploaded(other.uploaded),
+        versioning(other.versioning), gen(other.gen) {
+    compile();
+  }
+  Config &operator=(const Config &other) {
+    base_location = other.base_location;
+    path_url = other.path_url;
+    path_hosts = other.path_hosts;
+    path_patterns = other.path_patterns;
+    wildcards = other.wildcards;
+    paths = other.paths;
+    uploaded = other.uploaded;
+    versioning = other.versioning;
+    compile();
+    gen = other.gen;
+    return *this;
   }
-  /** Copy constructor */
-  Config(const Config &) = default;
   /// Finds the apprpriate path base. If you're searching for /images/abc.gif,
   /// and we have '/images' in the config you'll get that.
   /// @return the key that was matched, and the CDN url for that we should be
   ///         serving. If nothing is found, return two empty strings
   CDNRefPair findCDNUrl(const std::string &path) const {
+    // Relative paths are relative to our base, just like our keys
+    if (utils::is_relative(path.cbegin(), path.cend()))
+      return search(path_url, base_location + path);
     return search(path_url, path);
   }
-  /// Add a path-url pair, for later lookup
+  /** Finds the best wildcard key that matches the start of @a path.
+   *
+   * @param url set to its cdn url, with the wildcards' captures in it
+   * @param length set to how much of @a path it matched
+   * @returns the key, or nullptr if none match
+   */
+  const std::string *findPattern(const std::string &path, std::string &url,
+                                 size_t &length) const {
+    if (!wildcards)
+      return nullptr;
+    if (!utils::is_relative(path.cbegin(), path.cend()))
+      return wildcards->find(path, url, length);
+    const std::string *key = wildcards->find(base_location + path, url, length);
+    if ((key == nullptr) || (length <= base_location.size()))
+      return nullptr;
+    length -= base_location.size();
+    return key;
+  }
+  /// @returns true if we have any wildcard keys
+  bool hasPatterns() const { return static_cast<bool>(wildcards); }
+  /// Add a path-url pair, for later lookup. A path with a '*' in it is a
+  /// pattern, see Wildcards.hpp.
   void addPath(std::string path, std::string url) {
     absolutelize(path);
     absolutelize(url); // NOTE: Someone may change ./css/ to ./resources/css ..
                        // might not be http://some.cdn/css
-    path_url.insert(std::make_pair(path, url));
+    if (Wildcards::isPattern(path)) {
+      path_patterns.insert(std::make_pair(path, url));
+      compilePatterns();
+    } else {
+      path_url.insert(std::make_pair(path, url));
+    }
+    changed();
   }
+  /** Adds @a url as another cdn url for @a path. Files under a path with
+   * several urls are spread over them, each always going to the same one.
+   * If @a path is new, this is just addPath(). Wildcard keys only get their
+   * first url.
+   */
+  void addHost(std::string path, std::string url) {
+    absolutelize(path);
+    absolutelize(url);
+    auto found = path_url.find(path);
+    if ((found == path_url.end()) || Wildcards::isPattern(path))
+      return addPath(std::move(path), std::move(url));
+    auto &hosts = path_hosts[path];
+    if (hosts.empty())
+      hosts.push_back(found->second);
+    hosts.push_back(std::move(url));
+    changed();
+  }
+  /// @returns how many cdn urls the entry at @a index is spread over
+  size_t hosts(size_t index) const {
+    return entryHosts.at(index) ? entryHosts[index]->size() : 1;
+  }
+  /** Picks which of entry @a index's cdn urls @a path goes to, with a jump
+   * consistent hash of the path (without its query string). Adding a host
+   * only moves the paths that go to the new one.
+   *
+   * @param path a canonical path
+   * @returns the host number, for url()
+   */
+  size_t hostOf(size_t index, const std::string &path) const {
+    return entryHosts[index] ? pickHost(path, entryHosts[index]->size()) : 0;
+  }
+  /// @returns cdn url number @a host of the entry at @a index
+  const std::string &url(size_t index, size_t host) const {
+    return entryHosts[index] ? (*entryHosts[index])[host]
+                             : entries[index]->second;
+  }
+  /// @returns the origin (eg. 'https://cdn.supa.ws') of each of our cdn urls,
+  /// once each. Urls on our own server, and wildcard urls with a capture in
+  /// the host, have none.
+  const std::vector<std::string> &origins() const { return cdnOrigins; }
+  /// @returns the scheme, host and port of @a url, or "" if it doesn't have
+  /// a host of its own
+  static std::string originOf(const std::string &url);
+  /// @returns true if @a path (a canonical path, or url) can go to the CDN
+  bool isStatic(const std::string &path) const { return paths.isStatic(path); }
+  /// The rules for which paths are static
+  const PathClassifier &classifier() const { return paths; }
+  void setClassifier(PathClassifier classifier) {
+    paths = std::move(classifier);
+    changed();
+  }
+  /// @returns true if @a path (a canonical path, or url) has been uploaded to
+  /// the CDN; always true when we have no manifest
+  bool isUploaded(const std::string &path) const {
+    return !uploaded || uploaded->contains(path);
+  }
+  /// The manifest of uploaded paths, or nullptr if we don't check
+  const std::shared_ptr<const Manifest> &manifest() const { return uploaded; }
+  void setManifest(std::shared_ptr<const Manifest> manifest) {
+    uploaded = std::move(manifest);
+    changed();
+  }
+  void setVersioning(Versioning style) {
+    versioning = style;
+    changed();
+  }
+  /** Works out where the manifest version of @a path goes in its cdn url.
+   *
+   * @param path a canonical path
+   * @param insert set to what to put there, eg. "?v=3f9a1c"
+   * @returns the index in @a path to insert it at, or std::string::npos if
+   *          it doesn't get a version
+   */
+  size_t versionSplice(const std::string &path, std::string &insert) const;
+  /// @returns which of @a hosts buckets @a path goes in
+  static size_t pickHost(const std::string &path, size_t hosts);
+  /// @returns the number of plain (not wildcard) path-url pairs we hold
+  size_t size() const { return entries.size(); }
+  /// @returns the path-url pair at @a index (in key order); the url is its
+  /// first, if it has several
+  CDNRefPair entry(size_t index) const {
+    const auto &found = *entries.at(index);
+    return {found.first, found.second};
+  }
+  /// @returns the index of the entry with key @a path, or size() if there
+  /// isn't one
+  size_t indexOf(const std::string &path) const {
+    auto found = std::lower_bound(
+        entries.cbegin(), entries.cend(), path,
+        [](Container::const_iterator a, const std::string &b) {
+          return a->first < b;
+        });
+    if ((found == entries.cend()) || ((*found)->first != path))
+      return size();
+    return found - entries.cbegin();
+  }
+  /// A hash of the whole configuration. Two configs with the same
+  /// fingerprint (almost certainly) rewrite everything the same way, even in
+  /// different processes.
+  size_t fingerprint() const { return hash; }
+  /// Changes every time a config is built or modified, and is never reused
+  /// in this process. Copies share their original's generation. Handy for
+  /// keying anything derived from a config.
+  unsigned long generation() const { return gen; }
   /// Include the values from another config object
   Config &operator+=(const Config &other) {
     for (auto pair : other.path_url) {
@@ -102,7 +360,23 @@ public:
       // If it was already there, update the value
       if (!inserted.second)
         inserted.first->second = pair.second;
+      auto hosts = other.path_hosts.find(pair.first);
+      if (hosts != other.path_hosts.end())
+        path_hosts[pair.first] = hosts->second;
+      else
+        path_hosts.erase(pair.first);
+    }
+    if (!other.path_patterns.empty()) {
+      for (const auto &pair : other.path_patterns)
+        path_patterns[pair.first] = pair.second;
+      compilePatterns();
     }
+    paths += other.paths;
+    if (other.uploaded)
+      uploaded = other.uploaded;
+    if (other.versioning != Versioning::off)
+      versioning = other.versioning;
+    changed();
     return *this;
   }
 };
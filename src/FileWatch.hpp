@@ -0,0 +1,83 @@
+#pragma once
+/** Decides when a file we've loaded should be looked at again
+ *
+ * Used by MappingFile and ManifestFile. At most once per interval, one
+ * thread gets to stat() the file; every other thread is told not to bother,
+ * without waiting on a lock.
+ *
+ * © Copyright 2017 Matthew Sherborne. All Rights Reserved.
+ * License: Apache License, Version 2.0 (See LICENSE.txt)
+ **/
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+#include <sys/stat.h>
+
+namespace cdnalizer {
+
+class FileWatch {
+public:
+  /// What a refresh() of a watched file did
+  enum class Reload { none, reloaded, failed };
+  /// What a file looked like when we loaded it
+  struct Stamp {
+    long long mtime = -1; // nanoseconds
+    long long size = -1;
+    unsigned long long inode = 0;
+    bool operator==(const Stamp &other) const {
+      return (mtime == other.mtime) && (size == other.size) &&
+             (inode == other.inode);
+    }
+    /// Reads @a filename's stamp into @a result
+    /// @returns false (with errno set) if we can't stat it
+    static bool read(const std::string &filename, Stamp &result) {
+      struct stat info;
+      if (stat(filename.c_str(), &info) != 0)
+        return false;
+      result.mtime = static_cast<long long>(info.st_mtim.tv_sec) * 1000000000 +
+                     info.st_mtim.tv_nsec;
+      result.size = info.st_size;
+      result.inode = info.st_ino;
+      return true;
+    }
+  };
+
+private:
+  const std::chrono::steady_clock::duration interval;
+  /// Set while one thread is checking the file; nobody else needs to
+  std::atomic<bool> checking{false};
+  /// When the next check is due, in steady_clock ticks
+  std::atomic<std::chrono::steady_clock::rep> nextCheck;
+
+  void schedule() {
+    nextCheck.store((std::chrono::steady_clock::now() + interval)
+                        .time_since_epoch()
+                        .count(),
+                    std::memory_order_relaxed);
+  }
+
+public:
+  explicit FileWatch(std::chrono::steady_clock::duration interval)
+      : interval(interval) {
+    schedule();
+  }
+  FileWatch(const FileWatch &) = delete;
+  FileWatch &operator=(const FileWatch &) = delete;
+
+  /// @returns true if it's time to check the file and no other thread is.
+  /// If it does, call done() when you've finished checking.
+  bool begin() {
+    auto now = std::chrono::steady_clock::now().time_since_epoch().count();
+    if (now < nextCheck.load(std::memory_order_relaxed))
+      return false;
+    return !checking.exchange(true, std::memory_order_acquire);
+  }
+  /// Lets the next check happen, an interval from now
+  void done() {
+    schedule();
+    checking.store(false, std::memory_order_release);
+  }
+};
+}
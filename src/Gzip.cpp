@@ -0,0 +1,128 @@
+/**
+ * © Copyright 2017 Matthew Sherborne. All Rights Reserved.
+ * License: Apache License, Version 2.0 (See LICENSE.txt)
+ **/
+#include "Gzip.hpp"
+
+#include <cstring>
+#include <limits>
+
+namespace cdnalizer {
+namespace gzip {
+
+// zlib wants non-const input pointers, even though it never writes to them
+inline Bytef *zIn(const char *data) {
+  return reinterpret_cast<Bytef *>(const_cast<char *>(data));
+}
+
+void Inflater::init(int windowBits) {
+  std::memset(&stream, 0, sizeof(stream));
+  int code = inflateInit2(&stream, windowBits);
+  if (code != Z_OK)
+    throw ZlibError(code, stream.msg);
+}
+
+// 15 is the biggest window; +32 means detect gzip or zlib headers
+Inflater::Inflater() { init(15 + 32); }
+
+Inflater::~Inflater() { inflateEnd(&stream); }
+
+bool Inflater::feed(const char *data, size_t size, const ChunkEvent &onChunk) {
+  feed(data, size, std::numeric_limits<size_t>::max(), onChunk);
+  return finished;
+}
+
+size_t Inflater::feed(const char *data, size_t size, size_t most,
+                      const ChunkEvent &onChunk) {
+  if (finished || (size == 0))
+    return size;
+  stream.next_in = zIn(data);
+  stream.avail_in = size;
+  size_t total = 0;
+  // A full output buffer means there may be more to come, even once all the
+  // input is in; a highly compressed tail can be many buffers long
+  while (((stream.avail_in != 0) || (stream.avail_out == 0)) &&
+         (total < most)) {
+    stream.next_out = reinterpret_cast<Bytef *>(out.data());
+    stream.avail_out = out.size();
+    int code = inflate(&stream, Z_NO_FLUSH);
+    if ((code == Z_DATA_ERROR) && !started && !triedRaw) {
+      // No header we recognize; try again treating it as raw deflate data
+      triedRaw = true;
+      inflateEnd(&stream);
+      init(-15);
+      stream.next_in = zIn(data);
+      stream.avail_in = size;
+      continue;
+    }
+    if ((code != Z_OK) && (code != Z_STREAM_END) && (code != Z_BUF_ERROR))
+      throw ZlibError(code, stream.msg);
+    started = true;
+    size_t produced = out.size() - stream.avail_out;
+    total += produced;
+    if (produced != 0)
+      onChunk(out.data(), produced);
+    if (code == Z_STREAM_END) {
+      finished = true;
+      // Anything after the end is ignored, so it's all used
+      return size;
+    }
+    // Z_BUF_ERROR with output space left means it needs more input
+    if ((code == Z_BUF_ERROR) && (produced == 0))
+      break;
+  }
+  return size - stream.avail_in;
+}
+
+void Inflater::finish(const ChunkEvent &onChunk) {
+  if (finished || !started)
+    return;
+  stream.next_in = Z_NULL;
+  stream.avail_in = 0;
+  do {
+    stream.next_out = reinterpret_cast<Bytef *>(out.data());
+    stream.avail_out = out.size();
+    int code = inflate(&stream, Z_NO_FLUSH);
+    if ((code != Z_OK) && (code != Z_STREAM_END) && (code != Z_BUF_ERROR))
+      throw ZlibError(code, stream.msg);
+    size_t produced = out.size() - stream.avail_out;
+    if (produced != 0)
+      onChunk(out.data(), produced);
+    if (code == Z_STREAM_END)
+      finished = true;
+  } while (!finished && (stream.avail_out == 0));
+}
+
+Deflater::Deflater(Format format, int level) {
+  std::memset(&stream, 0, sizeof(stream));
+  // 15 is the biggest window; +16 means write a gzip header and trailer
+  int windowBits = format == Format::gzip ? 15 + 16 : 15;
+  int code = deflateInit2(&stream, level, Z_DEFLATED, windowBits, 8,
+                          Z_DEFAULT_STRATEGY);
+  if (code != Z_OK)
+    throw ZlibError(code, stream.msg);
+}
+
+Deflater::~Deflater() { deflateEnd(&stream); }
+
+void Deflater::run(const char *data, size_t size, int flush,
+                   const ChunkEvent &onChunk) {
+  if (finished)
+    throw ZlibError(Z_STREAM_ERROR, "Data given after the stream ended");
+  stream.next_in = zIn(data);
+  stream.avail_in = size;
+  // Keep going until zlib stops filling our whole output buffer
+  do {
+    stream.next_out = reinterpret_cast<Bytef *>(out.data());
+    stream.avail_out = out.size();
+    int code = deflate(&stream, flush);
+    if ((code != Z_OK) && (code != Z_STREAM_END) && (code != Z_BUF_ERROR))
+      throw ZlibError(code, stream.msg);
+    size_t produced = out.size() - stream.avail_out;
+    if (produced != 0)
+      onChunk(out.data(), produced);
+  } while (stream.avail_out == 0);
+}
+
+}
+}
@@ -0,0 +1,110 @@
+#pragma once
+/** Streaming zlib wrappers, so compressed bodies can be rewritten in chunks
+ *
+ * Neither class ever holds more than its zlib window and one output chunk, so
+ * memory use doesn't grow with the size of the body.
+ *
+ * © Copyright 2017 Matthew Sherborne. All Rights Reserved.
+ * License: Apache License, Version 2.0 (See LICENSE.txt)
+ **/
+
+#include <array>
+#include <functional>
+#include <stdexcept>
+#include <string>
+
+#include <zlib.h>
+
+namespace cdnalizer {
+namespace gzip {
+
+/// The two Content-Encodings we know how to deal with
+enum class Format {
+  gzip,   // RFC 1952 - 'Content-Encoding: gzip'
+  deflate // RFC 1950 zlib wrapper - 'Content-Encoding: deflate'
+};
+
+/// Fired for every chunk of output a z stream produces. The data is only valid
+/// for the duration of the call
+using ChunkEvent = std::function<void(const char *data, size_t size)>;
+
+/// The size of the output chunks we hand to ChunkEvent
+constexpr size_t chunkSize = 8000;
+
+/// Turns a zlib error code into a c++ exception
+class ZlibError : public std::runtime_error {
+public:
+  const int code;
+  ZlibError(int code, const char *msg)
+      : std::runtime_error(std::string("zlib: ") + (msg ? msg : "error")),
+        code(code) {}
+};
+
+/// Decompresses a gzip or zlib stream; the format is detected from the header.
+/// If the upstream sends raw deflate data (as some old servers do for
+/// 'Content-Encoding: deflate') we fall back to that.
+class Inflater {
+private:
+  z_stream stream;
+  std::array<char, chunkSize> out;
+  bool started = false;
+  bool finished = false;
+  bool triedRaw = false;
+  void init(int windowBits);
+
+public:
+  Inflater();
+  Inflater(const Inflater &) = delete;
+  Inflater &operator=(const Inflater &) = delete;
+  ~Inflater();
+  /// Decompresses @a size bytes, firing @a onChunk for each chunk of output.
+  /// Anything after the end of the compressed stream is ignored.
+  /// @returns true once the end of the compressed stream has been seen
+  bool feed(const char *data, size_t size, const ChunkEvent &onChunk);
+  /// Like feed(), but stops once it has produced @a most bytes or more, so
+  /// a small input can't inflate into an unbounded amount of output.
+  /// @returns how many bytes of @a data it used; feed it the rest later
+  size_t feed(const char *data, size_t size, size_t most,
+              const ChunkEvent &onChunk);
+  /// Fires @a onChunk for any output zlib is still holding, at the end of
+  /// the input
+  void finish(const ChunkEvent &onChunk);
+  /// @returns true once the end of the compressed stream has been seen
+  bool done() const { return finished; }
+};
+
+/// Compresses a stream into gzip or zlib format
+class Deflater {
+private:
+  z_stream stream;
+  std::array<char, chunkSize> out;
+  bool finished = false;
+  void run(const char *data, size_t size, int flush,
+           const ChunkEvent &onChunk);
+
+public:
+  /// @param level zlib compression level, 1-9, or Z_DEFAULT_COMPRESSION
+  Deflater(Format format, int level = Z_DEFAULT_COMPRESSION);
+  Deflater(const Deflater &) = delete;
+  Deflater &operator=(const Deflater &) = delete;
+  ~Deflater();
+  /// Compresses some data. Output is only produced as zlib's buffers fill.
+  void feed(const char *data, size_t size, const ChunkEvent &onChunk) {
+    run(data, size, Z_NO_FLUSH, onChunk);
+  }
+  /// Pushes out everything we've been given so far, on a byte boundary,
+  /// without ending the stream
+  void flush(const ChunkEvent &onChunk) {
+    run(nullptr, 0, Z_SYNC_FLUSH, onChunk);
+  }
+  /// Ends the stream, writing the trailer
+  void finish(const ChunkEvent &onChunk) {
+    if (!finished)
+      run(nullptr, 0, Z_FINISH, onChunk);
+    finished = true;
+  }
+  bool done() const { return finished; }
+};
+
+}
+}
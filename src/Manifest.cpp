@@ -0,0 +1,235 @@
+/**
+ * © Copyright 2017 Matthew Sherborne. All Rights Reserved.
+ * License: Apache License, Version 2.0 (See LICENSE.txt)
+ **/
+#include "Manifest.hpp"
+#include "utils.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <sstream>
+
+namespace cdnalizer {
+
+namespace {
+
+/// Bloom filter bits per path; with 4 probes that's about 1% false positives
+constexpr size_t bloomBits = 10;
+constexpr int bloomProbes = 4;
+
+size_t powerOfTwoAtLeast(size_t n) {
+  size_t result = 1;
+  while (result < n)
+    result <<= 1;
+  return result;
+}
+
+/// @returns how much of @a path is the path, without a query or fragment
+size_t pathLength(const std::string &path) {
+  auto end = path.find_first_of("?#");
+  return end == std::string::npos ? path.size() : end;
+}
+
+/// @returns true for the bytes RFC 3986 calls unreserved
+bool isUnreserved(unsigned char c) {
+  return std::isalnum(c) || (c == '-') || (c == '.') || (c == '_') ||
+         (c == '~');
+}
+
+/// @returns true for the bytes a path can have as they are
+bool isPlain(unsigned char c) {
+  return isUnreserved(c) || (std::strchr("!$&'()*+,;=:@/", c) && (c != 0));
+}
+
+int hexValue(char c) {
+  if ((c >= '0') && (c <= '9'))
+    return c - '0';
+  if ((c >= 'a') && (c <= 'f'))
+    return c - 'a' + 10;
+  if ((c >= 'A') && (c <= 'F'))
+    return c - 'A' + 10;
+  return -1;
+}
+
+/// @returns true if encode() would change [path, path + length)
+bool needsEncoding(const char *path, size_t length) {
+  for (size_t i = 0; i != length; ++i) {
+    unsigned char c = path[i];
+    if ((c == '%') && (i + 2 < length) && (hexValue(path[i + 1]) >= 0) &&
+        (hexValue(path[i + 2]) >= 0)) {
+      int value = hexValue(path[i + 1]) * 16 + hexValue(path[i + 2]);
+      if (isUnreserved(static_cast<unsigned char>(value)) ||
+          std::islower(static_cast<unsigned char>(path[i + 1])) ||
+          std::islower(static_cast<unsigned char>(path[i + 2])))
+        return true;
+      i += 2;
+    } else if (!isPlain(c)) {
+      return true;
+    }
+  }
+  return false;
+}
+}
+
+std::string Manifest::encode(const char *path, size_t length,
+                             bool isFileName) {
+  static const char hex[] = "0123456789ABCDEF";
+  std::string result;
+  result.reserve(length);
+  for (size_t i = 0; i != length; ++i) {
+    unsigned char c = path[i];
+    if (!isFileName && (c == '%') && (i + 2 < length) &&
+        (hexValue(path[i + 1]) >= 0) && (hexValue(path[i + 2]) >= 0)) {
+      auto value = static_cast<unsigned char>(hexValue(path[i + 1]) * 16 +
+                                              hexValue(path[i + 2]));
+      i += 2;
+      if (isUnreserved(value)) {
+        result.push_back(static_cast<char>(value));
+        continue;
+      }
+      c = value;
+    } else if (isPlain(c)) {
+      result.push_back(static_cast<char>(c));
+      continue;
+    }
+    result.push_back('%');
+    result.push_back(hex[c >> 4]);
+    result.push_back(hex[c & 15]);
+  }
+  return result;
+}
+
+std::uint64_t Manifest::hashOf(const char *path, size_t length) {
+  // FNV-1a, then a finalizer so every bit depends on every byte; the Bloom
+  // filter and the table each use different bits
+  std::uint64_t result = 14695981039346656037ull;
+  for (size_t i = 0; i != length; ++i) {
+    result ^= static_cast<unsigned char>(path[i]);
+    result *= 1099511628211ull;
+  }
+  result ^= result >> 33;
+  result *= 0xff51afd7ed558ccdull;
+  result ^= result >> 33;
+  return result;
+}
+
+bool Manifest::mayContain(std::uint64_t pathHash) const {
+  const std::uint64_t bits = bloom.size() * 64 - 1;
+  std::uint64_t step = (pathHash >> 32) | 1;
+  for (int i = 0; i != bloomProbes; ++i) {
+    std::uint64_t bit = (pathHash + i * step) & bits;
+    if ((bloom[bit / 64] & (std::uint64_t(1) << (bit % 64))) == 0)
+      return false;
+  }
+  return true;
+}
+
+size_t Manifest::find(const char *path, size_t length,
+                      std::uint64_t pathHash) const {
+  const size_t mask = slots.size() - 1;
+  const auto tag = static_cast<std::uint32_t>(pathHash >> 32);
+  for (size_t i = pathHash & mask;; i = (i + 1) & mask) {
+    const Slot &slot = slots[i];
+    if (slot.offset == 0)
+      return i;
+    const char *candidate = paths.data() + slot.offset - 1;
+    if ((slot.tag == tag) && (std::strncmp(candidate, path, length) == 0) &&
+        (candidate[length] == '\0'))
+      return i;
+  }
+}
+
+Manifest::Manifest(const std::vector<Entry> &list)
+    : slots(std::max<size_t>(16, powerOfTwoAtLeast(list.size() * 2)),
+            Slot{0, 0}),
+      bloom(std::max<size_t>(1, powerOfTwoAtLeast(list.size() * bloomBits) / 64),
+            0) {
+  size_t total = 0;
+  for (const auto &entry : list)
+    total += entry.path.size() + entry.version.size() + 2;
+  paths.reserve(total);
+  std::hash<std::string> hasher;
+  const std::uint64_t bits = bloom.size() * 64 - 1;
+  for (const auto &entry : list) {
+    const std::string path =
+        needsEncoding(entry.path.data(), entry.path.size())
+            ? encode(entry.path.data(), entry.path.size())
+            : entry.path;
+    if (paths.size() + path.size() + entry.version.size() + 2 >= UINT32_MAX)
+      throw ManifestError("Manifest is too big");
+    std::uint64_t pathHash = hashOf(path.data(), path.size());
+    Slot &slot = slots[find(path.data(), path.size(), pathHash)];
+    if (slot.offset != 0)
+      continue;
+    slot.offset = static_cast<std::uint32_t>(paths.size() + 1);
+    slot.tag = static_cast<std::uint32_t>(pathHash >> 32);
+    paths.append(path);
+    paths.push_back('\0');
+    paths.append(entry.version);
+    paths.push_back('\0');
+    std::uint64_t step = (pathHash >> 32) | 1;
+    for (int i = 0; i != bloomProbes; ++i) {
+      std::uint64_t bit = (pathHash + i * step) & bits;
+      bloom[bit / 64] |= std::uint64_t(1) << (bit % 64);
+    }
+    ++count;
+  }
+  hash = hasher(paths);
+}
+
+bool Manifest::contains(const std::string &path) const {
+  size_t length = pathLength(path);
+  if (needsEncoding(path.data(), length))
+    return contains(encode(path.data(), length));
+  std::uint64_t pathHash = hashOf(path.data(), length);
+  if (!mayContain(pathHash))
+    return false;
+  return slots[find(path.data(), length, pathHash)].offset != 0;
+}
+
+std::string Manifest::version(const std::string &path) const {
+  size_t length = pathLength(path);
+  if (needsEncoding(path.data(), length))
+    return version(encode(path.data(), length));
+  std::uint64_t pathHash = hashOf(path.data(), length);
+  if (!mayContain(pathHash))
+    return {};
+  const Slot &slot = slots[find(path.data(), length, pathHash)];
+  if (slot.offset == 0)
+    return {};
+  // The version comes straight after the path's '\0'
+  return std::string(paths.data() + slot.offset - 1 + length + 1);
+}
+
+Manifest loadManifest(const std::string &filename, const char *base_location) {
+  std::ifstream in(filename);
+  if (!in)
+    throw ManifestError("Can't open manifest " + filename + ": " +
+                        std::strerror(errno));
+  std::string base(base_location);
+  if (base.empty() || (base.back() != '/'))
+    base.push_back('/');
+  std::vector<Manifest::Entry> list;
+  std::string line;
+  for (int number = 1; std::getline(in, line); ++number) {
+    std::istringstream words(line);
+    std::string path, version, extra;
+    if (!(words >> path) || (path.front() == '#'))
+      continue;
+    if ((words >> version) && (words >> extra))
+      throw ManifestError(filename + ":" + std::to_string(number) +
+                          ": expected 'path [version]'");
+    // Relative paths are relative to our base, like CDN_URL keys
+    if (utils::is_relative(path.cbegin(), path.cend()))
+      path.insert(0, base);
+    list.emplace_back(std::move(path), std::move(version));
+  }
+  if (in.bad())
+    throw ManifestError("Error reading manifest " + filename);
+  return Manifest(list);
+}
+}
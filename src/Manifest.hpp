@@ -0,0 +1,113 @@
+#pragma once
+/** The paths that have really been uploaded to the CDN
+ *
+ * CDN_URL sends everything under a prefix to the CDN, even files the sync
+ * tool hasn't uploaded yet; each of those costs a CDN miss and a trip back
+ * to us. A manifest lists the paths that are on the CDN, one per line.
+ * Blank lines and lines starting with '#' are ignored, and relative paths
+ * are relative to the base location, like in a mapping file:
+ *
+ *     # Written by the sync script
+ *     /images/logo.png
+ *     /css/site.css
+ *
+ * Paths are percent encoded, as they are in urls: a file called
+ * "a b.png" is listed as "a%20b.png". Lookups go through the same encoding,
+ * so a page can write either.
+ *
+ * A path can be followed by a version token, usually a hash of its content
+ * (see cdnalizer-manifest in src/manifest). With CDN_VERSION, the token is
+ * spliced into the urls we send to the CDN, so they change whenever the
+ * file does, and can be cached for ever:
+ *
+ *     /images/logo.png 3f9a1c2b4d5e
+ *
+ * The paths are kept end to end in one buffer, with an open addressing table
+ * of offsets into it. A Bloom filter sits in front of the table, so most
+ * paths that aren't there are turned away without touching it.
+ *
+ * © Copyright 2017 Matthew Sherborne. All Rights Reserved.
+ * License: Apache License, Version 2.0 (See LICENSE.txt)
+ **/
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace cdnalizer {
+
+/// Thrown when a manifest can't be read
+class ManifestError : public std::runtime_error {
+public:
+  using std::runtime_error::runtime_error;
+};
+
+class Manifest {
+private:
+  /// Every path, then its version, each followed by a '\0'
+  std::string paths;
+  struct Slot {
+    /// Where the path starts in paths, plus one; 0 for an empty slot
+    std::uint32_t offset;
+    /// The top half of the path's hash, so most probes skip the compare
+    std::uint32_t tag;
+  };
+  /// A power of two in size, and never more than half full
+  std::vector<Slot> slots;
+  /// A power of two in size
+  std::vector<std::uint64_t> bloom;
+  size_t count = 0;
+  size_t hash = 0;
+
+  static std::uint64_t hashOf(const char *path, size_t length);
+  /// @returns false if the path with @a pathHash certainly isn't here
+  bool mayContain(std::uint64_t pathHash) const;
+  /// @returns the index of the path's slot, or of the empty one where it
+  /// would go
+  size_t find(const char *path, size_t length, std::uint64_t pathHash) const;
+
+public:
+  /// One line of a manifest
+  struct Entry {
+    std::string path;
+    /// Empty if the path has no version
+    std::string version;
+    Entry(const char *path) : path(path) {}
+    Entry(std::string path, std::string version = {})
+        : path(std::move(path)), version(std::move(version)) {}
+  };
+
+  /// Makes a manifest holding @a list; later duplicates are ignored
+  explicit Manifest(const std::vector<Entry> &list = {});
+
+  /** @returns @a path percent encoded the one way manifests hold it:
+   * every byte that isn't unreserved, a sub-delim, ':', '@' or '/' is
+   * escaped, with upper case hex, and escapes of unreserved bytes are
+   * decoded. With @a isFileName, '%' is just a byte, and is escaped too. */
+  static std::string encode(const char *path, size_t length,
+                            bool isFileName = false);
+
+  /** @returns true if @a path (a canonical path or url) is in the manifest.
+   * The query string and fragment are ignored, as the CDN stores files, not
+   * queries. */
+  bool contains(const std::string &path) const;
+  /// @returns the version token of @a path, or an empty string if it has
+  /// none or isn't here. Tokens are short, so this doesn't allocate unless
+  /// the path needs encoding.
+  std::string version(const std::string &path) const;
+  /// @returns how many paths we hold
+  size_t size() const { return count; }
+  /// A hash of every path and version, for Config::fingerprint()
+  size_t fingerprint() const { return hash; }
+};
+
+/** Reads a manifest file
+ *
+ * @param filename the file to read
+ * @param base_location the base for relative paths in the file
+ * @throws ManifestError if it can't be read, or a line has more than a path
+ *         and a version
+ */
+Manifest loadManifest(const std::string &filename, const char *base_location);
+}
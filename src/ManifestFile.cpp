@@ -0,0 +1,72 @@
+/**
+ * © Copyright 2017 Matthew Sherborne. All Rights Reserved.
+ * License: Apache License, Version 2.0 (See LICENSE.txt)
+ **/
+#include "ManifestFile.hpp"
+
+#include <cerrno>
+#include <cstring>
+
+namespace cdnalizer {
+
+ManifestFile::ManifestFile(std::string filename, std::string base_location,
+                           std::chrono::steady_clock::duration interval)
+    : filename(std::move(filename)), base_location(std::move(base_location)),
+      current(std::make_shared<const Manifest>(
+          loadManifest(this->filename, this->base_location.c_str()))),
+      watch(interval), applied(std::make_shared<const AppliedSet>()) {
+  stamp = read();
+}
+
+FileWatch::Stamp ManifestFile::read() const {
+  FileWatch::Stamp result;
+  if (!FileWatch::Stamp::read(filename, result))
+    throw ManifestError("Can't stat manifest " + filename + ": " +
+                        std::strerror(errno));
+  return result;
+}
+
+ManifestFile::Reload ManifestFile::refresh(std::string &error) {
+  if (!watch.begin())
+    return Reload::none;
+  Reload result = Reload::none;
+  try {
+    FileWatch::Stamp latest = read();
+    if (!(latest == stamp)) {
+      // Sync tools write a temporary file and rename it over the old one;
+      // anyone writing in place will change the mtime again when they finish
+      current.publish(std::make_shared<const Manifest>(
+          loadManifest(filename, base_location.c_str())));
+      stamp = latest;
+      result = Reload::reloaded;
+    }
+  } catch (const ManifestError &e) {
+    error = e.what();
+    result = Reload::failed;
+  }
+  watch.done();
+  return result;
+}
+
+std::shared_ptr<const Config>
+ManifestFile::apply(const std::shared_ptr<const Config> &config,
+                    Versioning versioning) {
+  Snapshot manifest = get();
+  auto key = std::make_pair(config->fingerprint(), versioning);
+  auto known = applied.get();
+  auto found = known->find(key);
+  if ((found != known->end()) && (found->second.manifest == manifest))
+    return found->second.result;
+  auto result = std::make_shared<Config>(*config);
+  result->setManifest(manifest);
+  result->setVersioning(versioning);
+  // Keep the others made from this manifest
+  auto made = std::make_shared<AppliedSet>();
+  for (const auto &entry : *known)
+    if (entry.second.manifest == manifest)
+      made->insert(entry);
+  (*made)[key] = {manifest, result};
+  applied.publish(std::move(made));
+  return result;
+}
+}
@@ -0,0 +1,91 @@
+#pragma once
+/** A manifest that comes from a file, and is reloaded when it changes
+ *
+ * Works like MappingFile: every so often one request thread stat()s the
+ * file, and if the sync tool has rewritten it, loads it and publishes the
+ * new Manifest. Readers never wait on a lock, and a request keeps the
+ * manifest it started with.
+ *
+ * © Copyright 2017 Matthew Sherborne. All Rights Reserved.
+ * License: Apache License, Version 2.0 (See LICENSE.txt)
+ **/
+
+#include "Config.hpp"
+#include "FileWatch.hpp"
+#include "Manifest.hpp"
+#include "Published.hpp"
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+
+namespace cdnalizer {
+
+class ManifestFile {
+public:
+  using Snapshot = Published<Manifest>::Snapshot;
+  /// What refresh() did
+  using Reload = FileWatch::Reload;
+
+private:
+  const std::string filename;
+  const std::string base_location;
+  Published<Manifest> current;
+  FileWatch watch;
+  /// What the file looked like when we last loaded it. Only touched by the
+  /// thread that holds the watch.
+  FileWatch::Stamp stamp;
+  /// A config apply() made, and the manifest it made it from
+  struct Applied {
+    Snapshot manifest;
+    std::shared_ptr<const Config> result;
+  };
+  /// Every config apply() has made for the current manifest, by the
+  /// fingerprint and versioning of the config it was given. That's one per
+  /// directory config that shares the manifest, so it never has to drop
+  /// one, and once each has its entry requests only read.
+  using AppliedSet = std::map<std::pair<size_t, Versioning>, Applied>;
+  Published<AppliedSet> applied;
+  /// Reads the file's Stamp
+  /// @throws ManifestError if we can't stat it
+  FileWatch::Stamp read() const;
+
+public:
+  /** Loads the file
+   *
+   * @param filename the manifest
+   * @param base_location the base for relative paths in the file
+   * @param interval the least time between checks for a newer file
+   * @throws ManifestError if the file can't be loaded. After this, a bad
+   *         file just means we keep the last good manifest.
+   */
+  ManifestFile(std::string filename, std::string base_location = "/",
+               std::chrono::steady_clock::duration interval =
+                   std::chrono::seconds(1));
+  ManifestFile(const ManifestFile &) = delete;
+  ManifestFile &operator=(const ManifestFile &) = delete;
+
+  /// @returns the manifest
+  Snapshot get() const { return current.get(); }
+
+  /** Reloads the file if the check interval has passed and it has changed.
+   *
+   * @param error set to what went wrong, when we return Reload::failed
+   */
+  Reload refresh(std::string &error);
+
+  /** @returns a copy of @a config that only rewrites paths in our manifest,
+   * and puts their versions in the urls as @a versioning says.
+   *
+   * A copy per request would be slow, so each one made is kept, and handed
+   * out again while the arguments and the manifest stay the same.
+   */
+  std::shared_ptr<const Config>
+  apply(const std::shared_ptr<const Config> &config,
+        Versioning versioning = Versioning::off);
+
+  const std::string &name() const { return filename; }
+};
+}
@@ -0,0 +1,98 @@
+/**
+ * © Copyright 2017 Matthew Sherborne. All Rights Reserved.
+ * License: Apache License, Version 2.0 (See LICENSE.txt)
+ **/
+#include "MappingFile.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace cdnalizer {
+
+Config loadMappings(const std::string &filename, const char *base_location) {
+  std::ifstream in(filename);
+  if (!in)
+    throw MappingFileError("Can't open mapping file " + filename + ": " +
+                           std::strerror(errno));
+  Config result({}, base_location);
+  std::string line;
+  for (int number = 1; std::getline(in, line); ++number) {
+    std::istringstream words(line);
+    std::string path, url;
+    if (!(words >> path) || (path.front() == '#'))
+      continue;
+    if (!(words >> url))
+      throw MappingFileError(filename + ":" + std::to_string(number) +
+                             ": expected 'path cdn_url [cdn_url...]'");
+    // Any more urls are more hosts for the same path
+    do
+      result.addHost(path, url);
+    while (words >> url);
+  }
+  if (in.bad())
+    throw MappingFileError("Error reading mapping file " + filename);
+  return result;
+}
+
+MappingFile::MappingFile(std::string filename, std::string base_location,
+                         std::chrono::steady_clock::duration interval)
+    : filename(std::move(filename)), base_location(std::move(base_location)),
+      current(std::make_shared<const Config>(
+          loadMappings(this->filename, this->base_location.c_str()))),
+      applied(std::make_shared<const AppliedSet>()), watch(interval) {
+  stamp = read();
+}
+
+MappingFile::Snapshot MappingFile::apply(const PathClassifier &classifier) {
+  Snapshot mappings = get();
+  size_t rules = classifier.hash();
+  auto known = applied.get();
+  auto found = known->find(rules);
+  if ((found != known->end()) && (found->second.mappings == mappings))
+    return found->second.result;
+  auto result = std::make_shared<Config>(*mappings);
+  result->setClassifier(classifier);
+  // Keep the others made from these mappings
+  auto made = std::make_shared<AppliedSet>();
+  for (const auto &entry : *known)
+    if (entry.second.mappings == mappings)
+      made->insert(entry);
+  (*made)[rules] = {mappings, result};
+  applied.publish(std::move(made));
+  return result;
+}
+
+FileWatch::Stamp MappingFile::read() const {
+  FileWatch::Stamp result;
+  if (!FileWatch::Stamp::read(filename, result))
+    throw MappingFileError("Can't stat mapping file " + filename + ": " +
+                           std::strerror(errno));
+  return result;
+}
+
+MappingFile::Reload MappingFile::refresh(std::string &error) {
+  if (!watch.begin())
+    return Reload::none;
+  Reload result = Reload::none;
+  try {
+    FileWatch::Stamp latest = read();
+    if (!(latest == stamp)) {
+      // Someone could be half way through writing it, but they'll change the
+      // mtime again when they finish, and we'll pick that up next time
+      auto config = std::make_shared<Config>(
+          loadMappings(filename, base_location.c_str()));
+      current.publish(std::move(config));
+      stamp = latest;
+      result = Reload::reloaded;
+    }
+  } catch (const MappingFileError &e) {
+    error = e.what();
+    result = Reload::failed;
+  }
+  watch.done();
+  return result;
+}
+}
@@ -0,0 +1,114 @@
+#pragma once
+/** CDN mappings that come from a file, and can be changed without a restart
+ *
+ * The file has one mapping per line: a path, then whitespace, then its cdn
+ * url. Blank lines and lines starting with '#' are ignored:
+ *
+ *     # Mister X's bucket is down; serve images from the backup
+ *     /images  http://backup.cdn.supa.ws/images
+ *     /css     http://cdn.supa.ws/css
+ *
+ * Every so often (at most once per check interval) one request thread
+ * stat()s the file. If it's changed, that thread loads it and publishes the
+ * new Config. Every other thread just carries on with the old one; nobody
+ * waits on a lock to read the mappings.
+ *
+ * © Copyright 2017 Matthew Sherborne. All Rights Reserved.
+ * License: Apache License, Version 2.0 (See LICENSE.txt)
+ **/
+
+#include "Config.hpp"
+#include "FileWatch.hpp"
+#include "Published.hpp"
+
+#include <chrono>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace cdnalizer {
+
+/// Thrown when a mapping file can't be read or has a bad line in it
+class MappingFileError : public std::runtime_error {
+public:
+  using std::runtime_error::runtime_error;
+};
+
+/** Reads a mapping file into a Config
+ *
+ * @param filename the file to read
+ * @param base_location the base for relative paths and urls in the file
+ * @throws MappingFileError if it can't be read or a line isn't a pair
+ */
+Config loadMappings(const std::string &filename, const char *base_location);
+
+class MappingFile {
+public:
+  using Snapshot = Published<Config>::Snapshot;
+  /// What refresh() did
+  using Reload = FileWatch::Reload;
+
+private:
+  const std::string filename;
+  const std::string base_location;
+  Published<Config> current;
+  /// A config apply() made, and the mappings it made it from
+  struct Applied {
+    Snapshot mappings;
+    Snapshot result;
+  };
+  /// Every config apply() has made for the current mappings, by the hash of
+  /// the path rules it was given. That's one per directory config that
+  /// shares the file, so it never has to drop one.
+  using AppliedSet = std::map<size_t, Applied>;
+  Published<AppliedSet> applied;
+  FileWatch watch;
+  /// What the file looked like when we last loaded it. Only touched by the
+  /// thread that holds the watch.
+  FileWatch::Stamp stamp;
+  /// Reads the file's Stamp
+  /// @throws MappingFileError if we can't stat it
+  FileWatch::Stamp read() const;
+
+public:
+  /** Loads the file
+   *
+   * @param filename the mapping file
+   * @param base_location the base for relative paths and urls in the file
+   * @param interval the least time between checks for a newer file
+   * @throws MappingFileError if the file can't be loaded. After this, a bad
+   *         file just means we keep the last good mappings.
+   */
+  MappingFile(std::string filename, std::string base_location = "/",
+              std::chrono::steady_clock::duration interval =
+                  std::chrono::seconds(1));
+  MappingFile(const MappingFile &) = delete;
+  MappingFile &operator=(const MappingFile &) = delete;
+
+  /// @returns the mappings. Hold on to the snapshot for as long as you need a
+  /// consistent view (eg. a whole request); it won't change under you.
+  Snapshot get() const { return current.get(); }
+
+  /** The mappings, with a directory's static/dynamic path rules
+   *
+   * A directory can get its rules from one block and inherit the file from
+   * another, so the rules come with each request. The result is kept until
+   * the file is reloaded, so asking again is cheap.
+   *
+   * @param classifier the directory's merged rules
+   */
+  Snapshot apply(const PathClassifier &classifier);
+
+  /** Reloads the file if the check interval has passed and it has changed.
+   *
+   * Cheap when there's nothing to do: if it's not time, or another thread is
+   * already checking, it returns straight away.
+   *
+   * @param error set to what went wrong, when we return Reload::failed
+   */
+  Reload refresh(std::string &error);
+
+  const std::string &name() const { return filename; }
+};
+}
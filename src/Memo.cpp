@@ -0,0 +1,18 @@
+/**
+ * © Copyright 2017 Matthew Sherborne. All Rights Reserved.
+ * License: Apache License, Version 2.0 (See LICENSE.txt)
+ **/
+#include "Memo.hpp"
+
+namespace cdnalizer {
+namespace memo {
+
+constexpr size_t Cache::slotCount;
+constexpr size_t Cache::probeLength;
+
+Cache &local() {
+  thread_local Cache cache;
+  return cache;
+}
+}
+}
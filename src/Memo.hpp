@@ -0,0 +1,157 @@
+#pragma once
+/** Remembers what we decided for urls we've seen before
+ *
+ * A page uses the same sprites, fonts and scripts over and over, and so do
+ * the pages after it. Each thread keeps a small table from (config, server
+ * url, location, raw url) to what rewriteHTML decided for it, so a repeated
+ * url skips canonicalizing, the config search and the static path check.
+ *
+ * The table is open addressing with a short linear probe; when the probe is
+ * full, the url's home slot is replaced.
+ *
+ * © Copyright 2017 Matthew Sherborne. All Rights Reserved.
+ * License: Apache License, Version 2.0 (See LICENSE.txt)
+ **/
+
+#include "utils.hpp"
+
+#include <array>
+#include <cstddef>
+#include <string>
+
+namespace cdnalizer {
+namespace memo {
+
+constexpr size_t none = static_cast<size_t>(-1);
+
+/// What we decided for one url
+struct Decision {
+  /// The Config::entry() index that matched, or none for no change
+  size_t entry;
+  /// Which of the entry's cdn urls, see Config::hostOf()
+  size_t host;
+  /// How many chars of the url are replaced by the cdn url
+  size_t cut;
+  /// Where in the url its version goes, or none
+  size_t insertAt;
+  /// The version to put there, eg. "?v=3f9a1c"
+  std::string insert;
+};
+
+/// Urls longer than this aren't remembered
+constexpr size_t maxUrl = 512;
+
+class Cache {
+public:
+  static constexpr size_t slotCount = 256;
+  static constexpr size_t probeLength = 4;
+
+private:
+  struct Slot {
+    bool used = false;
+    size_t hash;
+    size_t fingerprint;
+    std::string server_url;
+    std::string location;
+    std::string url;
+    Decision decision;
+  };
+  std::array<Slot, slotCount> slots;
+
+  /// FNV-1a
+  static void mix(size_t &hash, char c) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 1099511628211ull;
+  }
+  template <typename Iterator>
+  static size_t hashOf(size_t fingerprint, const std::string &server_url,
+                       const std::string &location, Iterator first,
+                       const Iterator &last) {
+    size_t result = 14695981039346656037ull ^ fingerprint;
+    for (char c : server_url)
+      mix(result, c);
+    mix(result, '\0');
+    for (char c : location)
+      mix(result, c);
+    mix(result, '\0');
+    for (; first != last; ++first)
+      mix(result, *first);
+    return result;
+  }
+  template <typename Iterator>
+  static bool same(const Slot &slot, size_t hash, size_t fingerprint,
+                   const std::string &server_url, const std::string &location,
+                   const Iterator &first, const Iterator &last) {
+    return slot.used && (slot.hash == hash) &&
+           (slot.fingerprint == fingerprint) &&
+           (slot.server_url == server_url) && (slot.location == location) &&
+           utils::equal(slot.url.cbegin(), slot.url.cend(), first, last);
+  }
+
+public:
+  /// A lookup in progress: find() fills it in, so store() needn't hash again
+  struct Key {
+    size_t hash = 0;
+    bool cacheable = false;
+  };
+
+  /// @returns what we decided last time for the url [first, last), or
+  /// nullptr if we don't remember it
+  template <typename Iterator>
+  const Decision *find(size_t fingerprint, const std::string &server_url,
+                       const std::string &location, const Iterator &first,
+                       const Iterator &last, Key &key) {
+    key.cacheable = static_cast<size_t>(utils::distance(first, last)) <= maxUrl;
+    if (!key.cacheable)
+      return nullptr;
+    key.hash = hashOf(fingerprint, server_url, location, first, last);
+    for (size_t i = 0; i != probeLength; ++i) {
+      const Slot &slot = slots[(key.hash + i) % slotCount];
+      if (!slot.used)
+        return nullptr;
+      if (same(slot, key.hash, fingerprint, server_url, location, first, last))
+        return &slot.decision;
+    }
+    return nullptr;
+  }
+
+  /// Remembers @a decision for the url that find() just missed
+  template <typename Iterator>
+  void store(const Key &key, size_t fingerprint, const std::string &server_url,
+             const std::string &location, const Iterator &first,
+             const Iterator &last, const Decision &decision) {
+    if (!key.cacheable)
+      return;
+    Slot *target = &slots[key.hash % slotCount];
+    for (size_t i = 0; i != probeLength; ++i) {
+      Slot &slot = slots[(key.hash + i) % slotCount];
+      if (!slot.used) {
+        target = &slot;
+        break;
+      }
+    }
+    // assign() reuses the strings' memory, so a warm table doesn't allocate
+    target->used = true;
+    target->hash = key.hash;
+    target->fingerprint = fingerprint;
+    target->server_url.assign(server_url);
+    target->location.assign(location);
+    target->url.assign(first, last);
+    target->decision.entry = decision.entry;
+    target->decision.host = decision.host;
+    target->decision.cut = decision.cut;
+    target->decision.insertAt = decision.insertAt;
+    target->decision.insert.assign(decision.insert);
+  }
+
+  /// Forgets everything
+  void clear() {
+    for (auto &slot : slots)
+      slot.used = false;
+  }
+};
+
+/// @returns the calling thread's cache
+Cache &local();
+}
+}
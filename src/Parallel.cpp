@@ -0,0 +1,230 @@
+/**
+ * © Copyright 2017 Matthew Sherborne. All Rights Reserved.
+ * License: Apache License, Version 2.0 (See LICENSE.txt)
+ **/
+#include "Parallel.hpp"
+
+#include "Rewriter_impl.hpp"
+#include "WorkPool.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace cdnalizer {
+namespace parallel {
+
+namespace {
+
+/// ragel's 'space'
+bool isSpace(char c) { return (c == ' ') || ((c >= '\t') && (c <= '\r')); }
+
+/// @returns the first @a needle at or after @a from, or @a size
+size_t findText(const char *data, size_t size, size_t from,
+                const char *needle) {
+  const char *end = data + size;
+  const char *found = std::search(data + from, end, needle,
+                                  needle + std::strlen(needle));
+  return found - data;
+}
+
+/** @returns where css's parser is back at rest after a "url" at @a at: one
+ * past the ')', or the byte it failed on (which it starts again from).
+ * Follows parser/css.machine.rl.
+ */
+size_t afterURL(const char *data, size_t size, size_t at) {
+  size_t i = at + 3;
+  while ((i != size) && isSpace(data[i]))
+    ++i;
+  if ((i == size) || (data[i] != '('))
+    return i;
+  ++i;
+  while ((i != size) && isSpace(data[i]))
+    ++i;
+  if (i == size)
+    return i;
+  char quote = data[i];
+  if ((quote == '"') || (quote == '\'')) {
+    ++i;
+    // It needs at least one byte in the quotes
+    if ((i == size) || (data[i] == quote))
+      return i;
+    const void *close = std::memchr(data + i, quote, size - i);
+    if (close == nullptr)
+      return size;
+    i = static_cast<const char *>(close) - data + 1;
+  } else {
+    if (data[i] == ')')
+      return i;
+    while ((i != size) && !isSpace(data[i]) && (data[i] != '"') &&
+           (data[i] != '\'') && (data[i] != ')'))
+      ++i;
+  }
+  while ((i != size) && isSpace(data[i]))
+    ++i;
+  if ((i != size) && (data[i] == ')'))
+    ++i;
+  return i;
+}
+
+/// @returns the end of the first "</script>" at or after @a from, plus the
+/// byte the html parser skips after it; or @a size
+size_t afterScript(const char *data, size_t size, size_t from) {
+  size_t end =
+      utils::searchCaseless(data + from, data + size, "</script>") - data;
+  return std::min(size, end + 10);
+}
+
+/// @returns true if a tag called "script" starts at @a at
+bool isScript(const char *data, size_t size, size_t at) {
+  static const char name[] = "<script";
+  size_t length = sizeof(name) - 1;
+  if ((size - at <= length) || (strncasecmp(data + at, name, length) != 0))
+    return false;
+  return !std::isalnum(static_cast<unsigned char>(data[at + length]));
+}
+
+std::vector<size_t> cssPoints(const char *data, size_t size,
+                              size_t pieceSize) {
+  std::vector<size_t> result{0};
+  // Where the parser is next at rest, and where the next url starts
+  size_t rest = 0;
+  size_t url = findText(data, size, 0, "url");
+  for (size_t want = pieceSize; want < size; want = result.back() + pieceSize) {
+    // Jump the urls before where we want to cut
+    while (url < want) {
+      rest = afterURL(data, size, url);
+      url = findText(data, size, std::max(rest, url + 1), "url");
+    }
+    size_t cut = std::max(rest, want);
+    if (size - cut < pieceSize / 2)
+      break;
+    result.push_back(cut);
+  }
+  return result;
+}
+
+std::vector<size_t> htmlPoints(const char *data, size_t size,
+                               size_t pieceSize) {
+  std::vector<size_t> result{0};
+  // Everything before here is outside any script
+  size_t clear = 0;
+  size_t want = pieceSize;
+  while (want < size) {
+    const void *found = std::memchr(data + want, '<', size - want);
+    if (found == nullptr)
+      break;
+    size_t cut = static_cast<const char *>(found) - data;
+    // Look for scripts between the last cut and this one; they're rare
+    // enough that a '<' at a time is fine
+    bool inScript = false;
+    for (size_t at = clear; at < cut;) {
+      const void *tag = std::memchr(data + at, '<', cut - at);
+      if (tag == nullptr)
+        break;
+      at = static_cast<const char *>(tag) - data;
+      if (isScript(data, size, at)) {
+        at = afterScript(data, size, at);
+        if (at > cut) {
+          inScript = true;
+          clear = at;
+          break;
+        }
+      } else {
+        ++at;
+      }
+    }
+    if (inScript) {
+      want = clear;
+      continue;
+    }
+    clear = cut;
+    if (size - cut < pieceSize / 2)
+      break;
+    result.push_back(cut);
+    want = cut + pieceSize;
+  }
+  return result;
+}
+
+/// One piece, rewritten
+struct Piece {
+  std::string text;
+  /// It ended part way through a tag
+  bool unfinished = false;
+};
+
+Piece rewritePiece(const std::string &server_url, const std::string &location,
+                   const Config &config, const char *start, const char *end,
+                   bool isCSS) {
+  Piece piece;
+  piece.text.reserve((end - start) + (end - start) / 8);
+  using iterator = const char *;
+  iterator done = rewriteHTML<iterator>(
+      server_url, location, config, start, end,
+      [&](iterator from, iterator to) {
+        piece.text.append(from, to);
+        return to;
+      },
+      [&](std::string data) { piece.text.append(data); }, isCSS, {},
+      [&]() { piece.unfinished = true; });
+  piece.text.append(done, end);
+  return piece;
+}
+}
+
+std::vector<size_t> splitPoints(const char *data, size_t size, bool isCSS,
+                                size_t pieceSize) {
+  pieceSize = std::max<size_t>(pieceSize, 1);
+  return isCSS ? cssPoints(data, size, pieceSize)
+               : htmlPoints(data, size, pieceSize);
+}
+
+std::string rewrite(const std::string &server_url, const std::string &location,
+                    const Config &config, const char *data, size_t size,
+                    bool isCSS, unsigned threads, size_t threshold) {
+  std::vector<size_t> starts{0};
+  // A few pieces per thread, so one slow piece doesn't hold the rest up
+  if ((threads > 1) && (size >= threshold))
+    starts = splitPoints(data, size, isCSS,
+                         std::max(size / (threads * 4), threshold / 16));
+  if (starts.size() < 2)
+    return rewritePiece(server_url, location, config, data, data + size, isCSS)
+        .text;
+  starts.push_back(size);
+  size_t count = starts.size() - 1;
+  std::vector<Piece> pieces(count);
+  {
+    WorkPool pool(static_cast<unsigned>(std::min<size_t>(threads, count)));
+    for (size_t i = 0; i != count; ++i)
+      pool.submit([&, i]() {
+        pieces[i] = rewritePiece(server_url, location, config,
+                                 data + starts[i], data + starts[i + 1], isCSS);
+      });
+    pool.wait();
+  }
+
+  std::string result;
+  result.reserve(size + size / 8);
+  for (size_t i = 0; i != count;) {
+    if (!pieces[i].unfinished || (i + 1 == count)) {
+      result.append(pieces[i].text);
+      ++i;
+      continue;
+    }
+    // A tag ran on into the next piece, so that one started in the wrong
+    // place. Do the two together; if that still ends in a tag, do the rest.
+    size_t next = i + 2;
+    Piece both = rewritePiece(server_url, location, config, data + starts[i],
+                              data + starts[next], isCSS);
+    if (both.unfinished && (next != count)) {
+      next = count;
+      both = rewritePiece(server_url, location, config, data + starts[i],
+                          data + size, isCSS);
+    }
+    result.append(both.text);
+    i = next;
+  }
+  return result;
+}
+}
+}
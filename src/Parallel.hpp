@@ -0,0 +1,53 @@
+#pragma once
+/** Rewrites one big document on several threads
+ *
+ * rewriteHTML goes through a document in one pass, so a multi megabyte page
+ * or css bundle keeps one core busy. For a document that's all in memory we
+ * can instead cut it into pieces, rewrite each piece on a WorkPool, and join
+ * the results up in order.
+ *
+ * We only cut where a piece can start from nothing and come out the same as
+ * the one pass would have made it:
+ *
+ *  * css: anywhere that isn't in a url(...); splitPoints() follows the same
+ *    grammar as parser/css.machine.rl to find them
+ *  * html: at a '<' that isn't inside a script. Whether the tag before it
+ *    ran on past the '<' (eg. it's in an attribute value) we only find out
+ *    when rewriteHTML says the piece ended in a tag (UnfinishedEvent); then
+ *    that piece and the next are done again as one.
+ *
+ * So the output is byte for byte what rewriteHTML makes.
+ *
+ * © Copyright 2017 Matthew Sherborne. All Rights Reserved.
+ * License: Apache License, Version 2.0 (See LICENSE.txt)
+ **/
+
+#include "Config.hpp"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace cdnalizer {
+namespace parallel {
+
+/// Documents smaller than this are done in one go; it's not worth the threads
+constexpr size_t defaultThreshold = 1024 * 1024;
+
+/// @returns where each piece of [data, data + size) starts, starting with 0.
+/// They're about @a pieceSize apart, or further when there's nowhere safe.
+std::vector<size_t> splitPoints(const char *data, size_t size, bool isCSS,
+                                size_t pieceSize);
+
+/** Rewrites a whole document, like rewriteHTML, using up to @a threads
+ * threads if it's at least @a threshold bytes. No piece is smaller than a
+ * sixteenth of @a threshold.
+ *
+ * @returns the rewritten document
+ */
+std::string rewrite(const std::string &server_url, const std::string &location,
+                    const Config &config, const char *data, size_t size,
+                    bool isCSS, unsigned threads,
+                    size_t threshold = defaultThreshold);
+}
+}
@@ -0,0 +1,217 @@
+/**
+ * © Copyright 2017 Matthew Sherborne. All Rights Reserved.
+ * License: Apache License, Version 2.0 (See LICENSE.txt)
+ **/
+#include "PathClassifier.hpp"
+
+#include <cctype>
+#include <functional>
+#include <stdexcept>
+
+namespace cdnalizer {
+
+namespace {
+
+constexpr std::uint8_t staticWord = 1;
+constexpr std::uint8_t dynamicWord = 2;
+
+/// What we assume unless told otherwise
+const char *defaultDynamicExtensions[] = {"php", "pl", "py"};
+
+std::string lower(std::string word) {
+  for (char &c : word)
+    c = std::tolower(static_cast<unsigned char>(c));
+  return word;
+}
+
+/// boost::hash_combine's mixing
+void combine(size_t &seed, size_t value) {
+  seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+}
+
+void PathClassifier::Trie::clear() {
+  next.assign(1, {});
+  verdict.assign(1, 0);
+}
+
+void PathClassifier::Trie::add(const std::string &word, std::uint8_t value,
+                               bool foldCase) {
+  std::uint16_t node = 0;
+  for (auto i = word.rbegin(); i != word.rend(); ++i) {
+    unsigned char c = *i;
+    if (foldCase)
+      c = std::tolower(c);
+    std::uint16_t target = next[node][c];
+    if (target == 0) {
+      if (next.size() == 0xffff)
+        throw std::length_error("Too many path rules");
+      target = next.size();
+      next.push_back({});
+      verdict.push_back(0);
+      next[node][c] = target;
+      if (foldCase)
+        next[node][std::toupper(c)] = target;
+    }
+    node = target;
+  }
+  verdict[node] = value;
+}
+
+void PathClassifier::compile() {
+  auto result = std::make_shared<Compiled>();
+  for (const char *extension : defaultDynamicExtensions)
+    if (extensions.find(extension) == extensions.end())
+      result->extensions.add(std::string(".") + extension, dynamicWord, true);
+  for (const auto &pair : extensions)
+    result->extensions.add("." + pair.first,
+                           pair.second ? staticWord : dynamicWord, true);
+  for (const auto &name : staticParams)
+    result->params.add(name, staticWord, false);
+  compiled = std::move(result);
+}
+
+void PathClassifier::setExtension(std::string extension, bool isStatic) {
+  if (!extension.empty() && (extension.front() == '.'))
+    extension.erase(0, 1);
+  extensions[lower(extension)] = isStatic;
+  compile();
+}
+
+void PathClassifier::setExtensionless(bool isStatic) {
+  extensionless = isStatic ? 1 : 0;
+}
+
+void PathClassifier::setQueryDynamic(bool dynamic) {
+  queryDynamic = dynamic ? 1 : 0;
+}
+
+void PathClassifier::addStaticParam(std::string name) {
+  staticParams.insert(std::move(name));
+  compile();
+}
+
+PathClassifier &PathClassifier::operator+=(const PathClassifier &other) {
+  for (const auto &pair : other.extensions)
+    extensions[pair.first] = pair.second;
+  if (other.extensionless != -1)
+    extensionless = other.extensionless;
+  if (other.queryDynamic != -1)
+    queryDynamic = other.queryDynamic;
+  staticParams.insert(other.staticParams.begin(), other.staticParams.end());
+  compile();
+  return *this;
+}
+
+bool PathClassifier::isStatic(const char *begin, const char *end) const {
+  // We read backwards, so we can't know which '?' is the first one until we
+  // get to the start. Every '?' ends a section that we now know was query
+  // string; whatever is left at the start is the path.
+
+  const Trie &extensionTrie = compiled->extensions;
+  const Trie &paramTrie = compiled->params;
+
+  // Extension trie walk for the current section
+  std::uint16_t ext = 0;
+  bool extLive = true;
+  std::uint8_t extVerdict = 0;
+  bool sawDot = false;
+  bool extDone = false;
+  // Parameter trie walk for the current name=value token
+  std::uint16_t param = 0;
+  bool paramLive = true;
+  bool tokenEmpty = true;
+  // Non static parameters in this section, and in the whole query string
+  bool sectionDynamic = false;
+  bool queryHasDynamic = false;
+
+  auto endToken = [&]() {
+    if (!tokenEmpty && !(paramLive && paramTrie.verdict[param] == staticWord))
+      sectionDynamic = true;
+    param = 0;
+    paramLive = true;
+    tokenEmpty = true;
+  };
+  auto resetPath = [&]() {
+    ext = 0;
+    extLive = true;
+    extVerdict = 0;
+    sawDot = false;
+    extDone = false;
+  };
+
+  for (const char *p = end; p != begin;) {
+    unsigned char c = *--p;
+    switch (c) {
+    case '#':
+      // Everything after it was the fragment; start again
+      resetPath();
+      param = 0;
+      paramLive = true;
+      tokenEmpty = true;
+      sectionDynamic = queryHasDynamic = false;
+      continue;
+    case '?':
+      endToken();
+      queryHasDynamic |= sectionDynamic;
+      sectionDynamic = false;
+      resetPath();
+      continue;
+    case '&':
+      endToken();
+      break;
+    case '=':
+      // What we read was the value; the name comes next
+      param = 0;
+      paramLive = true;
+      tokenEmpty = false;
+      break;
+    default:
+      tokenEmpty = false;
+      if (paramLive) {
+        param = paramTrie.next[param][c];
+        paramLive = param != 0;
+      }
+    }
+    if (extDone)
+      continue;
+    if (c == '/') {
+      extDone = true;
+      continue;
+    }
+    if (c == '.')
+      sawDot = true;
+    if (extLive) {
+      ext = extensionTrie.next[ext][c];
+      extLive = ext != 0;
+      if (extLive && extensionTrie.verdict[ext])
+        extVerdict = extensionTrie.verdict[ext];
+    }
+    // Once we've seen a dot and the trie has nothing more to say, we're done
+    if (sawDot && !extLive)
+      extDone = true;
+  }
+
+  if (extVerdict != 0) {
+    if (extVerdict == dynamicWord)
+      return false;
+  } else if (!sawDot && (extensionless == 0)) {
+    return false;
+  }
+  return !((queryDynamic == 1) && queryHasDynamic);
+}
+
+size_t PathClassifier::hash() const {
+  std::hash<std::string> hasher;
+  size_t result = 0;
+  for (const auto &pair : extensions) {
+    combine(result, hasher(pair.first));
+    combine(result, pair.second);
+  }
+  combine(result, extensionless + 1);
+  combine(result, queryDynamic + 1);
+  for (const auto &name : staticParams)
+    combine(result, hasher(name));
+  return result;
+}
+}
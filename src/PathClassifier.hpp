@@ -0,0 +1,95 @@
+#pragma once
+/** Decides whether a url points at a static file (that can go to the CDN) or
+ * a dynamic page (that can't)
+ *
+ * The rules are:
+ *
+ *  * The path is everything before the first '?' or '#'
+ *  * If its extension is in the extension list, that says static or dynamic.
+ *    By default .php, .pl and .py are dynamic. Extensions are case
+ *    insensitive, and may have dots in them, eg. 'css.php'; the longest
+ *    match wins.
+ *  * Any other extension is static
+ *  * No extension at all (eg. '/blog/my-post' or '/images/') is static,
+ *    unless setExtensionless(false)
+ *  * By default the query string is ignored. With setQueryDynamic(true), a
+ *    query string makes the url dynamic, unless every parameter in it is a
+ *    static parameter (eg. 'ver' for '/style.css?ver=4.7')
+ *
+ * The rules are compiled into two reversed tries: one of extensions, one of
+ * static parameter names. isStatic() reads the url once, from the end to the
+ * start, walking both as it goes, and allocates nothing.
+ *
+ * © Copyright 2017 Matthew Sherborne. All Rights Reserved.
+ * License: Apache License, Version 2.0 (See LICENSE.txt)
+ **/
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace cdnalizer {
+
+class PathClassifier {
+private:
+  /// A trie of reversed words. Node 0 is the root; a transition to 0 means
+  /// there isn't one.
+  struct Trie {
+    std::vector<std::array<std::uint16_t, 256>> next;
+    /// 0 - no word ends here, 1 - a static word, 2 - a dynamic one
+    std::vector<std::uint8_t> verdict;
+    Trie() { clear(); }
+    void clear();
+    /// Adds @a word backwards. @a foldCase makes it match any case.
+    void add(const std::string &word, std::uint8_t value, bool foldCase);
+  };
+
+  // The rules as they were set; only explicit settings, so merging works
+  /// extension (without the leading '.') -> true if static
+  std::map<std::string, bool> extensions;
+  /// -1 not set (static), 0 dynamic, 1 static
+  int extensionless = -1;
+  /// -1 not set (ignore the query string), 0 ignore it, 1 dynamic
+  int queryDynamic = -1;
+  std::set<std::string> staticParams;
+
+  /// The compiled rules. Shared between copies, as they never change.
+  struct Compiled {
+    Trie extensions;
+    Trie params;
+  };
+  std::shared_ptr<const Compiled> compiled;
+
+  /// Rebuilds the tries from the rules. Called after every change.
+  void compile();
+
+public:
+  PathClassifier() { compile(); }
+
+  /// Says whether urls ending in '.extension' are static or not
+  void setExtension(std::string extension, bool isStatic);
+  /// Says whether paths without an extension are static
+  void setExtensionless(bool isStatic);
+  /// If @a dynamic, urls with query strings are dynamic unless all their
+  /// parameters are static parameters
+  void setQueryDynamic(bool dynamic);
+  /// A query parameter that doesn't make a url dynamic, eg. 'ver'
+  void addStaticParam(std::string name);
+
+  /// Adds @a other's rules to ours; where we both have a rule, its wins
+  PathClassifier &operator+=(const PathClassifier &other);
+
+  /// @returns true if the url in [begin, end) can go to the CDN
+  bool isStatic(const char *begin, const char *end) const;
+  bool isStatic(const std::string &url) const {
+    return isStatic(url.data(), url.data() + url.size());
+  }
+
+  /// A hash of the rules, for Config::fingerprint()
+  size_t hash() const;
+};
+}
@@ -0,0 +1,26 @@
+/**
+ * © Copyright 2017 Matthew Sherborne. All Rights Reserved.
+ * License: Apache License, Version 2.0 (See LICENSE.txt)
+ **/
+#include "Probes.hpp"
+
+#ifdef CDNALIZER_USDT
+
+// The tracer finds these through the probe notes, and writes to them
+#define DEFINE_SEMAPHORE(name)                                                 \
+  __extension__ unsigned short CDNALIZER_SEMAPHORE(name)                       \
+      __attribute__((unused)) __attribute__((section(".probes"))) = 0;
+
+extern "C" {
+DEFINE_SEMAPHORE(filter__entry)
+DEFINE_SEMAPHORE(filter__return)
+DEFINE_SEMAPHORE(rewrite__entry)
+DEFINE_SEMAPHORE(rewrite__return)
+DEFINE_SEMAPHORE(tag__entry)
+DEFINE_SEMAPHORE(tag__return)
+DEFINE_SEMAPHORE(splice__entry)
+DEFINE_SEMAPHORE(splice__return)
+DEFINE_SEMAPHORE(leftover)
+}
+
+#endif
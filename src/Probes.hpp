@@ -0,0 +1,89 @@
+#pragma once
+/** Static tracing probes (USDT), for bpftrace, systemtap, perf etc.
+ *
+ * Built in when cmake finds <sys/sdt.h> (ENABLE_USDT, on by default). A probe
+ * is a single nop instruction until a tracer attaches, and arguments that are
+ * expensive to work out are guarded by CDNALIZER_PROBE_ENABLED, which reads
+ * the probe's semaphore. Without sys/sdt.h it all compiles away.
+ *
+ * The probes (provider 'cdnalizer'):
+ *
+ *   filter__entry(request_rec* r, const char* uri, int buckets, long bytes)
+ *   filter__return(request_rec* r, int status)
+ *   rewrite__entry(request_rec* r, int isCSS)   isCSS is 2 for the search engine
+ *   rewrite__return(request_rec* r, int isCSS)
+ *   tag__entry(request_rec* r)
+ *   tag__return(request_rec* r)
+ *   splice__entry(request_rec* r, const char* key)
+ *   splice__return(request_rec* r, const char* key, size_t cut)
+ *   leftover(request_rec* r, long bytes)
+ *
+ * The rewriters don't know about requests, so they pass probes::request(),
+ * which the filter sets for the length of each call; it's null outside
+ * Apache. bytes is -1 when the brigade has buckets of unknown length (pipes
+ * and sockets). See dev-tools/slow-requests.bt for an example.
+ *
+ * © Copyright 2017 Matthew Sherborne. All Rights Reserved.
+ * License: Apache License, Version 2.0 (See LICENSE.txt)
+ **/
+
+namespace cdnalizer {
+namespace probes {
+
+/// The request this thread is working on, for the probes' first argument
+inline const void *&request() {
+  static thread_local const void *current = nullptr;
+  return current;
+}
+
+/// Sets request() until it goes out of scope
+class RequestScope {
+private:
+  const void *previous;
+
+public:
+  explicit RequestScope(const void *r) : previous(request()) { request() = r; }
+  RequestScope(const RequestScope &) = delete;
+  RequestScope &operator=(const RequestScope &) = delete;
+  ~RequestScope() { request() = previous; }
+};
+}
+}
+
+#ifdef CDNALIZER_USDT
+
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+/// Tracers bump these when they attach to a probe
+#define CDNALIZER_SEMAPHORE(name) cdnalizer_##name##_semaphore
+
+extern "C" {
+extern unsigned short CDNALIZER_SEMAPHORE(filter__entry);
+extern unsigned short CDNALIZER_SEMAPHORE(filter__return);
+extern unsigned short CDNALIZER_SEMAPHORE(rewrite__entry);
+extern unsigned short CDNALIZER_SEMAPHORE(rewrite__return);
+extern unsigned short CDNALIZER_SEMAPHORE(tag__entry);
+extern unsigned short CDNALIZER_SEMAPHORE(tag__return);
+extern unsigned short CDNALIZER_SEMAPHORE(splice__entry);
+extern unsigned short CDNALIZER_SEMAPHORE(splice__return);
+extern unsigned short CDNALIZER_SEMAPHORE(leftover);
+}
+
+#define CDNALIZER_PROBE(name, ...) STAP_PROBEV(cdnalizer, name, ##__VA_ARGS__)
+#define CDNALIZER_PROBE_ENABLED(name)                                          \
+  __builtin_expect(CDNALIZER_SEMAPHORE(name) != 0, 0)
+
+#else
+
+/// Keeps the arguments 'used', without evaluating them
+template <typename... Args> inline void cdnalizerProbeArgs(const Args &...) {}
+
+#define CDNALIZER_PROBE(name, ...)                                             \
+  do {                                                                         \
+    if (false)                                                                 \
+      cdnalizerProbeArgs(__VA_ARGS__);                                         \
+  } while (0)
+#define CDNALIZER_PROBE_ENABLED(name) false
+
+#endif
@@ -0,0 +1,75 @@
+#pragma once
+/** Publishes an immutable object to many reader threads, and lets a writer
+ * swap it for a new one without readers ever taking a lock.
+ *
+ * It's RCU style: readers grab a snapshot (a shared_ptr) in a tiny read side
+ * critical section, guarded by one of two reader counters. A writer swaps the
+ * pointer, then waits out a grace period (each counter draining once) before
+ * dropping its own reference to the old object. Snapshots that are still in
+ * use keep the old object alive until they're done with it.
+ *
+ * © Copyright 2017 Matthew Sherborne. All Rights Reserved.
+ * License: Apache License, Version 2.0 (See LICENSE.txt)
+ **/
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace cdnalizer {
+
+template <typename T> class Published {
+public:
+  using Snapshot = std::shared_ptr<const T>;
+
+private:
+  struct Node {
+    Snapshot value;
+  };
+  /// Reader counters, one per epoch parity, on their own cache lines
+  struct alignas(64) Counter {
+    std::atomic<long> readers{0};
+  };
+  std::atomic<Node *> current;
+  std::atomic<unsigned long> epoch{0};
+  Counter counters[2];
+  /// Only writers take this
+  std::mutex writeLock;
+
+  /// Waits until no reader can still be looking at a node we unpublished
+  void waitForReaders() {
+    // Two flips, so a reader that read a stale epoch is caught by the second
+    for (int round = 0; round < 2; ++round) {
+      auto old = epoch.fetch_add(1) & 1;
+      while (counters[old].readers.load() != 0)
+        std::this_thread::yield();
+    }
+  }
+
+public:
+  explicit Published(Snapshot initial) : current(new Node{std::move(initial)}) {}
+  Published(const Published &) = delete;
+  Published &operator=(const Published &) = delete;
+  ~Published() { delete current.load(); }
+
+  /// @returns the current object. Wait free: no locks, no waiting on writers.
+  Snapshot get() const {
+    auto &self = const_cast<Published &>(*this);
+    auto &counter = self.counters[epoch.load() & 1].readers;
+    counter.fetch_add(1);
+    Snapshot result = current.load()->value;
+    counter.fetch_sub(1);
+    return result;
+  }
+
+  /// Publishes a new object. Returns once no reader can see the old one
+  /// (except through snapshots they already hold).
+  void publish(Snapshot value) {
+    std::lock_guard<std::mutex> guard(writeLock);
+    Node *old = current.exchange(new Node{std::move(value)});
+    waitForReaders();
+    delete old;
+  }
+};
+}
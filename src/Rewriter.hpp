@@ -20,6 +20,16 @@ using RangeEvent = std::function<iterator(const iterator &, const iterator &)>;
 /// Used for events that generate new data
 using DataEvent = std::function<void(std::string)>;
 
+/// Fired after each rewrite, just after its DataEvent. Gives the config key
+/// that matched, which of its cdn urls went in (see Config::hostOf()), and
+/// how many bytes of input were cut out and replaced.
+using SpliceEvent =
+    std::function<void(const std::string &key, size_t host, size_t cut)>;
+
+/// Fired if the HTML ends part way through a tag, or through the script after
+/// a <script> tag. More data might have changed how the end of it came out.
+using UnfinishedEvent = std::function<void()>;
+
 /** Rewrites links and references in HTML output to point to the CDN.
  *  For example /images/a.gif could become http://cdn.yoursite.com/images/a.gif
  *
@@ -42,14 +52,19 @@ using DataEvent = std::function<void(std::string)>;
  *                 See whe rewriteHTML function for a more concrete example.
  * @param newData  Event fired when new data for the output stream has been generated
  * @param isCSS    This is a css file
- * @returns The place where we reading when we hit @a end - at the time of writing
- *          if we were in the middle of a tag, we'll return the position of the '<',
- *          otherwise, it'll be the same as end.
+ * @param onSplice Optional. Fired after each rewrite, so callers can keep track of where the cuts were made, and which of the key's cdn urls went in
+ * @param onUnfinished Optional. Fired if the data ends in the middle of a tag (never for css).
+ *                 If given, we leave that tag alone so it can be parsed again with more data
+ * @returns The place where we reading when we hit @a end - if we were in the middle of a tag
+ *          and were given @a onUnfinished, we'll return the position of the '<' (unless we'd
+ *          already changed it), otherwise, it'll be the same as end.
  */
 template <typename iterator>
 iterator rewriteHTML(const std::string &server_url, const std::string &location,
                      const Config &config, iterator start, iterator end,
-                     RangeEvent<iterator> noChange, DataEvent newData, bool isCSS);
+                     RangeEvent<iterator> noChange, DataEvent newData, bool isCSS,
+                     SpliceEvent onSplice = {},
+                     UnfinishedEvent onUnfinished = {});
 
 /** Rewrites links and references in HTML output to point to the CDN.
  *  For example /images/a.gif could become http://cdn.yoursite.com/images/a.gif
@@ -69,16 +84,21 @@ iterator rewriteHTML(const std::string &server_url, const std::string &location,
  *                 See whe rewriteHTML function for a more concrete example.
  * @param newData  Event fired when new data for the output stream has been generated
  * @param isCSS    This is a css file
- * @returns The place where we reading when we hit @a end - at the time of writing
- *          if we were in the middle of a tag, we'll return the position of the '<',
- *          otherwise, it'll be the same as end.
+ * @param onSplice Optional. Fired after each rewrite, so callers can keep track of where the cuts were made, and which of the key's cdn urls went in
+ * @param onUnfinished Optional. Fired if the data ends in the middle of a tag (never for css).
+ *                 If given, we leave that tag alone so it can be parsed again with more data
+ * @returns The place where we reading when we hit @a end - if we were in the middle of a tag
+ *          and were given @a onUnfinished, we'll return the position of the '<' (unless we'd
+ *          already changed it), otherwise, it'll be the same as end.
  */
 template <typename iterator>
 inline iterator rewriteHTML(const std::string& location,
                      const Config& config, iterator start, iterator end,
-                     RangeEvent<iterator> noChange, DataEvent newData, bool isCSS) {
+                     RangeEvent<iterator> noChange, DataEvent newData, bool isCSS,
+                     SpliceEvent onSplice = {},
+                     UnfinishedEvent onUnfinished = {}) {
   return rewriteHTML("", location, config, start, end, noChange, newData,
-                     isCSS);
+                     isCSS, onSplice, onUnfinished);
 }
 
 }
@@ -7,9 +7,11 @@
 #include "Rewriter.hpp"
 
 #include "Config.hpp"
+#include "Memo.hpp"
+#include "Probes.hpp"
+#include "Stats.hpp"
 #include "utils.hpp"
 #include "parser/css.hpp"
-#include "parser/path.hpp"
 #include "parser/html.hpp"
 
 #include <algorithm>
@@ -25,21 +27,36 @@ template <typename iterator>
 iterator rewriteHTML(const std::string &server_url, const std::string &location,
                      const Config &config, iterator start, iterator end,
                      RangeEvent<iterator> noChange, DataEvent newData,
-                     bool isCSS) {
+                     bool isCSS, SpliceEvent onSplice,
+                     UnfinishedEvent onUnfinished) {
+
+  stats::Timer timer;
+  const void *request = probes::request();
+  CDNALIZER_PROBE(rewrite__entry, request, static_cast<int>(isCSS));
 
   iterator nextNoChangeStart = start;
 
   const std::string empty;
+  /// The cdn url a wildcard key made, for the Change that refers to it
+  std::string patternUrl;
 
   struct Change {
     boost::iterator_range<iterator> path;
     size_t howMuchToCut;
     const std::string &newData;
+    /// The config key that matched
+    const std::string &key;
+    /// Where in path its version goes (see Config::versionSplice), or npos
+    size_t insertAt = std::string::npos;
+    /// The version to put there
+    std::string insert = {};
+    /// Which of the key's cdn urls newData is, see Config::hostOf()
+    size_t host = 0;
     bool empty() const {
       return (path.empty()) && (howMuchToCut == 0) && (newData.empty());
     }
     size_t size() const {
-      return std::distance(path.begin(), path.end());
+      return utils::distance(path.begin(), path.end());
     }
   };
 
@@ -105,6 +122,29 @@ iterator rewriteHTML(const std::string &server_url, const std::string &location,
     //
     //
 
+    // Have we seen this url, from this page, with this config before ?
+    memo::Cache &memory = memo::local();
+    memo::Cache::Key memoKey;
+    if (const memo::Decision *known =
+            memory.find(config.fingerprint(), server_url, location,
+                        path_range.begin(), path_range.end(), memoKey)) {
+      stats::add(stats::Counter::memoHits);
+      if (known->entry == memo::none)
+        return {{}, 0, empty, empty};
+      auto found = config.entry(known->entry);
+      stats::hit(found.first);
+      return {path_range, known->cut, config.url(known->entry, known->host),
+              found.first, known->insertAt, known->insert, known->host};
+    }
+    stats::add(stats::Counter::memoMisses);
+    auto remember = [&](size_t entry, size_t cut, size_t host = 0,
+                        size_t insertAt = std::string::npos,
+                        const std::string &insert = {}) {
+      memory.store(memoKey, config.fingerprint(), server_url, location,
+                   path_range.begin(), path_range.end(),
+                   {entry, host, cut, insertAt, insert});
+    };
+
     // After transmitting, we'll need to know how much of the url to skip over.
     // eg. we don't need to transmit our server URL
     int skipOverCount = 0;
@@ -117,8 +157,7 @@ iterator rewriteHTML(const std::string &server_url, const std::string &location,
         canonical.push_back('/');
         --skipOverCount;
       }
-      std::copy(path_range.begin(), path_range.end(),
-                std::back_inserter(canonical));
+      canonical.append(path_range.begin(), path_range.end());
       // The written url will be 'images/x', but canonical will be
       // '/blog/images/x'
       // later we'll find that '/blog/images/' is in the config, so skip over 12
@@ -158,16 +197,44 @@ iterator rewriteHTML(const std::string &server_url, const std::string &location,
     // See if we have a replacement, if we search for /images/abc.gif .. we'll
     // get the CDN for /images/ (if that's in the config)
     // 'found' will be like {"/images/", "http://cdn.supa.ws/images/"}
+    stats::add(stats::Counter::lookups);
     auto found(config.findCDNUrl(canonical));
-    if (found.first.empty() && found.second.empty()) {
+    size_t matched = found.first.size();
+    // A wildcard key wins if it matches more of the path
+    const std::string *pattern = nullptr;
+    if (config.hasPatterns()) {
+      size_t length;
+      const std::string *key = config.findPattern(canonical, patternUrl, length);
+      if ((key != nullptr) && (length > matched)) {
+        pattern = key;
+        matched = length;
+      }
+    }
+    if ((pattern == nullptr) && found.first.empty() && found.second.empty()) {
       // We found nothing
-      return {{}, 0, empty};
+      remember(memo::none, 0);
+      return {{}, 0, empty, empty};
     }
+    // Only static files can go to the CDN
+    if (!config.isStatic(canonical)) {
+      stats::add(stats::Counter::dynamicPaths);
+      remember(memo::none, 0);
+      return {{}, 0, empty, empty};
+    }
+    // Files the sync tool hasn't uploaded yet stay with us
+    if (!config.isUploaded(canonical)) {
+      stats::add(stats::Counter::notUploaded);
+      remember(memo::none, 0);
+      return {{}, 0, empty, empty};
+    }
+    const std::string &base_path = pattern ? *pattern : found.first;
+    // A key spread over several hosts always sends this path to the same one
+    size_t entry = pattern ? config.size() : config.indexOf(base_path);
+    size_t host = pattern ? 0 : config.hostOf(entry, canonical);
+    const std::string &cdn_url = pattern ? patternUrl : config.url(entry, host);
+    stats::hit(base_path);
 
-    skipOverCount += found.first.size();
-
-    const std::string &base_path = found.first;
-    const std::string &cdn_url = found.second;
+    skipOverCount += matched;
 
     // We have three possible situations here:
     // 1. * path_range = "/images/x.jpg"
@@ -183,10 +250,26 @@ iterator rewriteHTML(const std::string &server_url, const std::string &location,
     //    * canonical = "/images/x.jpg"
     //    * cdn_url = "http://cdn.supa.ws/images/"
 
-    size_t howMuchToCut = std::distance(path_range.begin(), path_range.end()) -
-                          (canonical.size() - base_path.size());
+    size_t howMuchToCut = utils::distance(path_range.begin(), path_range.end()) -
+                          (canonical.size() - matched);
+
+    // Put the file's version in, if it has one and it comes after the part
+    // we're swapping for cdn_url
+    std::string insert;
+    size_t insertAt = config.versionSplice(canonical, insert);
+    if (insertAt != std::string::npos) {
+      size_t length = utils::distance(path_range.begin(), path_range.end());
+      // The end of canonical is the end of the path as written
+      insertAt = (canonical.size() - insertAt <= length - howMuchToCut)
+                     ? length - (canonical.size() - insertAt)
+                     : std::string::npos;
+    }
 
-    return {path_range, howMuchToCut, cdn_url};
+    // Each path makes its own url from a pattern, so there's nothing to share
+    if (pattern == nullptr)
+      remember(entry, howMuchToCut, host, insertAt, insert);
+    return {path_range, howMuchToCut, cdn_url, base_path, insertAt,
+            std::move(insert), host};
   };
 
   // Emit the change handlers
@@ -195,6 +278,7 @@ iterator rewriteHTML(const std::string &server_url, const std::string &location,
     assert(noChange);
     assert(newData);
     assert(!change.empty());
+    CDNALIZER_PROBE(splice__entry, request, change.key.c_str());
 
     // Find the distance from the end of the pas to pos, so we can reset pos later
     auto distance = change.size();
@@ -210,17 +294,34 @@ iterator rewriteHTML(const std::string &server_url, const std::string &location,
     // Send the new data (which is the new cdn url)
     newData(change.newData);
 
-    // We need to return the new position
-    auto result = nextNoChangeStart;
-    std::advance(result, distance);
-
     // Skip over the parts of the path that we replaced.
-    std::advance(nextNoChangeStart, change.howMuchToCut);
+    utils::advance(nextNoChangeStart, change.howMuchToCut);
+    size_t cut = change.howMuchToCut;
 
     // Avoid "//" in output
     if ((!change.newData.empty()) && (change.newData.back() == '/') &&
-        (*nextNoChangeStart == '/'))
+        (*nextNoChangeStart == '/')) {
       ++nextNoChangeStart;
+      ++cut;
+    }
+
+    if (onSplice)
+      onSplice(change.key, change.host, cut);
+    CDNALIZER_PROBE(splice__return, request, change.key.c_str(), cut);
+
+    // Splice in the version; like above, this may invalidate iterators
+    size_t done = cut;
+    if ((change.insertAt != std::string::npos) && (change.insertAt >= cut)) {
+      auto at = nextNoChangeStart;
+      utils::advance(at, change.insertAt - cut);
+      nextNoChangeStart = noChange(nextNoChangeStart, at);
+      newData(std::move(change.insert));
+      done = change.insertAt;
+    }
+
+    // We need to return the new position
+    auto result = nextNoChangeStart;
+    utils::advance(result, distance - done);
 
     // Return the new end of path, so parsing can continue
     return result; };
@@ -228,6 +329,22 @@ iterator rewriteHTML(const std::string &server_url, const std::string &location,
   // Find a path to replace in the html/css
   iterator pos = start;
 
+  // With onUnfinished, a tag that runs off the end is left untouched, and we
+  // return its '<' so the caller can parse it again with more data
+  iterator tagStart = start;
+  bool tagChanged = false;
+  bool tagHeld = false;
+  /// @returns true if we can change this tag. Before its first change, make
+  /// sure it has a '>' to end on; if not, hold the whole tag back.
+  auto mayChange = [&](const Change &change) {
+    if (!onUnfinished || tagChanged)
+      return true;
+    if (!tagHeld && (utils::find(change.path.end(), end, '>') == end))
+      tagHeld = true;
+    tagChanged = !tagHeld;
+    return tagChanged;
+  };
+
   // See if we're looking for css urls or html/xml
   if (isCSS) {
     while (pos != end) {
@@ -235,8 +352,6 @@ iterator rewriteHTML(const std::string &server_url, const std::string &location,
                                      iterator path_begin, iterator path_end) {
                          auto path =
                              boost::make_iterator_range(path_begin, path_end);
-                         if (!parser::isPathStatic(path))
-                           return;
                          Change change = handlePath(path);
                          if (!change.empty()) {
                            pos = operateOnBuckets(std::move(change));
@@ -246,34 +361,33 @@ iterator rewriteHTML(const std::string &server_url, const std::string &location,
   } else {
     std::function<void(boost::iterator_range<iterator>)> onTagNameFound =
         [&](boost::iterator_range<iterator> tag_name) {
+          stats::add(stats::Counter::tagsParsed);
           // For now we'll just ignore everything inside of java script
           const std::string script("script");
           auto comp = [](auto a, auto b) { return std::tolower(a) == std::tolower(b); };
-          if ((std::distance(tag_name.begin(), tag_name.end()) ==
+          if ((utils::distance(tag_name.begin(), tag_name.end()) ==
                std::distance(script.begin(), script.end())) &&
               std::equal(tag_name.begin(), tag_name.end(), script.begin(),
                          script.end(), comp)) {
             // Find </script> then continue parsing the HTML
             const std::string end_script("</script>");
-            pos = std::search(pos, end, end_script.begin(), end_script.end(),
-                              comp);
+            pos = utils::searchCaseless(pos, end, end_script);
             if (pos != end)
-              std::advance(pos, end_script.size());
+              utils::advance(pos, end_script.size());
           }
         };
     std::function<void(boost::iterator_range<iterator>,
                        boost::iterator_range<iterator>)>
-        onAttributeFound = [&pos, &handlePath, &operateOnBuckets](
+        onAttributeFound = [&pos, &handlePath, &operateOnBuckets, &mayChange](
             boost::iterator_range<iterator> name,
             boost::iterator_range<iterator> value) {
+          stats::add(stats::Counter::attributesTested);
           if (name != "style"s) {
             // This is a normal attribute; treat the whole thing as a path
-            if (parser::isPathStatic(value)) {
-              Change change(handlePath(value));
-              if (!change.empty())
-                pos = operateOnBuckets(std::move(
-                    change)); // Set the new pos, because we are mid-parse
-            }
+            Change change(handlePath(value));
+            if (!change.empty() && mayChange(change))
+              pos = operateOnBuckets(std::move(
+                  change)); // Set the new pos, because we are mid-parse
           } else {
             // If we have a style attribute, parse through it again, searching
             // for css paths, rather than treat it as a single path in itself.
@@ -287,24 +401,22 @@ iterator rewriteHTML(const std::string &server_url, const std::string &location,
                       iterator path_begin, iterator path_end) {
                     auto path =
                         boost::make_iterator_range(path_begin, path_end);
-                    if (!parser::isPathStatic(path))
-                      return;
                     Change change = handlePath(path);
-                    if (!change.empty()) {
+                    if (!change.empty() && mayChange(change)) {
                       // After operating on buckets, it will return
                       // change.path.end() and all other iterators will be
                       // invalid, so we need to grab distances now
                       auto dist_to_attr_pos =
-                          std::distance(change.path.end(), attribPos);
+                          utils::distance(change.path.end(), attribPos);
                       auto dist_to_attr_end =
-                          std::distance(change.path.end(), attribEnd);
+                          utils::distance(change.path.end(), attribEnd);
                       auto end_of_path = operateOnBuckets(std::move(change));
                       // All the other iterators are now invalid, because a
                       // bucket
                       // has been split
                       attribPos = attribEnd = pos = end_of_path;
-                      std::advance(attribPos, dist_to_attr_pos);
-                      std::advance(attribEnd, dist_to_attr_end);
+                      utils::advance(attribPos, dist_to_attr_pos);
+                      utils::advance(attribEnd, dist_to_attr_end);
                       pos = attribEnd;
                     }
                   }));
@@ -313,17 +425,30 @@ iterator rewriteHTML(const std::string &server_url, const std::string &location,
         };
     while (pos != end) {
       // Find tag
-      while ((pos != end) && (*pos != '<'))
-        ++pos;
+      pos = utils::find(pos, end, '<');
       if (pos == end)
         break;
       // Parse a single tag
-      parser::parseHTMLTag<iterator>(pos, end, onTagNameFound,
-                                     onAttributeFound);
+      tagStart = pos;
+      tagChanged = tagHeld = false;
+      CDNALIZER_PROBE(tag__entry, request);
+      bool finished = parser::parseHTMLTag<iterator>(pos, end, onTagNameFound,
+                                                     onAttributeFound);
+      CDNALIZER_PROBE(tag__return, request);
+      if ((pos == end) && !finished && onUnfinished) {
+        onUnfinished();
+        // Only a tag we've already changed (it had a '>', but in quotes) has
+        // to stay cut
+        if (!tagChanged)
+          end = tagStart;
+        break;
+      }
     }
   };
   // We can push out the unchanged data now
   assert(noChange);
-  return noChange(nextNoChangeStart, end);
+  iterator result = noChange(nextNoChangeStart, end);
+  CDNALIZER_PROBE(rewrite__return, request, static_cast<int>(isCSS));
+  return result;
 }
 }
@@ -0,0 +1,131 @@
+/**
+ * © Copyright 2017 Matthew Sherborne. All Rights Reserved.
+ * License: Apache License, Version 2.0 (See LICENSE.txt)
+ **/
+#include "Search.hpp"
+
+#include <map>
+#include <memory>
+
+namespace cdnalizer {
+namespace search {
+
+const char *findContext(const char *p, const char *e) {
+  // Check a word at a time for any of the three bytes, with the classic
+  // 'has a zero byte' trick on the word xored with each of them
+  constexpr std::uint64_t ones = 0x0101010101010101ull;
+  constexpr std::uint64_t highs = ones * 0x80;
+  auto has = [](std::uint64_t word, unsigned char c) {
+    std::uint64_t x = word ^ (ones * c);
+    return (x - ones) & ~x & highs;
+  };
+  while (e - p >= 8) {
+    std::uint64_t word;
+    std::memcpy(&word, p, sizeof(word));
+    if (has(word, '"') | has(word, '\'') | has(word, '('))
+      break;
+    p += 8;
+  }
+  while ((p != e) && !isContext(*p))
+    ++p;
+  return p;
+}
+
+namespace {
+
+/// @returns true if @a pattern could sit in a quoted string or url()
+bool searchable(const std::string &pattern) {
+  if (pattern.empty())
+    return false;
+  for (char c : pattern)
+    if (isContext(c) || (c == ')') || isSpace(c))
+      return false;
+  return true;
+}
+
+/// Each thread's recently built Patterns
+struct Cached {
+  size_t fingerprint;
+  std::string server_url;
+  std::string location;
+  std::unique_ptr<Patterns> patterns;
+};
+constexpr size_t cacheSize = 4;
+
+}
+
+Patterns::Patterns(const Config &config, const std::string &server_url,
+                   const std::string &location) {
+  std::string base(location);
+  if (base.empty() || (base.back() != '/'))
+    base.push_back('/');
+  // Build a trie with maps for children, then flatten it
+  std::vector<std::map<unsigned char, std::uint32_t>> children(1);
+  std::vector<std::uint32_t> ends(1, 0);
+  auto add = [&](const std::string &pattern, std::uint32_t entry) {
+    if (!searchable(pattern))
+      return;
+    std::uint32_t node = 0;
+    for (unsigned char c : pattern) {
+      auto found = children[node].find(c);
+      if (found == children[node].end()) {
+        std::uint32_t next = children.size();
+        children[node][c] = next;
+        children.emplace_back();
+        ends.push_back(0);
+        node = next;
+      } else {
+        node = found->second;
+      }
+    }
+    // Where two keys make the same pattern (eg. 'http://x/a' and '/a' with
+    // a server_url of 'http://x'), the first added wins
+    if (ends[node] == 0) {
+      matches.push_back(entry);
+      ends[node] = matches.size();
+    }
+  };
+  // The keys themselves first, so they win over server_url + key
+  for (size_t i = 0; i != config.size(); ++i)
+    add(config.entry(i).first, i);
+  for (size_t i = 0; i != config.size(); ++i) {
+    const std::string &key = config.entry(i).first;
+    if (!server_url.empty() && !key.empty() && (key.front() == '/'))
+      add(server_url + key, i);
+    if ((key.size() > base.size()) &&
+        (key.compare(0, base.size(), base) == 0))
+      add(key.substr(base.size()), i);
+  }
+  nodes.resize(children.size());
+  for (size_t i = 0; i != children.size(); ++i) {
+    Node &node = nodes[i];
+    node.firstEdge = edges.size();
+    node.edgeCount = children[i].size();
+    node.match = ends[i];
+    for (auto &child : children[i])
+      edges.emplace_back(child.first, child.second);
+  }
+  for (auto &child : children[0])
+    root[child.first] = child.second;
+}
+
+const Patterns &Patterns::get(const Config &config,
+                              const std::string &server_url,
+                              const std::string &location) {
+  thread_local std::array<Cached, cacheSize> cache;
+  thread_local size_t nextVictim = 0;
+  for (auto &cached : cache)
+    if (cached.patterns && (cached.fingerprint == config.fingerprint()) &&
+        (cached.server_url == server_url) && (cached.location == location))
+      return *cached.patterns;
+  Cached &victim = cache[nextVictim];
+  nextVictim = (nextVictim + 1) % cacheSize;
+  victim.patterns.reset(new Patterns(config, server_url, location));
+  victim.fingerprint = config.fingerprint();
+  victim.server_url = server_url;
+  victim.location = location;
+  return *victim.patterns;
+}
+
+}
+}
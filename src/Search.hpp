@@ -0,0 +1,274 @@
+#pragma once
+/** A second rewrite engine: finds CDN_URL keys with a multi-pattern search,
+ * instead of parsing every tag.
+ *
+ * Much like mod_substitute, it only looks at the bytes that could start a
+ * url: the character after a quote or a '(' (plus any spaces after the
+ * '('). From there it walks a trie of every pattern we could splice:
+ *
+ *  * each CDN_URL key, eg. '/images'
+ *  * server_url + key, eg. 'http://www.supa.ws/images'
+ *  * keys under the current location, relative to it, eg. 'images' in /
+ *
+ * If a key matches, it reads on to the closing quote or bracket, checks the
+ * whole path with the PathClassifier, and splices through the same
+ * noChange/newData/onSplice events as rewriteHTML. Wildcard keys (see
+ * Wildcards.hpp) aren't in the trie; the apache filter uses rewriteHTML for
+ * configs that have them.
+ *
+ * It's not an HTML parser: it rewrites any quoted string or url() that
+ * starts with a key, including ones in scripts and in text. In return it
+ * never builds a tag, and skips to the next quote or bracket a word at a
+ * time.
+ *
+ * © Copyright 2017 Matthew Sherborne. All Rights Reserved.
+ * License: Apache License, Version 2.0 (See LICENSE.txt)
+ **/
+
+#include "Config.hpp"
+#include "Probes.hpp"
+#include "Rewriter.hpp"
+#include "Stats.hpp"
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace cdnalizer {
+
+/// Which engine rewrites a response (CDN_ENGINE)
+enum class Engine { parser, search };
+
+namespace search {
+
+/// @returns true for the bytes a url can start after
+inline bool isContext(char c) { return (c == '"') || (c == '\'') || (c == '('); }
+
+/// @returns true for the bytes that end a url
+inline bool isSpace(char c) {
+  return (c == ' ') || (c == '\t') || (c == '\n') || (c == '\r');
+}
+
+/// @returns a pointer to the first context byte in [p, e), or e
+const char *findContext(const char *p, const char *e);
+
+/// Moves @a pos to the next context byte, or @a end. Contiguous iterators get
+/// the word at a time search. Block iterators provide their own overload
+/// (found by ADL), see apache/iterator.hpp.
+template <typename Iterator>
+void skipToContext(Iterator &pos, const Iterator &end, std::true_type) {
+  const char *start = &*pos;
+  std::advance(pos, findContext(start, start + std::distance(pos, end)) - start);
+}
+template <typename Iterator>
+void skipToContext(Iterator &pos, const Iterator &end, std::false_type) {
+  while ((pos != end) && !isContext(*pos))
+    ++pos;
+}
+template <typename Iterator>
+void skipToContext(Iterator &pos, const Iterator &end) {
+  if (pos != end)
+    skipToContext(pos, end, utils::is_contiguous<Iterator>());
+}
+
+/// The trie of everything we could splice, for one config, server_url and
+/// location
+class Patterns {
+private:
+  /// Children are kept in a flat list of (byte, child) edges per node; the
+  /// root has a full table, as we try it at every context byte
+  struct Node {
+    std::uint32_t firstEdge = 0;
+    std::uint16_t edgeCount = 0;
+    /// Index in matches + 1, or 0 if no pattern ends here
+    std::uint32_t match = 0;
+  };
+  std::array<std::uint32_t, 256> root{};
+  std::vector<Node> nodes;
+  std::vector<std::pair<unsigned char, std::uint32_t>> edges;
+  /// The config entry for each pattern
+  std::vector<std::uint32_t> matches;
+
+public:
+  Patterns(const Config &config, const std::string &server_url,
+           const std::string &location);
+
+  /// @returns the node after @a node on byte @a c, or 0 if there isn't one.
+  /// Node 0 is the root.
+  std::uint32_t next(std::uint32_t node, unsigned char c) const {
+    if (node == 0)
+      return root[c];
+    const Node &from = nodes[node];
+    for (auto i = from.firstEdge, e = i + from.edgeCount; i != e; ++i)
+      if (edges[i].first == c)
+        return edges[i].second;
+    return 0;
+  }
+  /// @returns true if a pattern ends at @a node
+  bool isMatch(std::uint32_t node) const { return nodes[node].match != 0; }
+  /// @returns the config entry of the pattern that ends at @a node
+  std::uint32_t entry(std::uint32_t node) const {
+    return matches[nodes[node].match - 1];
+  }
+  bool empty() const { return matches.empty(); }
+
+  /// @returns the compiled patterns for these arguments. Each thread keeps
+  /// the last few it built.
+  static const Patterns &get(const Config &config,
+                             const std::string &server_url,
+                             const std::string &location);
+};
+
+/// The longest we'll read looking for the end of a url
+constexpr size_t maxPathLength = 2048;
+
+}
+
+/** Rewrites links to point at the CDN, using the search engine.
+ *
+ * Takes the same arguments, fires the same events and has the same return
+ * contract as rewriteHTML (see Rewriter.hpp). It treats HTML and CSS the
+ * same way.
+ */
+template <typename iterator>
+iterator searchAndRewrite(const std::string &server_url,
+                          const std::string &location, const Config &config,
+                          iterator start, iterator end,
+                          RangeEvent<iterator> noChange, DataEvent newData,
+                          SpliceEvent onSplice = {}) {
+  using search::isContext;
+  stats::Timer timer;
+  const void *request = probes::request();
+  CDNALIZER_PROBE(rewrite__entry, request, 2);
+  const search::Patterns &patterns =
+      search::Patterns::get(config, server_url, location);
+  iterator nextNoChangeStart = start;
+  // Passes on the rest, up to @a to, and returns where we got to
+  auto finish = [&](const iterator &to) {
+    iterator result = noChange(nextNoChangeStart, to);
+    CDNALIZER_PROBE(rewrite__return, request, 2);
+    return result;
+  };
+  if (patterns.empty())
+    return finish(end);
+
+  // The canonical path of the candidate we're checking, and its version;
+  // kept to save allocs
+  std::string canonical;
+  std::string insert;
+  iterator pos = start;
+  while (true) {
+    using search::skipToContext;
+    skipToContext(pos, end);
+    if (pos == end)
+      break;
+    iterator contextStart = pos;
+    char opener = *pos;
+    ++pos;
+    // url( can have spaces before the path
+    if (opener == '(')
+      while ((pos != end) && search::isSpace(*pos))
+        ++pos;
+    // Walk the trie for the longest pattern
+    iterator matchStart = pos;
+    std::uint32_t found = 0;
+    size_t foundLength = 0;
+    size_t length = 0;
+    std::uint32_t node = 0;
+    while (pos != end) {
+      node = patterns.next(node, *pos);
+      if (node == 0)
+        break;
+      ++pos;
+      ++length;
+      if (patterns.isMatch(node)) {
+        found = node;
+        foundLength = length;
+      }
+    }
+    // If we ran out of data part way through a candidate, let the caller
+    // give it to us again with more data
+    if (pos == end)
+      return finish(contextStart);
+    if (found == 0)
+      continue; // pos is on the byte that didn't match; it may be a context
+    stats::add(stats::Counter::lookups);
+    size_t entry = patterns.entry(found);
+    const std::string &key = config.entry(entry).first;
+    // Read the rest of the path, up to the closing quote or bracket
+    canonical.assign(key);
+    iterator scan = matchStart;
+    utils::advance(scan, foundLength);
+    iterator afterKey = scan;
+    char closer = (opener == '(') ? ')' : opener;
+    size_t read = 0;
+    while ((scan != end) && (*scan != closer) && !search::isSpace(*scan) &&
+           (opener != '(' || !isContext(*scan)) &&
+           (read < search::maxPathLength)) {
+      canonical.push_back(*scan);
+      ++scan;
+      ++read;
+    }
+    if (scan == end)
+      return finish(contextStart);
+    // Urls don't have spaces in them, and quoted ones need their closing quote
+    if ((read == search::maxPathLength) ||
+        ((opener != '(') && (*scan != closer))) {
+      pos = scan;
+      continue;
+    }
+    bool closed = *scan == closer;
+    bool isStatic = config.isStatic(canonical);
+    if (!isStatic || !config.isUploaded(canonical)) {
+      stats::add(isStatic ? stats::Counter::notUploaded
+                          : stats::Counter::dynamicPaths);
+      pos = scan;
+      if (closed)
+        ++pos;
+      continue;
+    }
+    size_t host = config.hostOf(entry, canonical);
+    const std::string &cdn_url = config.url(entry, host);
+    stats::hit(key);
+    CDNALIZER_PROBE(splice__entry, request, key.c_str());
+    size_t cut = foundLength;
+    // Avoid "//" in output
+    bool doubleSlash = !cdn_url.empty() && (cdn_url.back() == '/') &&
+                       (afterKey != scan) && (*afterKey == '/');
+    if (doubleSlash)
+      ++cut;
+    size_t pathLeft = read - (doubleSlash ? 1 : 0) + (closed ? 1 : 0);
+    // Where the version goes, counting from matchStart. canonical is the key
+    // and then the rest of the path as written.
+    size_t insertAt = config.versionSplice(canonical, insert);
+    if ((insertAt != std::string::npos) && (insertAt >= key.size()) &&
+        (foundLength + (insertAt - key.size()) >= cut))
+      insertAt = foundLength + (insertAt - key.size()) - cut;
+    else
+      insertAt = std::string::npos;
+    // Output everything before the match as unchanged. After this, all
+    // iterators apart from nextNoChangeStart may be invalid.
+    nextNoChangeStart = noChange(nextNoChangeStart, matchStart);
+    newData(cdn_url);
+    utils::advance(nextNoChangeStart, cut);
+    if (onSplice)
+      onSplice(key, host, cut);
+    CDNALIZER_PROBE(splice__return, request, key.c_str(), cut);
+    if (insertAt != std::string::npos) {
+      iterator at = nextNoChangeStart;
+      utils::advance(at, insertAt);
+      nextNoChangeStart = noChange(nextNoChangeStart, at);
+      newData(insert);
+      pathLeft -= insertAt;
+    }
+    pos = nextNoChangeStart;
+    utils::advance(pos, pathLeft);
+  }
+  return finish(end);
+}
+
+}
@@ -0,0 +1,84 @@
+/**
+ * © Copyright 2017 Matthew Sherborne. All Rights Reserved.
+ * License: Apache License, Version 2.0 (See LICENSE.txt)
+ **/
+#include "Stats.hpp"
+
+#include <algorithm>
+#include <tuple>
+#include <vector>
+
+namespace cdnalizer {
+namespace stats {
+
+namespace {
+
+/// Every live thread's Block, plus what the dead threads left behind
+struct Registry {
+  std::mutex lock;
+  std::vector<Block *> blocks;
+  Totals retired;
+};
+
+Registry &registry() {
+  // Never destroyed, so threads that exit during shutdown can still find it
+  static Registry *result = new Registry;
+  return *result;
+}
+}
+
+const char *name(Counter counter) {
+  static const char *names[counterCount] = {
+      "bytesScanned",  "tagsParsed",       "attributesTested", "dynamicPaths",
+      "notUploaded",   "lookups",          "hits",             "bucketSplits",
+      "heapBuckets",   "leftoverBytes",    "bucketsCoalesced", "memoHits",
+      "memoMisses",    "rewriteNanoseconds"};
+  return names[static_cast<size_t>(counter)];
+}
+
+Block::Block() {
+  Registry &all = registry();
+  std::lock_guard<std::mutex> guard(all.lock);
+  all.blocks.push_back(this);
+}
+
+Block::~Block() {
+  Registry &all = registry();
+  std::lock_guard<std::mutex> guard(all.lock);
+  addTo(all.retired);
+  all.blocks.erase(std::find(all.blocks.begin(), all.blocks.end(), this));
+}
+
+void Block::hit(const std::string &prefix) {
+  add(Counter::hits, 1);
+  auto found = hits.find(prefix);
+  if (found == hits.end()) {
+    std::lock_guard<std::mutex> guard(hitsLock);
+    found = hits.emplace(std::piecewise_construct,
+                         std::forward_as_tuple(prefix),
+                         std::forward_as_tuple(0))
+                .first;
+  }
+  auto &value = found->second;
+  value.store(value.load(std::memory_order_relaxed) + 1,
+              std::memory_order_relaxed);
+}
+
+void Block::addTo(Totals &totals) {
+  for (size_t i = 0; i < counterCount; ++i)
+    totals.counters[i] += counters[i].load(std::memory_order_relaxed);
+  std::lock_guard<std::mutex> guard(hitsLock);
+  for (auto &pair : hits)
+    totals.hits[pair.first] += pair.second.load(std::memory_order_relaxed);
+}
+
+Totals collect() {
+  Registry &all = registry();
+  std::lock_guard<std::mutex> guard(all.lock);
+  Totals result = all.retired;
+  for (Block *block : all.blocks)
+    block->addTo(result);
+  return result;
+}
+}
+}
@@ -0,0 +1,115 @@
+#pragma once
+/** Counters that tell us what the rewriter costs
+ *
+ * Every thread keeps its own counters, so counting is just a plain add to
+ * thread local memory; no locks and no shared cache lines. collect() adds up
+ * all the threads (plus those that have exited) when someone asks.
+ *
+ * Counters are per process. Under Apache each child keeps its own, so a
+ * status page shows the child that served it.
+ *
+ * © Copyright 2017 Matthew Sherborne. All Rights Reserved.
+ * License: Apache License, Version 2.0 (See LICENSE.txt)
+ **/
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace cdnalizer {
+namespace stats {
+
+enum class Counter {
+  bytesScanned,       // Input bytes the rewriter got through
+  tagsParsed,         // HTML tags
+  attributesTested,   // HTML attributes looked at
+  dynamicPaths,       // Matched paths that weren't static (see PathClassifier)
+  notUploaded,        // Matched paths missing from the CDN_MANIFEST
+  lookups,            // Searches of the CDN_URL mappings
+  hits,               // Lookups that found a CDN_URL
+  bucketSplits,       // Apache buckets split
+  heapBuckets,        // Apache heap buckets created (for cdn urls)
+  leftoverBytes,      // Bytes carried over to the next brigade
+  bucketsCoalesced,   // Small output buckets merged away (see CDN_COALESCE_SIZE)
+  memoHits,           // Urls whose rewrite we remembered (see Memo.hpp)
+  memoMisses,         // Urls we had to work out
+  rewriteNanoseconds, // Time spent in rewriteHTML
+};
+constexpr size_t counterCount = static_cast<size_t>(Counter::rewriteNanoseconds) + 1;
+
+/// @returns the counter's name, eg. "bytesScanned"
+const char *name(Counter counter);
+
+/// A sum of the counters of every thread
+struct Totals {
+  std::array<std::uint64_t, counterCount> counters{};
+  /// Hits per CDN_URL prefix (the config key)
+  std::map<std::string, std::uint64_t> hits;
+  std::uint64_t operator[](Counter counter) const {
+    return counters[static_cast<size_t>(counter)];
+  }
+};
+
+/// One thread's counters. Only its own thread writes to them
+class Block {
+private:
+  std::array<std::atomic<std::uint64_t>, counterCount> counters{};
+  /// Only taken by us when we see a new prefix, and by collect()
+  std::mutex hitsLock;
+  std::unordered_map<std::string, std::atomic<std::uint64_t>> hits;
+
+public:
+  Block();
+  ~Block();
+  void add(Counter counter, std::uint64_t amount) {
+    // We're the only writer, so there's no need for a locked add; the
+    // atomic just stops collect() seeing a torn value
+    auto &value = counters[static_cast<size_t>(counter)];
+    value.store(value.load(std::memory_order_relaxed) + amount,
+                std::memory_order_relaxed);
+  }
+  void hit(const std::string &prefix);
+  /// Adds our counters to @a totals
+  void addTo(Totals &totals);
+};
+
+/// @returns the calling thread's counters
+inline Block &local() {
+  thread_local Block block;
+  return block;
+}
+
+/// Counts @a amount of something on this thread
+inline void add(Counter counter, std::uint64_t amount = 1) {
+  local().add(counter, amount);
+}
+
+/// Counts a CDN_URL hit for @a prefix on this thread
+inline void hit(const std::string &prefix) { local().hit(prefix); }
+
+/// @returns the totals for every thread in the process
+Totals collect();
+
+/// Adds the time from construction to destruction to a counter
+class Timer {
+private:
+  Counter counter;
+  std::chrono::steady_clock::time_point start;
+
+public:
+  explicit Timer(Counter counter = Counter::rewriteNanoseconds)
+      : counter(counter), start(std::chrono::steady_clock::now()) {}
+  Timer(const Timer &) = delete;
+  ~Timer() {
+    add(counter, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                     std::chrono::steady_clock::now() - start)
+                     .count());
+  }
+};
+}
+}
@@ -0,0 +1,220 @@
+/**
+ * © Copyright 2017 Matthew Sherborne. All Rights Reserved.
+ * License: Apache License, Version 2.0 (See LICENSE.txt)
+ **/
+#include "Wildcards.hpp"
+
+#include <algorithm>
+
+namespace cdnalizer {
+
+constexpr int Wildcards::star;
+constexpr int Wildcards::doubleStar;
+constexpr size_t Wildcards::maxStates;
+
+Wildcards::Wildcards(const std::map<std::string, std::string> &keys) {
+  for (const auto &pair : keys) {
+    const std::string &key = pair.first;
+    Pattern pattern;
+    pattern.key = key;
+    pattern.url = pair.second;
+    for (size_t i = 0; i != key.size(); ++i) {
+      if (key[i] != '*') {
+        pattern.tokens.push_back(static_cast<unsigned char>(key[i]));
+        ++pattern.literals;
+      } else if ((i + 1 != key.size()) && (key[i + 1] == '*')) {
+        pattern.tokens.push_back(doubleStar);
+        ++i;
+      } else {
+        pattern.tokens.push_back(star);
+      }
+    }
+    patterns.push_back(std::move(pattern));
+  }
+  compile();
+}
+
+void Wildcards::compile() {
+  // Every char a pattern names gets a byte class of its own, as do the ones
+  // wildcards stop at. Everything else is class 0.
+  std::array<bool, 256> named{};
+  named['/'] = named['?'] = named['#'] = true;
+  for (const auto &pattern : patterns)
+    for (int token : pattern.tokens)
+      if (token >= 0)
+        named[token] = true;
+  std::vector<int> examples{-1};
+  for (int c = 0; c != 256; ++c) {
+    if (named[c]) {
+      classOf[c] = static_cast<std::uint8_t>(examples.size());
+      examples.push_back(c);
+    } else {
+      classOf[c] = 0;
+      if (examples[0] == -1)
+        examples[0] = c;
+    }
+  }
+  classCount = examples.size();
+
+  // NFA positions are (pattern, token index) pairs, numbered in a row
+  std::vector<std::uint32_t> firstPosition;
+  std::vector<std::uint32_t> patternOf;
+  for (size_t p = 0; p != patterns.size(); ++p) {
+    firstPosition.push_back(patternOf.size());
+    patternOf.resize(patternOf.size() + patterns[p].tokens.size() + 1, p);
+  }
+  auto tokenIndex = [&](std::uint32_t position) {
+    return position - firstPosition[patternOf[position]];
+  };
+  // Wildcards can match nothing, so being before one is being after it too
+  auto close = [&](std::vector<std::uint32_t> &set) {
+    for (size_t i = 0; i != set.size(); ++i) {
+      const Pattern &pattern = patterns[patternOf[set[i]]];
+      size_t at = tokenIndex(set[i]);
+      if ((at != pattern.tokens.size()) && (pattern.tokens[at] < 0) &&
+          (std::find(set.begin(), set.end(), set[i] + 1) == set.end()))
+        set.push_back(set[i] + 1);
+    }
+    std::sort(set.begin(), set.end());
+  };
+
+  // Subset construction. State 0 is dead; state 1 is the start.
+  std::vector<std::vector<std::uint32_t>> sets(1);
+  std::map<std::vector<std::uint32_t>, std::uint32_t> ids;
+  auto state = [&](std::vector<std::uint32_t> set) -> std::uint32_t {
+    if (set.empty())
+      return 0;
+    close(set);
+    auto found = ids.find(set);
+    if (found != ids.end())
+      return found->second;
+    if (sets.size() == maxStates) {
+      tooBig = true;
+      return 0;
+    }
+    auto id = static_cast<std::uint32_t>(sets.size());
+    ids.emplace(set, id);
+    sets.push_back(std::move(set));
+    return id;
+  };
+  std::vector<std::uint32_t> start;
+  for (auto position : firstPosition)
+    start.push_back(position);
+  state(start);
+  for (size_t s = 1; (s < sets.size()) && !tooBig; ++s) {
+    table.resize((s + 1) * classCount, 0);
+    for (size_t k = 0; k != classCount; ++k) {
+      if (examples[k] == -1)
+        continue; // Every byte is named, so class 0 is empty
+      std::vector<std::uint32_t> next;
+      for (auto position : sets[s]) {
+        const Pattern &pattern = patterns[patternOf[position]];
+        size_t at = tokenIndex(position);
+        if ((at == pattern.tokens.size()) ||
+            !takes(pattern.tokens[at], examples[k]))
+          continue;
+        // Plain chars move on; wildcards can take more
+        next.push_back(pattern.tokens[at] >= 0 ? position + 1 : position);
+      }
+      std::sort(next.begin(), next.end());
+      next.erase(std::unique(next.begin(), next.end()), next.end());
+      auto to = state(std::move(next));
+      // state() may have grown sets, so index the table afresh
+      table[s * classCount + k] = to;
+    }
+  }
+  if (tooBig) {
+    table.clear();
+    return;
+  }
+  // Which pattern wins in each state
+  accepts.assign(sets.size(), -1);
+  for (size_t s = 1; s != sets.size(); ++s)
+    for (auto position : sets[s]) {
+      std::int32_t p = patternOf[position];
+      if (tokenIndex(position) != patterns[p].tokens.size())
+        continue;
+      if ((accepts[s] == -1) ||
+          (patterns[p].literals > patterns[accepts[s]].literals))
+        accepts[s] = p;
+    }
+}
+
+bool Wildcards::matches(const Pattern &pattern, size_t at, const char *start,
+                        const char *end,
+                        std::vector<std::string> &captures) const {
+  for (; at != pattern.tokens.size(); ++at) {
+    int token = pattern.tokens[at];
+    if (token >= 0) {
+      if ((start == end) || !takes(token, *start))
+        return false;
+      ++start;
+      continue;
+    }
+    // Take all we can, then give it back a char at a time
+    const char *stop = start;
+    while ((stop != end) && takes(token, *stop))
+      ++stop;
+    for (const char *split = stop;; --split) {
+      captures.emplace_back(start, split);
+      if (matches(pattern, at + 1, split, end, captures))
+        return true;
+      captures.pop_back();
+      if (split == start)
+        return false;
+    }
+  }
+  return start == end;
+}
+
+const std::string *Wildcards::find(const std::string &path, std::string &url,
+                                   size_t &length) const {
+  const char *start = path.data();
+  const char *end = start + path.size();
+  std::vector<std::string> captures;
+  const Pattern *best = nullptr;
+  length = 0;
+  if (tooBig) {
+    // The slow way: the longest match of each pattern
+    for (const auto &pattern : patterns)
+      for (size_t l = path.size(); (l != 0) && (l >= length); --l)
+        if (matches(pattern, 0, start, start + l, captures)) {
+          if ((best == nullptr) || (l > length) ||
+              (pattern.literals > best->literals)) {
+            best = &pattern;
+            length = l;
+          }
+          captures.clear();
+          break;
+        }
+  } else {
+    std::uint32_t state = 1;
+    for (const char *c = start; c != end; ++c) {
+      state = table[state * classCount + classOf[static_cast<unsigned char>(*c)]];
+      if (state == 0)
+        break;
+      if (accepts[state] != -1) {
+        best = &patterns[accepts[state]];
+        length = c + 1 - start;
+      }
+    }
+  }
+  if (best == nullptr)
+    return nullptr;
+  matches(*best, 0, start, start + length, captures);
+  // Fill in $1 to $9
+  const std::string &pattern = best->url;
+  url.clear();
+  for (size_t i = 0; i != pattern.size(); ++i) {
+    if ((pattern[i] == '$') && (i + 1 != pattern.size()) &&
+        (pattern[i + 1] >= '1') && (pattern[i + 1] <= '9')) {
+      size_t n = pattern[++i] - '1';
+      if (n < captures.size())
+        url.append(captures[n]);
+    } else {
+      url.push_back(pattern[i]);
+    }
+  }
+  return &best->key;
+}
+}
@@ -0,0 +1,91 @@
+#pragma once
+/** CDN_URL keys with wildcards in them
+ *
+ * A key can have '*', which matches part of one path segment (anything but
+ * '/'), and '**', which matches any number of segments. Neither matches a
+ * '?' or '#'. Each wildcard is a capture, and the cdn url can use them as
+ * $1 to $9. So a multisite WordPress can send each site's uploads to its
+ * own CDN host (see the README for examples). Like plain keys, a pattern
+ * only has to match the start of a path.
+ *
+ * All the patterns are compiled into one DFA, so finding which one matches
+ * is a single pass over the path, however many there are. Only the winner
+ * is then matched again to find its captures.
+ *
+ * © Copyright 2017 Matthew Sherborne. All Rights Reserved.
+ * License: Apache License, Version 2.0 (See LICENSE.txt)
+ **/
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace cdnalizer {
+
+class Wildcards {
+public:
+  /// @returns true if @a key has wildcards, and so belongs here
+  static bool isPattern(const std::string &key) {
+    return key.find('*') != std::string::npos;
+  }
+
+private:
+  /// A pattern broken into pieces
+  struct Pattern {
+    std::string key;
+    std::string url;
+    /// Each char of the key, with star and doubleStar for the wildcards
+    std::vector<int> tokens;
+    /// How many plain chars it has; when two patterns match the same
+    /// length, the one with more wins
+    size_t literals = 0;
+  };
+  static constexpr int star = -1;
+  static constexpr int doubleStar = -2;
+  std::vector<Pattern> patterns;
+
+  /// Bytes that every pattern treats the same way share a class
+  std::array<std::uint8_t, 256> classOf{};
+  size_t classCount = 1;
+  /// The next state for each state and byte class; 0 is the dead state and 1
+  /// the start
+  std::vector<std::uint32_t> table;
+  /// The pattern that matches when we reach each state, or -1
+  std::vector<std::int32_t> accepts;
+  /// Set if the DFA would have been too big; we try each pattern instead
+  bool tooBig = false;
+
+  /// @returns true if @a token (a char or a wildcard) can take @a c
+  static bool takes(int token, unsigned char c) {
+    if (token >= 0)
+      return token == c;
+    return (c != '?') && (c != '#') && ((token == doubleStar) || (c != '/'));
+  }
+  void compile();
+  /// @returns true if @a pattern's tokens from @a at match all of
+  /// [start, end), adding what each wildcard took to @a captures
+  bool matches(const Pattern &pattern, size_t at, const char *start,
+               const char *end, std::vector<std::string> &captures) const;
+
+public:
+  /// The most DFA states we'll make
+  static constexpr size_t maxStates = 1 << 16;
+
+  /// Compiles the (pattern, cdn url) pairs in @a keys
+  explicit Wildcards(const std::map<std::string, std::string> &keys);
+
+  /** Finds the best pattern that matches the start of @a path: the longest
+   * match, then the one with the most plain chars.
+   *
+   * @param url set to its cdn url, with the captures filled in
+   * @param length set to how much of @a path it matched
+   * @returns the pattern, or nullptr if none match
+   */
+  const std::string *find(const std::string &path, std::string &url,
+                          size_t &length) const;
+  /// @returns how many DFA states we made; 0 if it was too big
+  size_t states() const { return tooBig ? 0 : accepts.size(); }
+};
+}
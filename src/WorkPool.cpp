@@ -0,0 +1,111 @@
+/**
+ * © Copyright 2017 Matthew Sherborne. All Rights Reserved.
+ * License: Apache License, Version 2.0 (See LICENSE.txt)
+ **/
+#include "WorkPool.hpp"
+
+#include <algorithm>
+
+namespace cdnalizer {
+
+namespace {
+/// The pool, and queue number, of the worker running on this thread
+thread_local const WorkPool *currentPool = nullptr;
+thread_local size_t currentQueue = 0;
+}
+
+WorkPool::WorkPool(unsigned workers) {
+  workers = std::max(1u, workers);
+  for (unsigned i = 0; i != workers; ++i)
+    queues.emplace_back(new Queue);
+  for (unsigned i = 0; i != workers; ++i)
+    threads.emplace_back([this, i]() { work(i); });
+}
+
+WorkPool::~WorkPool() {
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (auto &thread : threads)
+    thread.join();
+}
+
+void WorkPool::submit(Task task) {
+  {
+    // The counts go up with the push, so a worker never sees a task before
+    // it's been counted
+    std::lock_guard<std::mutex> guard(lock);
+    size_t index = (currentPool == this) ? currentQueue
+                                         : nextQueue++ % queues.size();
+    std::lock_guard<std::mutex> queueGuard(queues[index]->lock);
+    queues[index]->tasks.push_back(std::move(task));
+    ++queued;
+    ++unfinished;
+  }
+  wake.notify_one();
+}
+
+bool WorkPool::take(size_t index, Task &task) {
+  {
+    Queue &own = *queues[index];
+    std::lock_guard<std::mutex> guard(own.lock);
+    if (!own.tasks.empty()) {
+      task = std::move(own.tasks.back());
+      own.tasks.pop_back();
+      return true;
+    }
+  }
+  for (size_t i = 1; i != queues.size(); ++i) {
+    Queue &victim = *queues[(index + i) % queues.size()];
+    std::lock_guard<std::mutex> guard(victim.lock);
+    if (!victim.tasks.empty()) {
+      task = std::move(victim.tasks.front());
+      victim.tasks.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+void WorkPool::work(size_t index) {
+  currentPool = this;
+  currentQueue = index;
+  while (true) {
+    Task task;
+    if (take(index, task)) {
+      {
+        std::lock_guard<std::mutex> guard(lock);
+        --queued;
+      }
+      std::exception_ptr thrown;
+      try {
+        task();
+      } catch (...) {
+        thrown = std::current_exception();
+      }
+      std::lock_guard<std::mutex> guard(lock);
+      if (thrown && !error)
+        error = thrown;
+      if (--unfinished == 0)
+        finished.notify_all();
+      continue;
+    }
+    std::unique_lock<std::mutex> guard(lock);
+    wake.wait(guard, [this]() { return stopping || (queued != 0); });
+    if (stopping && (queued == 0))
+      return;
+  }
+}
+
+void WorkPool::wait() {
+  std::unique_lock<std::mutex> guard(lock);
+  finished.wait(guard, [this]() { return unfinished == 0; });
+  if (error) {
+    std::exception_ptr thrown = error;
+    error = nullptr;
+    std::rethrow_exception(thrown);
+  }
+}
+}
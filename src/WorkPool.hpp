@@ -0,0 +1,75 @@
+#pragma once
+/** A fixed set of worker threads that share out tasks by work stealing
+ *
+ * Each worker has its own queue, and takes the newest task from the back of
+ * it. When that's empty it steals the oldest task from the front of another
+ * worker's queue. So a worker that got the big files doesn't hold everyone
+ * up: the others take its backlog off it once they run out of their own.
+ *
+ * Tasks submitted from a worker go on that worker's own queue; anything else
+ * is dealt out round robin.
+ *
+ * © Copyright 2017 Matthew Sherborne. All Rights Reserved.
+ * License: Apache License, Version 2.0 (See LICENSE.txt)
+ **/
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cdnalizer {
+
+class WorkPool {
+public:
+  using Task = std::function<void()>;
+
+private:
+  struct Queue {
+    std::mutex lock;
+    std::deque<Task> tasks;
+  };
+  std::vector<std::unique_ptr<Queue>> queues;
+  std::vector<std::thread> threads;
+  /// Guards the counts below, and is what idle workers and wait() sleep on
+  std::mutex lock;
+  std::condition_variable wake;
+  std::condition_variable finished;
+  /// Tasks in the queues
+  size_t queued = 0;
+  /// Tasks submitted but not yet done
+  size_t unfinished = 0;
+  size_t nextQueue = 0;
+  bool stopping = false;
+  /// The first exception a task threw, for wait() to throw
+  std::exception_ptr error;
+
+  /// Takes a task for worker @a index: its own newest, or someone else's
+  /// oldest
+  bool take(size_t index, Task &task);
+  void work(size_t index);
+
+public:
+  /// Starts @a workers threads (at least one)
+  explicit WorkPool(unsigned workers = std::thread::hardware_concurrency());
+  WorkPool(const WorkPool &) = delete;
+  WorkPool &operator=(const WorkPool &) = delete;
+  /// Runs everything that's been submitted, then stops the workers
+  ~WorkPool();
+
+  void submit(Task task);
+  /** Waits until every task submitted so far is done. Don't call it from a
+   * task; that worker would be waiting on itself.
+   *
+   * @throws the first exception a task threw since the last wait()
+   */
+  void wait();
+  /// @returns how many workers we have
+  size_t size() const { return threads.size(); }
+};
+}
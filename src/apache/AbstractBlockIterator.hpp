@@ -39,15 +39,54 @@ struct AbstractBlockIterator
 
   Block block;
   SubIterator position;
+  /// How many bytes come before block.begin(), counting from where the
+  /// first iterator of our frame started. Copies share the frame, so two
+  /// iterators of one frame are a subtraction apart.
+  difference_type offset = 0;
+  /// Which family of copies we belong to; 0 for none
+  unsigned long frame = 0;
+
+  /// @returns a new frame number, for a newly made (not copied) iterator
+  static unsigned long newFrame() {
+    thread_local unsigned long last = 0;
+    return ++last;
+  }
 
   AbstractBlockIterator() = default;
   AbstractBlockIterator(const Block &block, SubIterator position)
-      : parent_type{}, block{block}, position{position} {}
+      : parent_type{}, block{block}, position{position}, frame{newFrame()} {}
   AbstractBlockIterator(const Block &block)
-      : parent_type{}, block{block}, position{block.begin()} {}
+      : parent_type{}, block{block}, position{block.begin()},
+        frame{newFrame()} {}
   AbstractBlockIterator(const type &other)
-      : block(other.block), position(other.position) {}
+      : block(other.block), position(other.position), offset(other.offset),
+        frame(other.frame) {}
   type &operator=(const type &other) = default;
+  /// Moves to the start of the next block
+  void nextBlock() {
+    offset += block.end() - block.begin();
+    ++block;
+    position = block.begin();
+  }
+  /// Moves to the end of the previous block
+  void previousBlock() {
+    auto canDecBlock = boost::hana::is_valid([](auto &&b) -> decltype(--b) {});
+    auto decBlock = boost::hana::if_(
+        canDecBlock(block),
+        [this](auto &block) {
+          --block;
+          assert(!block.isSentinel());
+          offset -= block.end() - block.begin();
+          position = block.end();
+        },
+        [](auto &) {
+          throw std::logic_error(
+              "Can't decrement this iterator past the beginning of the block");
+        });
+    decBlock(block);
+  }
+  /// @returns how far we are from the start of our frame
+  difference_type index() const { return offset + (position - block.begin()); }
   reference operator*() const {
     assert(position != SubIterator());
     return *position;
@@ -66,10 +105,8 @@ struct AbstractBlockIterator
   }
   type &operator++() {
     ++position;
-    if (position == block.end()) {
-      ++block;
-      position = block.begin();
-    }
+    if (position == block.end())
+      nextBlock();
     return *this;
   }
   type operator++(int) {
@@ -78,23 +115,8 @@ struct AbstractBlockIterator
     return result;
   }
   type &operator--() {
-    if (position == block.begin()) {
-      auto canDecBlock =
-          boost::hana::is_valid([](auto &&b) -> decltype(--b) {});
-      auto decBlock = boost::hana::if_(canDecBlock(block),
-                                       [this](auto &block) {
-                                         --block;
-                                         assert(!block.isSentinel());
-                                         position = block.end();
-                                       },
-                                       [this](auto &) {
-                                         throw std::logic_error(
-                                             "Can't decrement this iterator "
-                                             "past the beginning of the "
-                                             "block");
-                                       });
-      decBlock(block);
-    }
+    if (position == block.begin())
+      previousBlock();
     --position;
     return *this;
   }
@@ -117,8 +139,7 @@ struct AbstractBlockIterator
           // If our target is some blocks away, go to the next block and keep
           // searching
           count -= eob;
-          ++block;
-          position = block.begin();
+          nextBlock();
         }
       }
       return *this;
@@ -137,8 +158,7 @@ struct AbstractBlockIterator
           break;
         } else {
           count -= db;
-          --block;
-          position = block.end();
+          previousBlock();
         }
       }
     }
@@ -152,22 +172,27 @@ struct AbstractBlockIterator
     type result(*this);
     return result -= count;
   }
-  difference_type operator-(const type &other) {
+  difference_type operator-(const type &other) const {
+    // Copies of one iterator know how far they are from each other
+    if ((frame != 0) && (frame == other.frame) && !block.isSentinel() &&
+        !other.block.isSentinel())
+      return index() - other.index();
     if (block == other.block) {
       return position - other.position;
     } else {
       // Assume that other is less than ours
       auto copy = other;
       long count = 0;
-      while (copy.block != block) {
-        count += copy.block.end() - copy.position;
-        ++copy.block;
-        copy.position = copy.block.begin();
-        if (copy.isSentinel())
+      while (!(copy.block == block)) {
+        if (copy.block.isSentinel())
           throw std::runtime_error(
               "Couldn't find a distance between two iterators");
+        count += copy.block.end() - copy.position;
+        copy.nextBlock();
       }
-      return count + (position - other.position);
+      if (block.isSentinel())
+        return count;
+      return count + (position - copy.position);
     }
   }
 
@@ -0,0 +1,252 @@
+/**
+ * © Copyright 2017 Matthew Sherborne. All Rights Reserved.
+ * License: Apache License, Version 2.0 (See LICENSE.txt)
+ **/
+#include "cache.hpp"
+#include "mod_cdnalizer.hpp"
+#include "utils.hpp"
+#include "../Stats.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+extern "C" {
+#include <ap_provider.h>
+#include <ap_socache.h>
+#include <apr_strings.h>
+#include <http_log.h>
+#include <util_mutex.h>
+
+APLOG_USE_MODULE(cdnalizer_module);
+}
+
+namespace cdnalizer {
+namespace apache {
+namespace cache {
+
+namespace {
+
+const char mutexType[] = "cdnalizer-cache";
+
+// There's one cache for the whole server, like mod_ssl's session cache
+const ap_socache_provider_t *provider = nullptr;
+ap_socache_instance_t *instance = nullptr;
+apr_global_mutex_t *mutex = nullptr;
+apr_interval_time_t timeout = apr_time_from_sec(600);
+
+/// Holds the global mutex if the cache provider needs one
+class Lock {
+public:
+  Lock() {
+    if (mutex)
+      apr_global_mutex_lock(mutex);
+  }
+  ~Lock() {
+    if (mutex)
+      apr_global_mutex_unlock(mutex);
+  }
+};
+
+/// The config pool is going away (restart or shutdown)
+apr_status_t destroy(void *data) {
+  if (instance)
+    provider->destroy(instance, static_cast<server_rec *>(data));
+  provider = nullptr;
+  instance = nullptr;
+  mutex = nullptr;
+  return APR_SUCCESS;
+}
+
+/// @returns true if the response body is a plain file from the default handler
+bool isStaticFile(const request_rec *r) {
+  if (r->finfo.filetype != APR_REG)
+    return false;
+  return (r->handler == nullptr) ||
+         (strcmp(r->handler, "default-handler") == 0) ||
+         (r->content_type && (strcmp(r->handler, r->content_type) == 0));
+}
+}
+
+const char *configure(cmd_parms *cmd, const char *arg) {
+  const char *err = ap_check_cmd_context(cmd, GLOBAL_ONLY);
+  if (err)
+    return err;
+  const char *sep = strchr(arg, ':');
+  const char *name = sep ? apr_pstrndup(cmd->temp_pool, arg, sep - arg) : arg;
+  const char *args = sep ? sep + 1 : nullptr;
+  provider = static_cast<const ap_socache_provider_t *>(ap_lookup_provider(
+      AP_SOCACHE_PROVIDER_GROUP, name, AP_SOCACHE_PROVIDER_VERSION));
+  if (!provider)
+    return apr_psprintf(cmd->pool,
+                        "CDN_CACHE: Unknown socache provider '%s'. Maybe you "
+                        "need to load the appropriate socache module "
+                        "(mod_socache_%s?)",
+                        name, name);
+  err = provider->create(&instance, args, cmd->temp_pool, cmd->pool);
+  if (err)
+    return apr_psprintf(cmd->pool, "CDN_CACHE: %s", err);
+  return nullptr;
+}
+
+const char *setTimeout(cmd_parms *cmd, const char *arg) {
+  const char *err = ap_check_cmd_context(cmd, GLOBAL_ONLY);
+  if (err)
+    return err;
+  char *end;
+  long seconds = std::strtol(arg, &end, 10);
+  if ((*end != '\0') || (seconds < 1))
+    return "CDN_CACHE_TIMEOUT must be a number of seconds";
+  timeout = apr_time_from_sec(seconds);
+  return nullptr;
+}
+
+int preConfig(apr_pool_t *pconf, apr_pool_t *, apr_pool_t *) {
+  return ap_mutex_register(pconf, mutexType, NULL, APR_LOCK_DEFAULT, 0);
+}
+
+int postConfig(apr_pool_t *pconf, apr_pool_t *, apr_pool_t *, server_rec *s) {
+  if (!instance)
+    return OK;
+  if (provider->flags & AP_SOCACHE_FLAG_NOTMPSAFE) {
+    apr_status_t status =
+        ap_global_mutex_create(&mutex, NULL, mutexType, NULL, s, pconf, 0);
+    if (status != APR_SUCCESS)
+      return HTTP_INTERNAL_SERVER_ERROR;
+  }
+  // Keys are short, and most pages have a handful of splices
+  struct ap_socache_hints hints = {64, 16 * sizeof(Splice),
+                                   apr_time_from_sec(60)};
+  apr_status_t status = provider->init(instance, mutexType, &hints, s, pconf);
+  if (status != APR_SUCCESS) {
+    ap_log_error(APLOG_MARK, APLOG_ERR, status, s,
+                 "Failed to initialise the CDN_CACHE");
+    return HTTP_INTERNAL_SERVER_ERROR;
+  }
+  apr_pool_cleanup_register(pconf, s, &destroy, &apr_pool_cleanup_null);
+  return OK;
+}
+
+void childInit(apr_pool_t *pool, server_rec *s) {
+  if (!mutex)
+    return;
+  apr_status_t status = apr_global_mutex_child_init(
+      &mutex, apr_global_mutex_lockfile(mutex), pool);
+  if (status != APR_SUCCESS)
+    ap_log_error(APLOG_MARK, APLOG_ERR, status, s,
+                 "Failed to attach to the CDN_CACHE mutex");
+}
+
+bool enabled() { return instance != nullptr; }
+
+std::string key(request_rec *r, const std::string &server_url,
+                const std::string &location, const Config &config,
+                bool isCSS) {
+  if (r->status != HTTP_OK)
+    return {};
+  std::ostringstream result;
+  // Weak ETags don't promise the same bytes
+  const char *etag = apr_table_get(r->headers_out, "ETag");
+  if (etag && (strncmp(etag, "W/", 2) != 0))
+    result << 'e' << etag;
+  else if (isStaticFile(r))
+    result << 'f' << r->finfo.inode << '-' << r->finfo.mtime << '-'
+           << r->finfo.size;
+  else
+    return {};
+  result << '|' << std::hex << config.fingerprint() << '|' << isCSS << '|'
+         << server_url << '|' << location;
+  return result.str();
+}
+
+bool lookup(request_rec *r, const std::string &key, Splices &splices) {
+  splices.resize(maxSplices);
+  unsigned int size = splices.size() * sizeof(Splice);
+  apr_status_t status;
+  {
+    Lock lock;
+    status = provider->retrieve(
+        instance, r->server,
+        reinterpret_cast<const unsigned char *>(key.data()), key.size(),
+        reinterpret_cast<unsigned char *>(splices.data()), &size, r->pool);
+  }
+  if ((status != APR_SUCCESS) || (size % sizeof(Splice) != 0)) {
+    splices.clear();
+    return false;
+  }
+  splices.resize(size / sizeof(Splice));
+  return true;
+}
+
+void store(request_rec *r, const std::string &key, const Splices &splices) {
+  Lock lock;
+  apr_status_t status = provider->store(
+      instance, r->server, reinterpret_cast<const unsigned char *>(key.data()),
+      key.size(), apr_time_now() + timeout,
+      reinterpret_cast<unsigned char *>(const_cast<Splice *>(splices.data())),
+      splices.size() * sizeof(Splice), r->pool);
+  if (status != APR_SUCCESS)
+    ap_log_rerror(APLOG_MARK, APLOG_DEBUG, status, r,
+                  "Couldn't store %d splices in the CDN_CACHE",
+                  static_cast<int>(splices.size()));
+}
+}
+
+void SpliceReplayer::operator()(apr_bucket_brigade *bb) {
+  apr_bucket *bucket = APR_BRIGADE_FIRST(bb);
+  while (bucket != APR_BRIGADE_SENTINEL(bb)) {
+    if (APR_BUCKET_IS_METADATA(bucket)) {
+      bucket = APR_BUCKET_NEXT(bucket);
+      continue;
+    }
+    // Pipes and sockets don't know their length until they're read
+    if (bucket->length == static_cast<apr_size_t>(-1)) {
+      const char *data;
+      apr_size_t length;
+      checkStatusCode(apr_bucket_read(bucket, &data, &length, APR_BLOCK_READ));
+    }
+    apr_uint64_t length = bucket->length;
+    if (pendingCut != 0) {
+      // Drop the bytes that the cdn url replaces
+      if (length > pendingCut) {
+        checkStatusCode(apr_bucket_split(bucket, pendingCut));
+        stats::add(stats::Counter::bucketSplits);
+        length = pendingCut;
+      }
+      apr_bucket *next = APR_BUCKET_NEXT(bucket);
+      apr_bucket_delete(bucket);
+      bucket = next;
+      offset += length;
+      pendingCut -= length;
+      continue;
+    }
+    if ((next == splices.size()) || (splices[next].offset >= offset + length)) {
+      // Nothing to do in this bucket
+      offset += length;
+      bucket = APR_BUCKET_NEXT(bucket);
+      continue;
+    }
+    const Splice &splice = splices[next++];
+    if ((splice.entry >= config.size()) ||
+        (splice.host >= config.hosts(splice.entry)))
+      throw std::runtime_error("Cached splice refers to a missing CDN_URL");
+    apr_uint64_t before = splice.offset - offset;
+    if (before != 0) {
+      checkStatusCode(apr_bucket_split(bucket, before));
+      stats::add(stats::Counter::bucketSplits);
+      offset += before;
+      bucket = APR_BUCKET_NEXT(bucket);
+    }
+    const std::string &url = config.url(splice.entry, splice.host);
+    APR_BUCKET_INSERT_BEFORE(bucket, apr_bucket_heap_create(url.c_str(),
+                                                            url.size(), NULL,
+                                                            bb->bucket_alloc));
+    stats::add(stats::Counter::heapBuckets);
+    stats::hit(config.entry(splice.entry).first);
+    pendingCut = splice.cut;
+    // Go round again on the same bucket to cut from it
+  }
+}
+}
+}
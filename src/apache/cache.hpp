@@ -0,0 +1,102 @@
+#pragma once
+/**
+ * Remembers where we spliced CDN urls into a response, keyed by its ETag.
+ *
+ * Static pages go out thousands of times with the same ETag. Rather than
+ * store the rewritten body, we store the list of splice points in a
+ * mod_socache cache (usually shmcb, shared by all the children). Later
+ * requests for the same response just split the buckets at those points,
+ * without reading or parsing any of the body.
+ *
+ * © Copyright 2017 Matthew Sherborne. All Rights Reserved.
+ * License: Apache License, Version 2.0 (See LICENSE.txt)
+ **/
+
+#include "../Config.hpp"
+
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <httpd.h>
+#include <http_config.h>
+#include <apr_buckets.h>
+}
+
+namespace cdnalizer {
+namespace apache {
+
+/// One rewrite: at input byte @a offset, cut @a cut bytes and put cdn url
+/// number @a host of config entry number @a entry in their place
+struct Splice {
+  apr_uint64_t offset;
+  apr_uint32_t cut;
+  apr_uint32_t entry;
+  apr_uint32_t host;
+};
+
+using Splices = std::vector<Splice>;
+
+namespace cache {
+
+/// Responses with more rewrites than this are not worth caching
+constexpr size_t maxSplices = 1024;
+
+/// CDN_CACHE provider[:args], eg. 'shmcb:/var/run/cdnalizer(512000)'
+const char *configure(cmd_parms *cmd, const char *arg);
+/// CDN_CACHE_TIMEOUT seconds
+const char *setTimeout(cmd_parms *cmd, const char *arg);
+
+// Apache hooks, registered in mod_cdnalizer.cpp
+int preConfig(apr_pool_t *pconf, apr_pool_t *plog, apr_pool_t *ptemp);
+int postConfig(apr_pool_t *pconf, apr_pool_t *plog, apr_pool_t *ptemp,
+               server_rec *s);
+void childInit(apr_pool_t *pool, server_rec *s);
+
+/// @returns true if a CDN_CACHE has been set up
+bool enabled();
+
+/** Works out the cache key for a response.
+ *
+ * We only cache 200 responses with a strong ETag, or static files (by inode,
+ * mtime and size). The key also covers everything else that changes how the
+ * body gets rewritten.
+ *
+ * @returns the key, or an empty string if this response can't be cached
+ */
+std::string key(request_rec *r, const std::string &server_url,
+                const std::string &location, const Config &config,
+                bool isCSS);
+
+/// @returns true and fills in @a splices if we've seen this response before
+bool lookup(request_rec *r, const std::string &key, Splices &splices);
+
+/// Remembers the splices for a response
+void store(request_rec *r, const std::string &key, const Splices &splices);
+}
+
+/** Splits a brigade at the cached splice points, swapping the cut bytes for
+ * the cdn urls. Keeps its place between brigades.
+ *
+ * Buckets are only read if their length isn't known (pipes and sockets), so
+ * FILE buckets go down the line as FILE buckets.
+ */
+class SpliceReplayer {
+private:
+  const Config &config;
+  Splices splices;
+  /// The next splice to make
+  size_t next = 0;
+  /// Input offset of the start of the next bucket we look at
+  apr_uint64_t offset = 0;
+  /// Bytes we still have to drop from the start of the next brigade
+  apr_uint64_t pendingCut = 0;
+
+public:
+  SpliceReplayer(const Config &config, Splices &&splices)
+      : config(config), splices(std::move(splices)) {}
+  /// Makes all the splices that fall inside @a bb
+  void operator()(apr_bucket_brigade *bb);
+};
+}
+}
@@ -0,0 +1,68 @@
+/**
+ * © Copyright 2017 Matthew Sherborne. All Rights Reserved.
+ * License: Apache License, Version 2.0 (See LICENSE.txt)
+ **/
+#include "coalesce.hpp"
+#include "utils.hpp"
+
+#include <cstring>
+
+namespace cdnalizer {
+namespace apache {
+
+namespace {
+
+bool isSmall(const apr_bucket *bucket, apr_size_t maxSize) {
+  return !APR_BUCKET_IS_METADATA(bucket) &&
+         (bucket->length != static_cast<apr_size_t>(-1)) &&
+         (bucket->length < maxSize);
+}
+}
+
+apr_size_t coalesce(apr_bucket_brigade *bb, apr_size_t maxSize) {
+  apr_size_t removed = 0;
+  apr_bucket *bucket = APR_BRIGADE_FIRST(bb);
+  while (bucket != APR_BRIGADE_SENTINEL(bb)) {
+    if (!isSmall(bucket, maxSize)) {
+      bucket = APR_BUCKET_NEXT(bucket);
+      continue;
+    }
+    // Find the run, and how much data it holds
+    apr_size_t total = bucket->length;
+    apr_size_t count = 1;
+    apr_bucket *after = APR_BUCKET_NEXT(bucket);
+    while ((after != APR_BRIGADE_SENTINEL(bb)) && isSmall(after, maxSize) &&
+           (total + after->length <= maxSize)) {
+      total += after->length;
+      ++count;
+      after = APR_BUCKET_NEXT(after);
+    }
+    if (count == 1) {
+      bucket = after;
+      continue;
+    }
+    // Copy it into one buffer, and swap the run for a bucket that owns it
+    char *buffer = static_cast<char *>(apr_bucket_alloc(total, bb->bucket_alloc));
+    apr_size_t filled = 0;
+    try {
+      while (bucket != after) {
+        const char *data;
+        apr_size_t length;
+        checkStatusCode(apr_bucket_read(bucket, &data, &length, APR_BLOCK_READ));
+        std::memcpy(buffer + filled, data, length);
+        filled += length;
+        apr_bucket *next = APR_BUCKET_NEXT(bucket);
+        apr_bucket_delete(bucket);
+        bucket = next;
+      }
+    } catch (...) {
+      apr_bucket_free(buffer);
+      throw;
+    }
+    APR_BUCKET_INSERT_BEFORE(after, apr_bucket_heap_create(buffer, filled, apr_bucket_free, bb->bucket_alloc));
+    removed += count - 1;
+  }
+  return removed;
+}
+}
+}
@@ -0,0 +1,33 @@
+#pragma once
+/**
+ * Merges the little buckets that splicing leaves behind
+ *
+ * Every rewritten url costs at least three buckets: the data before it, a
+ * heap bucket with the cdn url, and the data after it. A page full of links
+ * ends up as thousands of tiny buckets, which mod_deflate, mod_ssl and
+ * writev() all handle badly. Before we pass our work on, we copy runs of
+ * small buckets into single heap buckets.
+ *
+ * © Copyright 2017 Matthew Sherborne. All Rights Reserved.
+ * License: Apache License, Version 2.0 (See LICENSE.txt)
+ **/
+
+extern "C" {
+#include <apr_buckets.h>
+}
+
+namespace cdnalizer {
+namespace apache {
+
+/** Merges runs of small data buckets in @a bb into heap buckets of up to
+ * @a maxSize bytes.
+ *
+ * Buckets of @a maxSize or more (eg. the FILE and MMAP buckets of a static
+ * file), buckets of unknown length, and metadata buckets are left alone, and
+ * end a run.
+ *
+ * @returns how many fewer buckets @a bb has now
+ */
+apr_size_t coalesce(apr_bucket_brigade *bb, apr_size_t maxSize);
+}
+}
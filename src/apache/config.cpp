@@ -4,42 +4,58 @@
  **/
 #include "config.hpp"
 #include "../Config.hpp"
+#include "cache.hpp"
 #include "mod_cdnalizer.hpp"
 
+#include <cstdlib>
+#include <chrono>
+#include <functional>
+
+#include <strings.h>
+
 APLOG_USE_MODULE(cdnalizer_module);
 
 // Our C style parts for Apache registration
 extern "C" {
+#include <apr_strings.h>
 #include <http_log.h>
 
 using cdnalizer::Config;
+using cdnalizer::Engine;
+using cdnalizer::ManifestError;
+using cdnalizer::ManifestFile;
+using cdnalizer::MappingFile;
+using cdnalizer::MappingFileError;
+using cdnalizer::PathClassifier;
+using cdnalizer::Versioning;
+using cdnalizer::apache::DirConfig;
 
 /// Delete a config object from a pool that's dying
 apr_status_t deleteConfig(void* memory) {
-    Config* cfg = static_cast<Config*>(memory);
-    cfg->~Config();
+    DirConfig* cfg = static_cast<DirConfig*>(memory);
+    cfg->~DirConfig();
     return APR_SUCCESS;
 }
 
 /// Create a config object for a dir
 void* cdnalizer_create_dir_config(apr_pool_t* pool, char* context) {
-    void* memory = apr_palloc(pool, sizeof(Config));
-    Config* cfg;
+    void* memory = apr_palloc(pool, sizeof(DirConfig));
+    DirConfig* cfg;
     if (context)
-        cfg = new (memory) Config({}, context);
+        cfg = new (memory) DirConfig(Config({}, context));
     else
-        cfg = new (memory) Config();
+        cfg = new (memory) DirConfig();
     apr_pool_cleanup_register(pool, memory, &deleteConfig, &deleteConfig);
     return cfg;
 }
 
 /// Add one config to another
 void* cdnalizer_merge_dir_configs(apr_pool_t* pool, void* base, void* add) {
-    Config* cfg1 = static_cast<Config*>(base);
-    Config* cfg2 = static_cast<Config*>(add);
+    DirConfig* cfg1 = static_cast<DirConfig*>(base);
+    DirConfig* cfg2 = static_cast<DirConfig*>(add);
     // Make the result
-    void* memory = apr_palloc(pool, sizeof(Config));
-    Config* result = new (memory) Config(*cfg1);
+    void* memory = apr_palloc(pool, sizeof(DirConfig));
+    DirConfig* result = new (memory) DirConfig(*cfg1);
     apr_pool_cleanup_register(pool, memory, &deleteConfig, &deleteConfig);
     *result += *cfg2;
     return result;
@@ -48,8 +64,205 @@ void* cdnalizer_merge_dir_configs(apr_pool_t* pool, void* base, void* add) {
 /// Reads a line from the Apache config
 const char *addCDNPath(cmd_parms *cmd, void *memory, const char *arg1, const char* arg2) {
     ap_log_error(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, cmd->server, "Reading CDN->url pair: %s->%s", arg1, arg2);
-    Config* cfg = static_cast<Config*>(memory);
-    cfg->addPath(arg1, arg2);
+    DirConfig* cfg = static_cast<DirConfig*>(memory);
+    // CDN_URL /images http://a.cdn http://b.cdn comes one url at a time
+    cfg->cdn.addHost(arg1, arg2);
+    return NULL;
+}
+
+/// CDN_INFLATE On|Off
+const char *setInflate(cmd_parms *, void *memory, int on) {
+    DirConfig* cfg = static_cast<DirConfig*>(memory);
+    cfg->inflate = on ? 1 : 0;
+    return NULL;
+}
+
+/// CDN_DEFLATE_LEVEL 1-9
+const char *setDeflateLevel(cmd_parms *, void *memory, const char *arg) {
+    DirConfig* cfg = static_cast<DirConfig*>(memory);
+    char* end;
+    long level = std::strtol(arg, &end, 10);
+    if ((*end != '\0') || (level < 1) || (level > 9))
+        return "CDN_DEFLATE_LEVEL must be a number from 1 to 9";
+    cfg->deflateLevel = static_cast<int>(level);
+    return NULL;
+}
+
+/// CDN_CACHE provider:args
+const char *setCache(cmd_parms *cmd, void *, const char *arg) {
+    return cdnalizer::apache::cache::configure(cmd, arg);
+}
+
+/// CDN_CACHE_TIMEOUT seconds
+const char *setCacheTimeout(cmd_parms *cmd, void *, const char *arg) {
+    return cdnalizer::apache::cache::setTimeout(cmd, arg);
+}
+
+/// CDN_CACHE_RESPONSES On|Off
+const char *setCacheResponses(cmd_parms *, void *memory, int on) {
+    DirConfig* cfg = static_cast<DirConfig*>(memory);
+    cfg->cacheResponses = on ? 1 : 0;
+    return NULL;
+}
+
+/// CDN_URL_FILE filename [seconds]
+const char *setMappingFile(cmd_parms *cmd, void *memory, const char *filename, const char *arg) {
+    DirConfig* cfg = static_cast<DirConfig*>(memory);
+    long seconds = 5;
+    if (arg) {
+        char* end;
+        seconds = std::strtol(arg, &end, 10);
+        if ((*end != '\0') || (seconds < 0))
+            return "CDN_URL_FILE's check interval must be a number of seconds";
+    }
+    const char* path = ap_server_root_relative(cmd->temp_pool, filename);
+    if (!path)
+        return apr_pstrcat(cmd->pool, "CDN_URL_FILE: Invalid file name ", filename, NULL);
+    try {
+        cfg->mappingFile = std::make_shared<MappingFile>(
+            path, cmd->path ? cmd->path : "/", std::chrono::seconds(seconds));
+    } catch (const MappingFileError& e) {
+        return apr_pstrdup(cmd->pool, e.what());
+    }
+    ap_log_error(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, cmd->server,
+                 "Loaded %d CDN->url pairs from %s",
+                 static_cast<int>(cfg->mappingFile->get()->size()), path);
+    return NULL;
+}
+
+/// CDN_MANIFEST filename [seconds]
+const char *setManifestFile(cmd_parms *cmd, void *memory, const char *filename, const char *arg) {
+    DirConfig* cfg = static_cast<DirConfig*>(memory);
+    long seconds = 5;
+    if (arg) {
+        char* end;
+        seconds = std::strtol(arg, &end, 10);
+        if ((*end != '\0') || (seconds < 0))
+            return "CDN_MANIFEST's check interval must be a number of seconds";
+    }
+    const char* path = ap_server_root_relative(cmd->temp_pool, filename);
+    if (!path)
+        return apr_pstrcat(cmd->pool, "CDN_MANIFEST: Invalid file name ", filename, NULL);
+    try {
+        cfg->manifestFile = std::make_shared<ManifestFile>(
+            path, cmd->path ? cmd->path : "/", std::chrono::seconds(seconds));
+    } catch (const ManifestError& e) {
+        return apr_pstrdup(cmd->pool, e.what());
+    }
+    ap_log_error(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, cmd->server,
+                 "Loaded %d uploaded paths from %s",
+                 static_cast<int>(cfg->manifestFile->get()->size()), path);
+    return NULL;
+}
+
+/// CDN_VERSION off|query|name
+const char *setVersioning(cmd_parms *, void *memory, const char *arg) {
+    DirConfig* cfg = static_cast<DirConfig*>(memory);
+    if (strcasecmp(arg, "off") == 0)
+        cfg->versioning = static_cast<int>(Versioning::off);
+    else if (strcasecmp(arg, "query") == 0)
+        cfg->versioning = static_cast<int>(Versioning::query);
+    else if (strcasecmp(arg, "name") == 0)
+        cfg->versioning = static_cast<int>(Versioning::name);
+    else
+        return "CDN_VERSION must be 'off', 'query' or 'name'";
+    return NULL;
+}
+
+/// Applies a change to the static/dynamic path rules of a directory
+static const char* changePaths(void* memory, const std::function<void(PathClassifier&)>& change) {
+    DirConfig* cfg = static_cast<DirConfig*>(memory);
+    PathClassifier classifier = cfg->cdn.classifier();
+    change(classifier);
+    cfg->cdn.setClassifier(classifier);
+    return NULL;
+}
+
+/// CDN_DYNAMIC_EXT ext [ext] ...
+const char *addDynamicExtension(cmd_parms *, void *memory, const char *extension) {
+    return changePaths(memory, [&](PathClassifier& paths) { paths.setExtension(extension, false); });
+}
+
+/// CDN_STATIC_EXT ext [ext] ...
+const char *addStaticExtension(cmd_parms *, void *memory, const char *extension) {
+    return changePaths(memory, [&](PathClassifier& paths) { paths.setExtension(extension, true); });
+}
+
+/// CDN_EXTENSIONLESS static|dynamic
+const char *setExtensionless(cmd_parms *, void *memory, const char *arg) {
+    bool isStatic = strcasecmp(arg, "static") == 0;
+    if (!isStatic && (strcasecmp(arg, "dynamic") != 0))
+        return "CDN_EXTENSIONLESS must be 'static' or 'dynamic'";
+    return changePaths(memory, [&](PathClassifier& paths) { paths.setExtensionless(isStatic); });
+}
+
+/// CDN_QUERY ignore|dynamic
+const char *setQueryPolicy(cmd_parms *, void *memory, const char *arg) {
+    bool dynamic = strcasecmp(arg, "dynamic") == 0;
+    if (!dynamic && (strcasecmp(arg, "ignore") != 0))
+        return "CDN_QUERY must be 'ignore' or 'dynamic'";
+    return changePaths(memory, [&](PathClassifier& paths) { paths.setQueryDynamic(dynamic); });
+}
+
+/// CDN_STATIC_PARAM name [name] ...
+const char *addStaticParam(cmd_parms *, void *memory, const char *name) {
+    return changePaths(memory, [&](PathClassifier& paths) { paths.addStaticParam(name); });
+}
+
+/// Reads a whole number from @a arg into @a result
+/// @returns false if it's not one, or it's more than @a most
+static bool readNumber(const char* arg, long most, long& result) {
+    char* end;
+    result = std::strtol(arg, &end, 10);
+    return (*arg != '\0') && (*end == '\0') && (result >= 0) && (result <= most);
+}
+
+/// CDN_COALESCE_SIZE bytes
+const char *setCoalesceSize(cmd_parms *, void *memory, const char *arg) {
+    DirConfig* cfg = static_cast<DirConfig*>(memory);
+    if (!readNumber(arg, 1024 * 1024, cfg->coalesceSize))
+        return "CDN_COALESCE_SIZE must be a number of bytes from 0 to 1048576";
+    return NULL;
+}
+
+/// The smallest CDN_FLUSH_BYTES slice we'll cut
+static const long minFlushBytes = 1024;
+
+/// CDN_FLUSH_BYTES bytes
+const char *setFlushBytes(cmd_parms *, void *memory, const char *arg) {
+    DirConfig* cfg = static_cast<DirConfig*>(memory);
+    // Each slice is rescanned from any tag carried into it, so tiny slices
+    // only make work
+    if (!readNumber(arg, 1L << 30, cfg->flushBytes) ||
+        ((cfg->flushBytes != 0) && (cfg->flushBytes < minFlushBytes)))
+        return "CDN_FLUSH_BYTES must be a number of bytes, at least 1024 (0 for off)";
+    return NULL;
+}
+
+/// CDN_FLUSH_USEC microseconds
+const char *setFlushUsec(cmd_parms *, void *memory, const char *arg) {
+    DirConfig* cfg = static_cast<DirConfig*>(memory);
+    if (!readNumber(arg, 60L * 1000 * 1000, cfg->flushUsec))
+        return "CDN_FLUSH_USEC must be a number of microseconds, up to a minute (0 for off)";
+    return NULL;
+}
+
+/// CDN_ENGINE parser|search
+const char *setEngine(cmd_parms *, void *memory, const char *arg) {
+    DirConfig* cfg = static_cast<DirConfig*>(memory);
+    if (strcasecmp(arg, "parser") == 0)
+        cfg->engine = static_cast<int>(Engine::parser);
+    else if (strcasecmp(arg, "search") == 0)
+        cfg->engine = static_cast<int>(Engine::search);
+    else
+        return "CDN_ENGINE must be 'parser' or 'search'";
+    return NULL;
+}
+
+/// CDN_PRECONNECT On|Off
+const char *setPreconnect(cmd_parms *, void *memory, int on) {
+    DirConfig* cfg = static_cast<DirConfig*>(memory);
+    cfg->preconnect = on ? 1 : 0;
     return NULL;
 }
 
@@ -9,6 +9,116 @@
  *
  **/
 
+#include "../Config.hpp"
+#include "../ManifestFile.hpp"
+#include "../MappingFile.hpp"
+#include "../Search.hpp"
+#include "coalesce.hpp"
+
+#include <memory>
+
+namespace cdnalizer {
+namespace apache {
+
+/// Per directory configuration: the generic CDN mappings, plus the switches
+/// that only make sense for the Apache filter
+struct DirConfig {
+  /// Our CDN_URL mappings
+  Config cdn;
+  /// CDN_INFLATE: -1 means not set here (inherit), otherwise 0 or 1
+  int inflate = -1;
+  /// CDN_DEFLATE_LEVEL: 0 means not set here; use zlib's default
+  int deflateLevel = 0;
+  /// CDN_CACHE_RESPONSES: -1 means not set here (inherit), otherwise 0 or 1
+  int cacheResponses = -1;
+  /// CDN_COALESCE_SIZE: -1 means not set here (inherit), 0 means off
+  long coalesceSize = -1;
+  /// CDN_FLUSH_BYTES: -1 means not set here (inherit), 0 means off
+  long flushBytes = -1;
+  /// CDN_FLUSH_USEC: -1 means not set here (inherit), 0 means off
+  long flushUsec = -1;
+  /// CDN_ENGINE: -1 means not set here (inherit), otherwise an Engine
+  int engine = -1;
+  /// CDN_URL_FILE: when set, its mappings are used instead of cdn's, with
+  /// cdn's path rules
+  std::shared_ptr<MappingFile> mappingFile;
+  /// CDN_MANIFEST: when set, only the paths in it are sent to the CDN
+  std::shared_ptr<ManifestFile> manifestFile;
+  /// CDN_VERSION: -1 means not set here (inherit), otherwise a Versioning
+  int versioning = -1;
+  /// CDN_PRECONNECT: -1 means not set here (inherit), otherwise 0 or 1
+  int preconnect = -1;
+
+  DirConfig() = default;
+  DirConfig(Config &&cdn) : cdn(std::move(cdn)) {}
+  DirConfig(const DirConfig &) = default;
+
+  /// Should we unpack gzip/deflate encoded responses so we can rewrite them
+  bool inflateEnabled() const { return inflate == 1; }
+  /// Should we use the CDN_CACHE for responses in this directory
+  bool cacheEnabled() const { return cacheResponses == 1; }
+  /// Should we send Link: rel=preconnect headers for our CDN hosts
+  bool preconnectEnabled() const { return preconnect == 1; }
+  /// The most bytes to merge small output buckets into; 0 (the default)
+  /// for don't
+  apr_size_t coalesceLimit() const {
+    return (coalesceSize > 0) ? static_cast<apr_size_t>(coalesceSize) : 0;
+  }
+  /// Which engine rewrites responses in this directory; the parser unless
+  /// CDN_ENGINE says otherwise
+  Engine rewriteEngine() const {
+    return (engine == -1) ? Engine::parser : static_cast<Engine>(engine);
+  }
+  /// Where the CDN_MANIFEST versions go in cdn urls; nowhere unless
+  /// CDN_VERSION says otherwise
+  Versioning rewriteVersioning() const {
+    return (versioning == -1) || !manifestFile
+               ? Versioning::off
+               : static_cast<Versioning>(versioning);
+  }
+  /// @returns the mappings to use for one request. Hold on to it until the
+  /// request is done, so a reload can't change them half way through.
+  MappingFile::Snapshot mappings() const {
+    MappingFile::Snapshot result =
+        mappingFile ? mappingFile->apply(cdn.classifier())
+                    // Not shared; we outlive the request
+                    : MappingFile::Snapshot(MappingFile::Snapshot(), &cdn);
+    if (manifestFile)
+      return manifestFile->apply(result, rewriteVersioning());
+    return result;
+  }
+
+  /// Include the values from another config object; its settings win
+  DirConfig &operator+=(const DirConfig &other) {
+    cdn += other.cdn;
+    if (other.inflate != -1)
+      inflate = other.inflate;
+    if (other.deflateLevel != 0)
+      deflateLevel = other.deflateLevel;
+    if (other.cacheResponses != -1)
+      cacheResponses = other.cacheResponses;
+    if (other.coalesceSize != -1)
+      coalesceSize = other.coalesceSize;
+    if (other.flushBytes != -1)
+      flushBytes = other.flushBytes;
+    if (other.flushUsec != -1)
+      flushUsec = other.flushUsec;
+    if (other.engine != -1)
+      engine = other.engine;
+    if (other.mappingFile)
+      mappingFile = other.mappingFile;
+    if (other.manifestFile)
+      manifestFile = other.manifestFile;
+    if (other.versioning != -1)
+      versioning = other.versioning;
+    if (other.preconnect != -1)
+      preconnect = other.preconnect;
+    return *this;
+  }
+};
+}
+}
+
 // Our C style parts for Apache registration
 extern "C" {
 
@@ -24,11 +134,144 @@ void* cdnalizer_merge_dir_configs(apr_pool_t* pool, void* base, void* add);
 // Reads a line from the Apache config
 const char *addCDNPath(cmd_parms *cmd, void *cfg, const char *arg1, const char* arg2);
 
+// CDN_INFLATE On|Off
+const char *setInflate(cmd_parms *cmd, void *cfg, int on);
+
+// CDN_DEFLATE_LEVEL 1-9
+const char *setDeflateLevel(cmd_parms *cmd, void *cfg, const char *level);
+
+// CDN_CACHE provider:args
+const char *setCache(cmd_parms *cmd, void *cfg, const char *arg);
+
+// CDN_CACHE_TIMEOUT seconds
+const char *setCacheTimeout(cmd_parms *cmd, void *cfg, const char *arg);
+
+// CDN_CACHE_RESPONSES On|Off
+const char *setCacheResponses(cmd_parms *cmd, void *cfg, int on);
+
+// CDN_URL_FILE filename [seconds]
+const char *setMappingFile(cmd_parms *cmd, void *cfg, const char *filename, const char *seconds);
+
+// CDN_MANIFEST filename [seconds]
+const char *setManifestFile(cmd_parms *cmd, void *cfg, const char *filename, const char *seconds);
+
+// CDN_VERSION off|query|name
+const char *setVersioning(cmd_parms *cmd, void *cfg, const char *arg);
+
+// CDN_DYNAMIC_EXT ext [ext] ...
+const char *addDynamicExtension(cmd_parms *cmd, void *cfg, const char *extension);
+
+// CDN_STATIC_EXT ext [ext] ...
+const char *addStaticExtension(cmd_parms *cmd, void *cfg, const char *extension);
+
+// CDN_EXTENSIONLESS static|dynamic
+const char *setExtensionless(cmd_parms *cmd, void *cfg, const char *arg);
+
+// CDN_QUERY ignore|dynamic
+const char *setQueryPolicy(cmd_parms *cmd, void *cfg, const char *arg);
+
+// CDN_STATIC_PARAM name [name] ...
+const char *addStaticParam(cmd_parms *cmd, void *cfg, const char *name);
+
+// CDN_COALESCE_SIZE bytes
+const char *setCoalesceSize(cmd_parms *cmd, void *cfg, const char *size);
+
+// CDN_FLUSH_BYTES bytes
+const char *setFlushBytes(cmd_parms *cmd, void *cfg, const char *bytes);
+
+// CDN_FLUSH_USEC microseconds
+const char *setFlushUsec(cmd_parms *cmd, void *cfg, const char *usec);
+
+// CDN_ENGINE parser|search
+const char *setEngine(cmd_parms *cmd, void *cfg, const char *arg);
+
+// CDN_PRECONNECT On|Off
+const char *setPreconnect(cmd_parms *cmd, void *cfg, int on);
+
 // List of Directives
 static const command_rec cdnalizer_config_directives[] = {
     AP_INIT_ITERATE2(
         "CDN_URL", addCDNPath, NULL, OR_OPTIONS,
-        "A map of 'path found' to 'cdn url', eg /images http://cdn.supa.ws/imgs"),
+        "A map of 'path found' to 'cdn url', eg /images http://cdn.supa.ws/imgs. "
+        "Give more cdn urls to spread the files over them"),
+    AP_INIT_FLAG(
+        "CDN_INFLATE", setInflate, NULL, OR_OPTIONS,
+        "On to unpack gzip/deflate encoded responses (eg. from mod_proxy), "
+        "rewrite them, then compress them again. Off (the default) passes "
+        "them through untouched"),
+    AP_INIT_TAKE1(
+        "CDN_DEFLATE_LEVEL", setDeflateLevel, NULL, OR_OPTIONS,
+        "zlib compression level (1-9) used when re-compressing inflated "
+        "responses"),
+    AP_INIT_TAKE1(
+        "CDN_CACHE", setCache, NULL, RSRC_CONF,
+        "socache provider and arguments for the splice point cache, eg. "
+        "shmcb:/var/run/cdnalizer(512000)"),
+    AP_INIT_TAKE1(
+        "CDN_CACHE_TIMEOUT", setCacheTimeout, NULL, RSRC_CONF,
+        "How many seconds to remember the splice points of a response "
+        "(default 600)"),
+    AP_INIT_FLAG(
+        "CDN_CACHE_RESPONSES", setCacheResponses, NULL, OR_OPTIONS,
+        "On to remember where responses with strong ETags (or static files) "
+        "were rewritten, and replay that without parsing next time"),
+    AP_INIT_TAKE12(
+        "CDN_URL_FILE", setMappingFile, NULL, OR_OPTIONS,
+        "A file of 'path cdn_url' lines to use instead of the CDN_URL lines. "
+        "It's checked for changes every few seconds (the optional second "
+        "argument, default 5) and reloaded without a restart"),
+    AP_INIT_TAKE12(
+        "CDN_MANIFEST", setManifestFile, NULL, OR_OPTIONS,
+        "A file listing the paths that have been uploaded to the CDN, one per "
+        "line. Other paths stay on this server. It's checked for changes "
+        "every few seconds (the optional second argument, default 5)"),
+    AP_INIT_TAKE1(
+        "CDN_VERSION", setVersioning, NULL, OR_OPTIONS,
+        "Where to put the version (content hash) from the CDN_MANIFEST in cdn "
+        "urls: 'off' (the default), 'query' (logo.png?v=3f9a1c) or 'name' "
+        "(logo.3f9a1c.png)"),
+    AP_INIT_ITERATE(
+        "CDN_DYNAMIC_EXT", addDynamicExtension, NULL, OR_OPTIONS,
+        "File extensions that are never sent to the CDN, eg. aspx cgi "
+        "(php, pl and py are dynamic by default)"),
+    AP_INIT_ITERATE(
+        "CDN_STATIC_EXT", addStaticExtension, NULL, OR_OPTIONS,
+        "File extensions that can go to the CDN even though they'd be "
+        "dynamic by default, eg. php"),
+    AP_INIT_TAKE1(
+        "CDN_EXTENSIONLESS", setExtensionless, NULL, OR_OPTIONS,
+        "'static' (the default) or 'dynamic': whether paths with no file "
+        "extension, like /blog/my-post, can go to the CDN"),
+    AP_INIT_TAKE1(
+        "CDN_QUERY", setQueryPolicy, NULL, OR_OPTIONS,
+        "'ignore' (the default) or 'dynamic': whether a query string stops a "
+        "url going to the CDN (except CDN_STATIC_PARAMs)"),
+    AP_INIT_ITERATE(
+        "CDN_STATIC_PARAM", addStaticParam, NULL, OR_OPTIONS,
+        "Query parameters that don't make a url dynamic under 'CDN_QUERY "
+        "dynamic', eg. ver v"),
+    AP_INIT_TAKE1(
+        "CDN_COALESCE_SIZE", setCoalesceSize, NULL, OR_OPTIONS,
+        "Merge the small buckets left around rewritten urls into buffers of "
+        "up to this many bytes before passing them on, eg. 8192 (default 0, "
+        "off)"),
+    AP_INIT_TAKE1(
+        "CDN_FLUSH_BYTES", setFlushBytes, NULL, OR_OPTIONS,
+        "Send rewritten output on to the client every this many bytes, "
+        "rather than at the end of each brigade (default 0, off)"),
+    AP_INIT_TAKE1(
+        "CDN_FLUSH_USEC", setFlushUsec, NULL, OR_OPTIONS,
+        "Send rewritten output on to the client once we've held it this many "
+        "microseconds (default 0, off)"),
+    AP_INIT_TAKE1(
+        "CDN_ENGINE", setEngine, NULL, OR_OPTIONS,
+        "'parser' (the default) parses HTML tags and CSS; 'search' just looks "
+        "for CDN_URL paths after quotes and url(, which is faster, but also "
+        "rewrites them in scripts and text"),
+    AP_INIT_FLAG(
+        "CDN_PRECONNECT", setPreconnect, NULL, OR_OPTIONS,
+        "On to send a 'Link: <cdn origin>; rel=preconnect' header for each "
+        "CDN host the response uses, so browsers connect to them early"),
     // TODO: DEL_CDN_URL
     /*
     AP_INIT_ITERATE(
@@ -40,4 +283,3 @@ static const command_rec cdnalizer_config_directives[] = {
 
 
 }
-
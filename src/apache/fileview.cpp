@@ -0,0 +1,76 @@
+/**
+ * © Copyright 2017 Matthew Sherborne. All Rights Reserved.
+ * License: Apache License, Version 2.0 (See LICENSE.txt)
+ **/
+#include "fileview.hpp"
+
+#include <map>
+
+extern "C" {
+#include <apr_file_info.h>
+#include <apr_mmap.h>
+#include <apr_pools.h>
+}
+
+namespace cdnalizer {
+namespace apache {
+
+#if APR_HAS_MMAP
+
+namespace {
+
+/// The files we've mapped in a pool; nullptr for ones we couldn't map
+using Views = std::map<apr_file_t *, apr_mmap_t *>;
+const char *viewsKey = "cdnalizer_file_views";
+
+apr_status_t deleteViews(void *memory) {
+  delete static_cast<Views *>(memory);
+  return APR_SUCCESS;
+}
+
+/// @returns the mapping of @a file, making it if this is the first time
+apr_mmap_t *mapping(apr_file_t *file, apr_pool_t *pool) {
+  void *memory = nullptr;
+  apr_pool_userdata_get(&memory, viewsKey, pool);
+  if (memory == nullptr) {
+    memory = new Views;
+    apr_pool_userdata_set(memory, viewsKey, deleteViews, pool);
+  }
+  Views &views = *static_cast<Views *>(memory);
+  auto found = views.find(file);
+  if (found != views.end())
+    return found->second;
+  // Map the whole file; a response is often several buckets of one file
+  apr_mmap_t *result = nullptr;
+  apr_finfo_t info;
+  if ((apr_file_info_get(&info, APR_FINFO_SIZE, file) != APR_SUCCESS) ||
+      (info.size <= 0) ||
+      (apr_mmap_create(&result, file, 0, static_cast<apr_size_t>(info.size),
+                       APR_MMAP_READ, pool) != APR_SUCCESS))
+    result = nullptr;
+  views[file] = result;
+  return result;
+}
+}
+
+const char *fileView(apr_bucket *bucket) {
+  if (!APR_BUCKET_IS_FILE(bucket) || (bucket->length < minFileView))
+    return nullptr;
+  apr_bucket_file *file = static_cast<apr_bucket_file *>(bucket->data);
+  if (!file->can_mmap)
+    return nullptr;
+  apr_mmap_t *view = mapping(file->fd, file->readpool);
+  // The file may have shrunk since the bucket was made
+  if ((view == nullptr) || (bucket->start < 0) ||
+      (static_cast<apr_size_t>(bucket->start) + bucket->length > view->size))
+    return nullptr;
+  return static_cast<const char *>(view->mm) + bucket->start;
+}
+
+#else
+
+const char *fileView(apr_bucket *) { return nullptr; }
+
+#endif
+}
+}
@@ -0,0 +1,31 @@
+#pragma once
+/**
+ * Read only views of the files behind FILE buckets
+ *
+ * apr_bucket_read() turns a FILE bucket into heap buckets, 8 KiB at a time,
+ * and after that the core output filter can't sendfile() it. So instead we
+ * mmap the file (once per request) and read the bucket's bytes straight out
+ * of the mapping. The bucket stays a FILE bucket; splitting it just changes
+ * its offsets, so the parts we don't rewrite still go out with sendfile.
+ *
+ * © Copyright 2017 Matthew Sherborne. All Rights Reserved.
+ * License: Apache License, Version 2.0 (See LICENSE.txt)
+ **/
+
+extern "C" {
+#include <apr_buckets.h>
+}
+
+namespace cdnalizer {
+namespace apache {
+
+/// Smaller FILE buckets are just read; mapping them costs more than copying.
+/// Same as the core's MMAP threshold.
+constexpr apr_size_t minFileView = 8000;
+
+/// @returns a pointer to @a bucket's data in a read only mapping of its
+/// file, or nullptr if it's not a FILE bucket, or it can't (or shouldn't,
+/// eg. EnableMMAP Off) be mapped. The mapping lasts as long as the file.
+const char *fileView(apr_bucket *bucket);
+}
+}
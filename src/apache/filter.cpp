@@ -6,17 +6,31 @@
 
 #include "../Rewriter.hpp"
 #include "../Config.hpp"
+#include "../Probes.hpp"
 #include "../Rewriter_impl.hpp"
+#include "../Search.hpp"
+#include "../Stats.hpp"
+#include "cache.hpp"
+#include "coalesce.hpp"
+#include "config.hpp"
+#include "gzip.hpp"
 #include "iterator.hpp"
 #include "mod_cdnalizer.hpp"
 
+#include <algorithm>
+#include <memory>
 #include <sstream>
+#include <utility>
+#include <vector>
 
 extern "C" {
 
 #include <apr_buckets.h>
+#include <apr_strings.h>
+#include <apr_tables.h>
 #include <http_core.h>
 #include <http_log.h>
+#include <strings.h>
 
 APLOG_USE_MODULE(cdnalizer_module);
 
@@ -25,9 +39,175 @@ APLOG_USE_MODULE(cdnalizer_module);
 namespace cdnalizer {
 namespace apache {
 
-apr_status_t filter(ap_filter_t *filter, apr_bucket_brigade *bb) {
-    // Just pass on empty brigades
-    if (APR_BRIGADE_EMPTY(bb)) { return APR_SUCCESS; }
+/// State we keep between calls to the filter, for the life of the request
+struct FilterContext {
+    /// The mappings we use for the whole request, even if CDN_URL_FILE is
+    /// reloaded half way through
+    MappingFile::Snapshot mappings;
+    /// The start of a tag that was cut off at the end of the last brigade
+    apr_bucket_brigade* leftover_work = nullptr;
+    /// Set when the response is compressed and CDN_INFLATE is on
+    std::unique_ptr<GzipStage> gzip;
+    /// Inflated input, or compressed output, waiting for the next step
+    apr_bucket_brigade* inflated = nullptr;
+    apr_bucket_brigade* deflated = nullptr;
+    /// False until we've seen the first brigade
+    bool started = false;
+    /// False until we've passed something on (and with it, the headers)
+    bool passed = false;
+    /// Input bytes we've finished with so far (passed on or cut out)
+    apr_uint64_t consumed = 0;
+    /// Our key in the splice cache, if this response can be cached
+    std::string cacheKey;
+    /// True while we're recording our splices for the cache
+    bool recording = false;
+    Splices splices;
+    /// Set when the cache already knows where to splice this response
+    std::unique_ptr<SpliceReplayer> replay;
+    /// For CDN_PRECONNECT: the (entry, host) of each cdn url we've put in
+    /// before passing anything on
+    std::vector<std::pair<size_t, size_t>> used;
+    /// Set if one was a wildcard key's, which isn't an entry
+    bool usedPattern = false;
+};
+
+/// Destroys a FilterContext when the request pool dies
+apr_status_t deleteContext(void* memory) {
+    static_cast<FilterContext*>(memory)->~FilterContext();
+    return APR_SUCCESS;
+}
+
+/** Creates our context on the first call for a request.
+ * @returns nullptr if we can't read this response; it should be passed on untouched
+ */
+FilterContext* getContext(ap_filter_t *filter, const DirConfig& config) {
+    if (filter->ctx)
+        return static_cast<FilterContext*>(filter->ctx);
+    request_rec* r = filter->r;
+    const char* encoding = apr_table_get(r->headers_out, "Content-Encoding");
+    gzip::Format format;
+    bool compressed = encoding && (strcasecmp(encoding, "identity") != 0);
+    if (compressed && !(config.inflateEnabled() && gzipFormat(encoding, format))) {
+        ap_log_rerror(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, r,
+                      "Not rewriting %s encoded response", encoding);
+        return nullptr;
+    }
+    void* memory = apr_palloc(r->pool, sizeof(FilterContext));
+    FilterContext* ctx = new (memory) FilterContext();
+    apr_pool_cleanup_register(r->pool, memory, &deleteContext, &apr_pool_cleanup_null);
+    if (compressed) {
+        ctx->gzip.reset(new GzipStage(format, config.deflateLevel));
+        ctx->inflated = apr_brigade_create(r->pool, filter->c->bucket_alloc);
+        ctx->deflated = apr_brigade_create(r->pool, filter->c->bucket_alloc);
+    }
+    if (config.mappingFile) {
+        // Our chance to pick up a changed mapping file
+        std::string error;
+        switch (config.mappingFile->refresh(error)) {
+        case MappingFile::Reload::reloaded:
+            ap_log_rerror(APLOG_MARK, APLOG_INFO, APR_SUCCESS, r, "Reloaded CDN_URL_FILE %s",
+                          config.mappingFile->name().c_str());
+            break;
+        case MappingFile::Reload::failed:
+            ap_log_rerror(APLOG_MARK, APLOG_ERR, APR_SUCCESS, r,
+                          "Keeping the old CDN mappings: %s", error.c_str());
+            break;
+        case MappingFile::Reload::none:
+            break;
+        }
+    }
+    if (config.manifestFile) {
+        std::string error;
+        switch (config.manifestFile->refresh(error)) {
+        case ManifestFile::Reload::reloaded:
+            ap_log_rerror(APLOG_MARK, APLOG_INFO, APR_SUCCESS, r, "Reloaded CDN_MANIFEST %s",
+                          config.manifestFile->name().c_str());
+            break;
+        case ManifestFile::Reload::failed:
+            ap_log_rerror(APLOG_MARK, APLOG_ERR, APR_SUCCESS, r,
+                          "Keeping the old CDN manifest: %s", error.c_str());
+            break;
+        case ManifestFile::Reload::none:
+            break;
+        }
+    }
+    ctx->mappings = config.mappings();
+    filter->ctx = ctx;
+    return ctx;
+}
+
+/** We change the size of the body, so the Content-Length has to change.
+ * Called with the first brigade we pass on. If it's the whole body, we know
+ * its exact length; otherwise we're streaming, and there can't be one.
+ */
+void setContentLength(request_rec* r, apr_bucket_brigade* output) {
+    apr_off_t length = -1;
+    // A HEAD request may not have had a body made at all
+    if (!r->header_only && !APR_BRIGADE_EMPTY(output) && APR_BUCKET_IS_EOS(APR_BRIGADE_LAST(output)) &&
+        (apr_brigade_length(output, 0, &length) == APR_SUCCESS) && (length >= 0))
+        ap_set_content_length(r, length);
+    else
+        apr_table_unset(r->headers_out, "Content-Length");
+}
+
+/** CDN_PRECONNECT: tells the browser which CDN hosts the page needs, so it
+ * can connect to them while it's still downloading the page. Called with the
+ * first brigade we pass on, like setContentLength.
+ *
+ * @param used the (entry, host) pairs of the cdn urls in the whole body, or
+ *        nullptr if we haven't seen all of it; then we list every origin
+ *        @a config could send
+ */
+void addPreconnect(request_rec* r, const Config& config,
+                   const std::vector<std::pair<size_t, size_t>>* used) {
+    std::vector<std::string> seen;
+    if (used) {
+        for (const auto& entry : *used) {
+            std::string origin = Config::originOf(config.url(entry.first, entry.second));
+            if (!origin.empty() && (std::find(seen.begin(), seen.end(), origin) == seen.end()))
+                seen.push_back(std::move(origin));
+        }
+    }
+    for (const std::string& origin : used ? seen : config.origins())
+        apr_table_addn(r->headers_out, "Link",
+                       apr_pstrcat(r->pool, "<", origin.c_str(), ">; rel=preconnect", NULL));
+}
+
+/// How much we rewrite at a time when there's only a CDN_FLUSH_USEC
+constexpr apr_size_t defaultSliceSize = 16384;
+
+/** Finds where to cut @a bb so the first part has about @a bytes of data
+ * @returns the first bucket of the second part; maybe the sentinel
+ */
+apr_bucket* sliceEnd(apr_bucket_brigade* bb, apr_size_t bytes) {
+    apr_size_t total = 0;
+    for (apr_bucket* bucket = APR_BRIGADE_FIRST(bb); bucket != APR_BRIGADE_SENTINEL(bb);
+         bucket = APR_BUCKET_NEXT(bucket)) {
+        if (APR_BUCKET_IS_METADATA(bucket))
+            continue;
+        // Pipes and sockets don't know their length until they're read; the
+        // slice can end after one
+        if (bucket->length == static_cast<apr_size_t>(-1))
+            return APR_BUCKET_NEXT(bucket);
+        if (total + bucket->length > bytes) {
+            if (total != bytes) {
+                checkStatusCode(apr_bucket_split(bucket, bytes - total));
+                return APR_BUCKET_NEXT(bucket);
+            }
+            return bucket;
+        }
+        total += bucket->length;
+    }
+    return APR_BRIGADE_SENTINEL(bb);
+}
+
+/// How much compressed input we inflate before rewriting it
+constexpr apr_size_t inflateSliceSize = 65536;
+
+/// Rewrites @a bb, which is never compressed, and passes it on
+apr_status_t rewriteBrigade(ap_filter_t* filter, DirConfig* dir_config, FilterContext* ctx,
+                            apr_bucket_brigade* bb) {
+    const Config* config = ctx->mappings.get();
 
     // Get our current path from Apache
     std::string location{filter->r->uri};
@@ -35,33 +215,111 @@ apr_status_t filter(ap_filter_t *filter, apr_bucket_brigade *bb) {
     if (pos != std::string::npos)
         location.resize(pos+1);
 
-    Config* config = static_cast<Config*>(ap_get_module_config(filter->r->per_dir_config, &cdnalizer_module));
-
     // Work to be sent to the next filter on flush or ending
     BrigadeGuard completed_work{filter->r->pool, filter->c->bucket_alloc};
 
+    // Set once we know every cdn url in the body
+    bool seenAll = false;
+
     // Called when we need to flush our completed work
     auto flush = [&]() {
-        apr_status_t result = ap_pass_brigade(filter->next, completed_work);
+        apr_bucket_brigade* output = completed_work;
+        if (ctx->gzip) {
+            ctx->gzip->deflate(completed_work, ctx->deflated);
+            output = ctx->deflated;
+        } else if (apr_size_t limit = dir_config->coalesceLimit()) {
+            stats::add(stats::Counter::bucketsCoalesced, coalesce(output, limit));
+        }
+        if (!ctx->passed) {
+            ctx->passed = true;
+            setContentLength(filter->r, output);
+            if (dir_config->preconnectEnabled())
+                addPreconnect(filter->r, *config,
+                              (seenAll && !ctx->usedPattern) ? &ctx->used : nullptr);
+        }
+        apr_status_t result = ap_pass_brigade(filter->next, output);
+        apr_brigade_cleanup(output);
         apr_brigade_cleanup(completed_work);
         return result;
     };
 
     // See if there's any work left over from last time
-    apr_bucket_brigade* leftover_work = static_cast<apr_bucket_brigade*>(filter->ctx);
+    apr_bucket_brigade* leftover_work = ctx->leftover_work;
     if (leftover_work && !APR_BRIGADE_EMPTY(leftover_work)) {
-        // Move the leftover bucket to our new brigade
-        apr_bucket* leftover_bucket = APR_BRIGADE_FIRST(leftover_work);
-        APR_BUCKET_REMOVE(leftover_bucket);
-        APR_BRIGADE_INSERT_HEAD(bb, leftover_bucket);
-        assert(APR_BRIGADE_EMPTY(leftover_work)); // There should only ever be zero or one buckets left over
+        // Move the leftover buckets to the front of our new brigade. A long
+        // candidate url can span a few of them.
+        APR_BRIGADE_PREPEND(bb, leftover_work);
     }
 
-    Iterator beginning{bb, flush};
-    Iterator end{EndIterator(bb)};
+    // Get the server name and protocol
+    const char* server_name = ap_get_server_name_for_url(filter->r);
+    apr_port_t port = ap_get_server_port(filter->r);
+    const char* protocol = ap_get_server_protocol(filter->r->server);
+    std::stringstream hostname;
+    hostname << protocol << "://" << server_name;
+    if (!((strcmp(protocol, "https") == 0) && (port == 443)) &&
+        !((strcmp(protocol, "http") == 0) && (port == 80)))
+        hostname << ':' << port;
+
+    // Is it CSS or HTML/XML ?
+    bool isCSS(false);
+    if ((filter->r) && (filter->r->content_type))
+      isCSS = (strcmp(filter->r->content_type, "text/css") == 0);
+
+    // Only the parser knows wildcard keys, so they need it
+    bool useSearch = (dir_config->rewriteEngine() == Engine::search) && !config->hasPatterns();
+
+    // On the first brigade, see if we've rewritten this response before
+    if (!ctx->started) {
+        ctx->started = true;
+        // Splices only record the cdn url, not the versions we put in later
+        if (dir_config->cacheEnabled() && cache::enabled() &&
+            (dir_config->rewriteVersioning() == Versioning::off)) {
+            ctx->cacheKey = cache::key(filter->r, hostname.str(), location, *config, isCSS);
+            // The engines splice in different places
+            if (!ctx->cacheKey.empty() && useSearch)
+                ctx->cacheKey += "|search";
+            if (!ctx->cacheKey.empty()) {
+                Splices splices;
+                if (cache::lookup(filter->r, ctx->cacheKey, splices)) {
+                    ap_log_rerror(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, filter->r,
+                                  "Replaying %d cached splices", static_cast<int>(splices.size()));
+                    for (const Splice& splice : splices)
+                        ctx->used.emplace_back(splice.entry, splice.host);
+                    ctx->replay.reset(new SpliceReplayer(*config, std::move(splices)));
+                } else {
+                    ctx->recording = true;
+                }
+            }
+        }
+    }
+
+    // If we have, just split the buckets where we did last time; no parsing needed
+    if (ctx->replay) {
+        // The cached splices cover the whole body
+        seenAll = true;
+        (*ctx->replay)(bb);
+        APR_BRIGADE_CONCAT(completed_work.brigade(), bb);
+        return flush();
+    }
+
+    // If this is the last brigade, we'll know all our splices by the end
+    bool lastBrigade = APR_BUCKET_IS_EOS(APR_BRIGADE_LAST(bb));
+
+    // Get what we've done so far out to the client
+    auto flushNow = [&]() {
+        APR_BRIGADE_INSERT_TAIL(completed_work.brigade(), apr_bucket_flush_create(filter->c->bucket_alloc));
+        return flush();
+    };
+    // Called by the iterator for FLUSH buckets, and while it waits on a slow
+    // backend. A FLUSH bucket stays in bb and goes out after our work, so
+    // it only needs passing on; adding our own would send two.
+    auto onFlush = [&](bool waiting) { return waiting ? flushNow() : flush(); };
 
     /// Move buckets to a new brigade
-    auto moveBuckets = [&](Iterator a, Iterator b, apr_bucket_brigade* dest) {
+    /// @param moved if given, the number of data bytes moved is added to it
+    auto moveBuckets = [&](Iterator a, Iterator b, apr_bucket_brigade* dest,
+                           apr_uint64_t* moved = nullptr) {
         // Split the last one 1st, as a split may invalidate all iterators after it
         b.split();
         a.split();
@@ -73,6 +331,8 @@ apr_status_t filter(ap_filter_t *filter, apr_bucket_brigade *bb) {
         // Move all those buckets into the other brigade
         while (bucket != last_bucket) {
             apr_bucket* next = APR_BUCKET_NEXT(bucket);
+            if (moved && !APR_BUCKET_IS_METADATA(bucket))
+                *moved += bucket->length;
             APR_BUCKET_REMOVE(bucket);
             APR_BRIGADE_INSERT_TAIL(dest, bucket);
             bucket = next;
@@ -81,6 +341,8 @@ apr_status_t filter(ap_filter_t *filter, apr_bucket_brigade *bb) {
     };
 
     // We could get a whole bunch of non-data buckets. The brigade would be technically not empty, but practically empty for our purposes
+    Iterator beginning{bb, onFlush};
+    Iterator end{EndIterator(bb)};
     if (beginning == end) {
         moveBuckets(beginning, end, completed_work);
         return flush();
@@ -91,7 +353,7 @@ apr_status_t filter(ap_filter_t *filter, apr_bucket_brigade *bb) {
                                                const Iterator &end) {
       // Move buckets from start up to the current into our completed_work
       // brigade
-      return moveBuckets(start, end, completed_work);
+      return moveBuckets(start, end, completed_work, &ctx->consumed);
     };
 
     // Called when new data to push out the filter arrives
@@ -100,42 +362,150 @@ apr_status_t filter(ap_filter_t *filter, apr_bucket_brigade *bb) {
         // Copy the data to it. Needs to be copied because it's coming from a data dict, that will dissapear when the filter does.
         apr_bucket* bucket = apr_bucket_heap_create(data.c_str(), data.size(), NULL, filter->c->bucket_alloc);
         APR_BRIGADE_INSERT_TAIL(completed_work.brigade(), bucket);
+        stats::add(stats::Counter::heapBuckets);
+    };
+
+    // Called after each rewrite, with the number of input bytes it replaced
+    SpliceEvent onSplice = [&](const std::string& key, size_t host, size_t cut) {
+        size_t entry = config->indexOf(key);
+        if (dir_config->preconnectEnabled() && !ctx->passed) {
+            if (entry == config->size())
+                ctx->usedPattern = true;
+            else if (std::find(ctx->used.begin(), ctx->used.end(), std::make_pair(entry, host)) ==
+                     ctx->used.end())
+                ctx->used.emplace_back(entry, host);
+        }
+        if (ctx->recording) {
+            // A wildcard key's url isn't in the config to replay
+            if ((entry == config->size()) || (ctx->splices.size() >= cache::maxSplices))
+                ctx->recording = false;
+            else
+                ctx->splices.push_back(Splice{ctx->consumed, static_cast<apr_uint32_t>(cut),
+                                              static_cast<apr_uint32_t>(entry),
+                                              static_cast<apr_uint32_t>(host)});
+        }
+        ctx->consumed += cut;
     };
 
     // Log that we're gonna do some work
     const char* log_location = location.c_str();
     ap_log_rerror(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, filter->r, "Filtering Location: %s", log_location);
 
-    // Get the server name and protocol
-    const char* server_name = ap_get_server_name_for_url(filter->r);
-    apr_port_t port = ap_get_server_port(filter->r);
-    const char* protocol = ap_get_server_protocol(filter->r->server);
-    std::stringstream hostname;
-    hostname << protocol << "://" << server_name;
-    if (!((strcmp(protocol, "https") == 0) && (port == 443)) &&
-        !((strcmp(protocol, "http") == 0) && (port == 80)))
-        hostname << ':' << port;
+    // With CDN_FLUSH_BYTES or CDN_FLUSH_USEC set, we rewrite the brigade a
+    // slice at a time, so we can send the start of a big page on before
+    // we've read to the end of it
+    apr_size_t flushBytes = dir_config->flushBytes > 0 ? dir_config->flushBytes : 0;
+    apr_interval_time_t flushUsec = dir_config->flushUsec > 0 ? dir_config->flushUsec : 0;
+    apr_size_t sliceSize = flushBytes ? flushBytes : ((flushUsec != 0) ? defaultSliceSize : 0);
+    apr_uint64_t flushedAt = ctx->consumed;
+    apr_time_t flushedTime = apr_time_now();
+    BrigadeGuard rest{filter->r->pool, filter->c->bucket_alloc};
+    // Bytes carried over to the front of this slice; each slice reads a
+    // whole sliceSize past them, so a long tag can't stall us
+    apr_uint64_t carried = 0;
 
-    // Is it CSS or HTML/XML ?
-    bool isCSS(false);
-    if ((filter->r) && (filter->r->content_type))
-      isCSS = (strcmp(filter->r->content_type, "text/css") == 0);
+    while (true) {
+        if (sliceSize != 0)
+            apr_brigade_split_ex(bb, sliceEnd(bb, carried + sliceSize), rest);
+        bool lastSlice = APR_BRIGADE_EMPTY(rest.brigade());
+        beginning = Iterator{bb, onFlush};
+        end = EndIterator(bb);
 
-    // Do the actual rewriting now: TODO: check the mime type for css/html
-    Iterator tag_start =
-        rewriteHTML(hostname.str(), location, *config, beginning, end,
-                    onUnchangedData, newData, isCSS);
+        // Do the actual rewriting now: TODO: check the mime type for css/html
+        apr_uint64_t consumedBefore = ctx->consumed;
+        Iterator tag_start =
+            useSearch
+                ? searchAndRewrite(hostname.str(), location, *config, beginning, end,
+                                   onUnchangedData, newData, onSplice)
+                : rewriteHTML(hostname.str(), location, *config, beginning, end,
+                              onUnchangedData, newData, isCSS, onSplice,
+                              // Hands us back the '<' of a tag cut at the end
+                              [] {});
 
-    // Store any left over data for next time
-    if (tag_start != end) {
-        if (!leftover_work)
-            filter->ctx = leftover_work = static_cast<apr_bucket_brigade*>(apr_brigade_create(filter->r->pool, filter->c->bucket_alloc));
-        moveBuckets(tag_start, end, leftover_work);
+        // There's no more data coming, so whatever's left is just data
+        if (lastBrigade && lastSlice && (tag_start != end))
+            tag_start = onUnchangedData(tag_start, end);
+
+        if (!lastSlice) {
+            // Carry an unfinished tag over to the front of the next slice.
+            // What's left in bb was cut out by the rewriter.
+            BrigadeGuard carried_work{filter->r->pool, filter->c->bucket_alloc};
+            carried = 0;
+            if (tag_start != end)
+                moveBuckets(tag_start, end, carried_work, &carried);
+            apr_brigade_cleanup(bb);
+            APR_BRIGADE_CONCAT(bb, carried_work.brigade());
+            APR_BRIGADE_CONCAT(bb, rest.brigade());
+            stats::add(stats::Counter::bytesScanned, ctx->consumed - consumedBefore);
+            // Send what we've got, if it's big enough or we've taken long enough
+            apr_time_t now = apr_time_now();
+            if (((flushBytes != 0) && (ctx->consumed - flushedAt >= flushBytes)) ||
+                ((flushUsec != 0) && (now - flushedTime >= flushUsec))) {
+                apr_status_t status = flushNow();
+                if (status != APR_SUCCESS)
+                    return status;
+                flushedAt = ctx->consumed;
+                flushedTime = now;
+            }
+            continue;
+        }
+
+        // Store any left over data for next time
+        if (tag_start != end) {
+            BrigadeGuard carried_work{filter->r->pool, filter->c->bucket_alloc};
+            carried = 0;
+            moveBuckets(tag_start, end, carried_work, &carried);
+            // They may point at memory the next filter up reuses once we return
+            // (eg. mod_proxy's transient buckets), so set them aside
+            apr_bucket_brigade* pending = carried_work.brigade();
+            apr_status_t saved = ap_save_brigade(filter, &ctx->leftover_work, &pending, filter->r->pool);
+            if (saved != APR_SUCCESS)
+                return saved;
+            stats::add(stats::Counter::leftoverBytes, carried);
+            CDNALIZER_PROBE(leftover, filter->r, static_cast<long>(carried));
+        }
+        stats::add(stats::Counter::bytesScanned, ctx->consumed - consumedBefore);
+        break;
     }
-    
+
+    // Remember where we spliced, so the next request can skip the parsing
+    if (ctx->recording && lastBrigade)
+        cache::store(filter->r, ctx->cacheKey, ctx->splices);
+
     // Send all our comleted work to the next filter
+    seenAll = lastBrigade;
     return flush();
 }
 
+apr_status_t filter(ap_filter_t *filter, apr_bucket_brigade *bb) {
+    // Just pass on empty brigades
+    if (APR_BRIGADE_EMPTY(bb)) { return APR_SUCCESS; }
+
+    DirConfig* dir_config = static_cast<DirConfig*>(ap_get_module_config(filter->r->per_dir_config, &cdnalizer_module));
+
+    FilterContext* ctx = getContext(filter, *dir_config);
+    if (!ctx) {
+        // We can't read this body, so get out of the way
+        ap_remove_output_filter(filter);
+        return ap_pass_brigade(filter->next, bb);
+    }
+    if (!ctx->gzip)
+        return rewriteBrigade(filter, dir_config, ctx, bb);
+
+    // Compressed input gets unpacked a slice at a time, and each slice is
+    // rewritten and compressed again before we unpack the next one
+    while (!APR_BRIGADE_EMPTY(bb)) {
+        ctx->gzip->inflate(bb, ctx->inflated, inflateSliceSize);
+        if (APR_BRIGADE_EMPTY(ctx->inflated))
+            continue;
+        apr_status_t status = rewriteBrigade(filter, dir_config, ctx, ctx->inflated);
+        // Anything still in the inflated brigade was cut out by the rewriter
+        apr_brigade_cleanup(ctx->inflated);
+        if (status != APR_SUCCESS)
+            return status;
+    }
+    return APR_SUCCESS;
+}
+
 }
 }
@@ -0,0 +1,88 @@
+/**
+ * © Copyright 2017 Matthew Sherborne. All Rights Reserved.
+ * License: Apache License, Version 2.0 (See LICENSE.txt)
+ **/
+#include "gzip.hpp"
+#include "utils.hpp"
+
+#include <strings.h>
+
+namespace cdnalizer {
+namespace apache {
+
+void GzipStage::inflate(apr_bucket_brigade *in, apr_bucket_brigade *out,
+                        apr_size_t most) {
+  apr_size_t produced = 0;
+  auto onChunk = [out, &produced](const char *data, size_t size) {
+    produced += size;
+    APR_BRIGADE_INSERT_TAIL(
+        out, apr_bucket_heap_create(data, size, NULL, out->bucket_alloc));
+  };
+  while (!APR_BRIGADE_EMPTY(in) && (produced < most)) {
+    apr_bucket *bucket = APR_BRIGADE_FIRST(in);
+    if (APR_BUCKET_IS_METADATA(bucket)) {
+      // Everything the body decompresses to goes before the end of it
+      if (APR_BUCKET_IS_EOS(bucket))
+        inflater.finish(onChunk);
+      APR_BUCKET_REMOVE(bucket);
+      APR_BRIGADE_INSERT_TAIL(out, bucket);
+      continue;
+    }
+    const char *data;
+    apr_size_t length;
+    checkStatusCode(apr_bucket_read(bucket, &data, &length, APR_BLOCK_READ));
+    apr_size_t used = inflater.feed(data, length, most - produced, onChunk);
+    // Leave what we didn't get to for next time
+    if (used != length)
+      checkStatusCode(apr_bucket_split(bucket, used));
+    apr_bucket_delete(bucket);
+  }
+}
+
+void GzipStage::deflate(apr_bucket_brigade *in, apr_bucket_brigade *out) {
+  auto onChunk = [out](const char *data, size_t size) {
+    APR_BRIGADE_INSERT_TAIL(
+        out, apr_bucket_heap_create(data, size, NULL, out->bucket_alloc));
+  };
+  while (!APR_BRIGADE_EMPTY(in)) {
+    apr_bucket *bucket = APR_BRIGADE_FIRST(in);
+    if (APR_BUCKET_IS_FLUSH(bucket)) {
+      if (started)
+        deflater.flush(onChunk);
+    } else if (APR_BUCKET_IS_EOS(bucket)) {
+      // Bodyless responses (HEAD, 304) stay bodyless
+      if (started)
+        deflater.finish(onChunk);
+    } else if (!APR_BUCKET_IS_METADATA(bucket)) {
+      const char *data;
+      apr_size_t length;
+      checkStatusCode(
+          apr_bucket_read(bucket, &data, &length, APR_BLOCK_READ));
+      if (length != 0) {
+        started = true;
+        deflater.feed(data, length, onChunk);
+      }
+      apr_bucket_delete(bucket);
+      continue;
+    }
+    APR_BUCKET_REMOVE(bucket);
+    APR_BRIGADE_INSERT_TAIL(out, bucket);
+  }
+}
+
+bool gzipFormat(const char *content_encoding, gzip::Format &format) {
+  if (content_encoding == nullptr)
+    return false;
+  if ((strcasecmp(content_encoding, "gzip") == 0) ||
+      (strcasecmp(content_encoding, "x-gzip") == 0)) {
+    format = gzip::Format::gzip;
+    return true;
+  }
+  if (strcasecmp(content_encoding, "deflate") == 0) {
+    format = gzip::Format::deflate;
+    return true;
+  }
+  return false;
+}
+}
+}
@@ -0,0 +1,47 @@
+#pragma once
+/**
+ * Unpacks gzip/deflate encoded bucket brigades before we rewrite them, and
+ * packs them up again afterwards.
+ *
+ * © Copyright 2017 Matthew Sherborne. All Rights Reserved.
+ * License: Apache License, Version 2.0 (See LICENSE.txt)
+ **/
+
+#include "../Gzip.hpp"
+
+extern "C" {
+#include <apr_buckets.h>
+}
+
+namespace cdnalizer {
+namespace apache {
+
+/// Lives for the whole request, as the z streams carry state between brigades
+class GzipStage {
+private:
+  gzip::Inflater inflater;
+  gzip::Deflater deflater;
+  /// True once we've sent any compressed data down the line
+  bool started = false;
+
+public:
+  /// @param level zlib compression level for the output; 0 for zlib's default
+  GzipStage(gzip::Format format, int level)
+      : deflater(format, level == 0 ? Z_DEFAULT_COMPRESSION : level) {}
+  /// Moves buckets from @a in to the end of @a out, replacing the
+  /// compressed data buckets with inflated heap buckets, until it has
+  /// inflated @a most bytes or more. What's left stays in @a in for the next
+  /// call. Metadata buckets keep their place in the stream.
+  void inflate(apr_bucket_brigade *in, apr_bucket_brigade *out,
+               apr_size_t most);
+  /// Moves everything from @a in to the end of @a out, compressing the data
+  /// buckets. FLUSH buckets sync flush the compressor, and EOS finishes the
+  /// stream.
+  void deflate(apr_bucket_brigade *in, apr_bucket_brigade *out);
+};
+
+/// @returns true and sets @a format if we know how to unpack
+/// @a content_encoding
+bool gzipFormat(const char *content_encoding, gzip::Format &format);
+}
+}
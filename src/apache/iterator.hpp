@@ -11,7 +11,10 @@
 #include <cassert>
 
 #include "AbstractBlockIterator.hpp"
+#include "fileview.hpp"
 #include "utils.hpp"
+#include "../Search.hpp"
+#include "../Stats.hpp"
 
 extern "C" {
 #include <apr_buckets.h>
@@ -23,13 +26,30 @@ namespace apache {
 /// Wraps an APR bucket. Makes it useable in AbstractBlockIterator
 class BucketWrapper {
 public:
-    typedef std::function<apr_status_t()> FlushHandler;
+    /// Sends our completed work on. @a waiting is true when we're about to
+    /// block on a slow bucket, so the work needs a FLUSH of its own; false
+    /// when we've passed a FLUSH bucket, which will follow the work anyway.
+    typedef std::function<apr_status_t(bool waiting)> FlushHandler;
 private:
     apr_bucket_brigade* bb;
     FlushHandler onFlush;
     apr_bucket* _bucket;
     apr_size_t length;
     const char* data;
+    /// True when data is a view of a FILE bucket's file (see fileview.hpp)
+    bool mapped = false;
+    /// Reads the current bucket. Pipes and sockets (CGI, proxies) may not have
+    /// data yet; rather than sit on what we've done while we wait, we flush
+    /// it on to the client first.
+    void read() {
+        apr_status_t status = apr_bucket_read(_bucket, &data, &length, APR_NONBLOCK_READ);
+        if (APR_STATUS_IS_EAGAIN(status)) {
+            if (onFlush)
+                checkStatusCode(onFlush(true));
+            status = apr_bucket_read(_bucket, &data, &length, APR_BLOCK_READ);
+        }
+        checkStatusCode(status);
+    }
     /// Inits all our variables for the next bucket
     void init4NewBucket() {
         apr_bucket* sentinel = APR_BRIGADE_SENTINEL(bb);
@@ -40,7 +60,7 @@ private:
             } else if (APR_BUCKET_IS_FLUSH(_bucket)) {
                 // We should send our completed work on to the next filter
                 if (onFlush)
-                    checkStatusCode(onFlush());
+                    checkStatusCode(onFlush(false));
             } else {
                 // Any other bucket is not skippable
                 break;
@@ -56,9 +76,16 @@ private:
             data = nullptr;
             return;
         } else {
-            // Get the data out of the bucket if there is any
-            if (_bucket != sentinel)
-                checkStatusCode(apr_bucket_read(_bucket, &data, &length, APR_BLOCK_READ));
+            // Get the data out of the bucket if there is any. Big file
+            // buckets are read through a mapping, so they stay file buckets.
+            if (_bucket != sentinel) {
+                data = fileView(_bucket);
+                mapped = data != nullptr;
+                if (mapped)
+                    length = _bucket->length;
+                else
+                    read();
+            }
         }
     }
 public:
@@ -93,7 +120,13 @@ public:
             return; // Can't split the one-after-last bucket
         if ((pos != data) && (pos != data + length)) {
             apr_bucket_split(_bucket, pos-data);
-            checkStatusCode(apr_bucket_read(_bucket, const_cast<const char**>(&data), const_cast<apr_size_t*>(&length), APR_BLOCK_READ));
+            stats::add(stats::Counter::bucketSplits);
+            // Reading a file bucket would copy it into the heap; the view
+            // already has its data
+            if (mapped)
+                const_cast<apr_size_t&>(length) = pos - data;
+            else
+                checkStatusCode(apr_bucket_read(_bucket, const_cast<const char**>(&data), const_cast<apr_size_t*>(&length), APR_BLOCK_READ));
         }
     }
     // Point to the next bucket
@@ -123,10 +156,8 @@ struct Iterator : AbstractBlockIterator<const char*, BucketWrapper>  {
     /// If succesful, we move to the beginnig of the next block after the split (data we point at stays the same)
     void split() {
         block.split(position);
-        if (position == block.end()) {
-            ++block;
-            position = block.begin();
-        }
+        if (position == block.end())
+            nextBlock();
     }
     apr_bucket* bucket() const { return block.bucket(); }
     Iterator& operator++() { return static_cast<Iterator&>(Base::operator++()); }
@@ -138,9 +169,23 @@ struct Iterator : AbstractBlockIterator<const char*, BucketWrapper>  {
 };
 
 /// Convenience function to return the (one after the last) Iterator in a brigade
-Iterator EndIterator(apr_bucket_brigade* bb) {
+inline Iterator EndIterator(apr_bucket_brigade* bb) {
     return Iterator{bb, BucketWrapper::FlushHandler{}, APR_BRIGADE_SENTINEL(bb), 0};
 }
 
+/// Moves @a pos to the next quote or '(' for searchAndRewrite, searching a
+/// whole bucket at a time (found by ADL; see search::skipToContext)
+inline void skipToContext(Iterator& pos, const Iterator& end) {
+    while (pos != end) {
+        const char* stop = (pos.block == end.block) ? end.position : pos.block.end();
+        const char* found = search::findContext(pos.position, stop);
+        if (found != pos.block.end()) {
+            pos.position = found;
+            return;
+        }
+        pos.nextBlock();
+    }
+}
+
 }
 }
@@ -6,26 +6,53 @@
 #include "mod_cdnalizer.hpp"
 #include "filter.hpp"
 #include "config.hpp"
+#include "cache.hpp"
+#include "status.hpp"
+#include "../Probes.hpp"
 
 extern "C" {
 #include <httpd.h>
+#include <http_config.h>
 #include <http_protocol.h>
+#include <mod_status.h>
 
 static const char cdnalizer_filter_name[] = "CDNALIZER";
 
 static apr_status_t cdnalize_out_filter(ap_filter_t *filter, apr_bucket_brigade *bb)
 {
+    if (CDNALIZER_PROBE_ENABLED(filter__entry)) {
+        // Only worth counting when someone's listening
+        int buckets = 0;
+        for (apr_bucket* b = APR_BRIGADE_FIRST(bb); b != APR_BRIGADE_SENTINEL(bb); b = APR_BUCKET_NEXT(b))
+            ++buckets;
+        apr_off_t bytes;
+        apr_brigade_length(bb, 0, &bytes);
+        CDNALIZER_PROBE(filter__entry, filter->r, filter->r->uri, buckets, static_cast<long>(bytes));
+    }
+    apr_status_t result;
     try {
-        return cdnalizer::apache::filter(filter, bb);
+        cdnalizer::probes::RequestScope probing(filter->r);
+        result = cdnalizer::apache::filter(filter, bb);
     } catch (...) {
-        return APR_OS_START_USERERR;
+        result = APR_OS_START_USERERR;
     }
+    CDNALIZER_PROBE(filter__return, filter->r, static_cast<int>(result));
+    return result;
 }
 
 static void cdnalizer_register_hooks(apr_pool_t *)
 {
     ap_register_output_filter(cdnalizer_filter_name, cdnalize_out_filter, NULL,
                               AP_FTYPE_CONTENT_SET);
+    ap_hook_pre_config(cdnalizer::apache::cache::preConfig, NULL, NULL,
+                       APR_HOOK_MIDDLE);
+    ap_hook_post_config(cdnalizer::apache::cache::postConfig, NULL, NULL,
+                        APR_HOOK_MIDDLE);
+    ap_hook_child_init(cdnalizer::apache::cache::childInit, NULL, NULL,
+                       APR_HOOK_MIDDLE);
+    // Only called if mod_status is loaded
+    APR_OPTIONAL_HOOK(ap, status_hook, cdnalizer::apache::statusHook, NULL,
+                      NULL, APR_HOOK_MIDDLE);
 }
 
 
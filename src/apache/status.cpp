@@ -0,0 +1,49 @@
+/**
+ * © Copyright 2017 Matthew Sherborne. All Rights Reserved.
+ * License: Apache License, Version 2.0 (See LICENSE.txt)
+ **/
+#include "status.hpp"
+#include "../Stats.hpp"
+
+#include <cctype>
+#include <string>
+
+extern "C" {
+#include <http_protocol.h>
+#include <httpd.h>
+#include <mod_status.h>
+}
+
+namespace cdnalizer {
+namespace apache {
+
+int statusHook(request_rec *r, int flags) {
+  stats::Totals totals = stats::collect();
+  if (flags & AP_STATUS_SHORT) {
+    // Machine readable: 'CDNalizerBytesScanned: 1234'
+    for (size_t i = 0; i < stats::counterCount; ++i) {
+      std::string name = stats::name(static_cast<stats::Counter>(i));
+      name.front() = std::toupper(name.front());
+      ap_rprintf(r, "CDNalizer%s: %llu\n", name.c_str(),
+                 static_cast<unsigned long long>(totals.counters[i]));
+    }
+    return OK;
+  }
+  ap_rputs("<hr />\n<h2>CDNalizer (this child process)</h2>\n<table>\n", r);
+  for (size_t i = 0; i < stats::counterCount; ++i)
+    ap_rprintf(r, "<tr><th align=\"left\">%s</th><td>%llu</td></tr>\n",
+               stats::name(static_cast<stats::Counter>(i)),
+               static_cast<unsigned long long>(totals.counters[i]));
+  ap_rputs("</table>\n", r);
+  if (!totals.hits.empty()) {
+    ap_rputs("<h3>Hits per CDN_URL</h3>\n<table>\n", r);
+    for (const auto &pair : totals.hits)
+      ap_rprintf(r, "<tr><th align=\"left\">%s</th><td>%llu</td></tr>\n",
+                 ap_escape_html(r->pool, pair.first.c_str()),
+                 static_cast<unsigned long long>(pair.second));
+    ap_rputs("</table>\n", r);
+  }
+  return OK;
+}
+}
+}
@@ -0,0 +1,23 @@
+#pragma once
+/**
+ * Shows our counters (see ../Stats.hpp) on the mod_status page
+ *
+ * They're added to /server-status, and to /server-status?auto as
+ * 'CDNalizer<Name>: <value>' lines. Each child process counts for itself, so
+ * you see the counters of the child that served the status page.
+ *
+ * © Copyright 2017 Matthew Sherborne. All Rights Reserved.
+ * License: Apache License, Version 2.0 (See LICENSE.txt)
+ **/
+
+extern "C" {
+#include <httpd.h>
+}
+
+namespace cdnalizer {
+namespace apache {
+
+/// Registered with mod_status's status_hook in mod_cdnalizer.cpp
+int statusHook(request_rec *r, int flags);
+}
+}
@@ -107,6 +107,15 @@ void testSmallBlocks() {
   std::copy_n(b, 4, std::back_inserter(bits));
   cout << "bits: " << bits << endl;
   assert(bits == "bits");
+  // Copies know how far apart they are without walking the blocks
+  assert(A - start == 12);
+  assert(b - start == 6);
+  assert(cdnalizer::utils::distance(b, A) == 6);
+  auto skipped = start;
+  cdnalizer::utils::advance(skipped, 12);
+  assert(skipped == A);
+  assert(cdnalizer::utils::distance(start, end_in) ==
+         static_cast<long>(input.size()));
   auto s = std::make_reverse_iterator(A - 2);
   std::string stib;
   std::copy(s, make_reverse_iterator(b), std::back_inserter(stib));
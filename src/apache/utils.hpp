@@ -69,7 +69,7 @@ public:
 };
 
 /// Throws an exception if the code is not APR_SUCCESS
-void checkStatusCode(apr_status_t code) {
+inline void checkStatusCode(apr_status_t code) {
     if (code != APR_SUCCESS)
         throw ApacheException(code);
 }
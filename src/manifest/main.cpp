@@ -0,0 +1,176 @@
+/** Writes a CDN_MANIFEST for a document root
+ *
+ * Lists every file under the root with a hash of its content, for
+ * CDN_MANIFEST and CDN_VERSION. Run it after each sync to the CDN:
+ *
+ *     cdnalizer-manifest -o /etc/cdnalizer/uploaded /var/www/uploads /uploads
+ *
+ * Paths are percent encoded, as they'd be in a url, so names with spaces
+ * and the like can't break the file.
+ *
+ * Files are hashed by a pool of threads, and the manifest is written to a
+ * temporary file then renamed into place, so Apache never loads half of it.
+ *
+ * © Copyright 2017 Matthew Sherborne. All Rights Reserved.
+ * License: Apache License, Version 2.0 (See LICENSE.txt)
+ **/
+
+#include "../Manifest.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <ftw.h>
+#include <unistd.h>
+#include <zlib.h>
+
+namespace {
+
+struct File {
+  std::string path;    // Relative to the document root
+  std::string version; // Empty if we couldn't read it
+};
+
+/// Filled in by nftw()
+std::vector<File> *found = nullptr;
+size_t rootLength = 0;
+
+int addFile(const char *path, const struct stat *, int type, struct FTW *) {
+  if (type == FTW_F)
+    found->push_back({path + rootLength, {}});
+  return 0;
+}
+
+/// @returns a 12 hex digit hash of the file's content, or "" if we can't
+/// read it. crc32 and adler32 together, as zlib gives us both cheaply.
+std::string hashFile(const std::string &filename) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+    return {};
+  std::vector<unsigned char> buffer(256 * 1024);
+  uLong crc = crc32(0, Z_NULL, 0);
+  uLong adler = adler32(0, Z_NULL, 0);
+  ssize_t got;
+  while ((got = read(fd, buffer.data(), buffer.size())) > 0) {
+    crc = crc32(crc, buffer.data(), static_cast<uInt>(got));
+    adler = adler32(adler, buffer.data(), static_cast<uInt>(got));
+  }
+  close(fd);
+  if (got < 0)
+    return {};
+  char result[13];
+  std::snprintf(result, sizeof(result), "%08lx%04lx", crc & 0xffffffff,
+                adler & 0xffff);
+  return result;
+}
+
+void usage(const char *name) {
+  std::cerr << "Usage: " << name
+            << " [-j threads] [-o output] document_root [url_prefix]\n"
+               "Lists every file under document_root, as url_prefix (default "
+               "'/') plus its path, with a hash of its content.\n";
+}
+}
+
+int main(int argc, char **argv) {
+  unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+  std::string output;
+  int option;
+  while ((option = getopt(argc, argv, "j:o:h")) != -1) {
+    switch (option) {
+    case 'j':
+      threads = static_cast<unsigned>(std::max(1, std::atoi(optarg)));
+      break;
+    case 'o':
+      output = optarg;
+      break;
+    default:
+      usage(argv[0]);
+      return option == 'h' ? 0 : 2;
+    }
+  }
+  if ((optind == argc) || (argc - optind > 2)) {
+    usage(argv[0]);
+    return 2;
+  }
+  std::string root(argv[optind]);
+  while ((root.size() > 1) && (root.back() == '/'))
+    root.pop_back();
+  std::string prefix(optind + 1 < argc ? argv[optind + 1] : "/");
+  if (prefix.empty() || (prefix.back() != '/'))
+    prefix.push_back('/');
+
+  // Find the files
+  std::vector<File> files;
+  found = &files;
+  // "/" already ends in its slash
+  rootLength = (root == "/") ? 1 : root.size() + 1;
+  if (nftw(root.c_str(), addFile, 64, FTW_PHYS) != 0) {
+    std::cerr << "Can't read " << root << ": " << std::strerror(errno) << '\n';
+    return 1;
+  }
+
+  // Hash them; each thread takes the next file nobody has started
+  std::atomic<size_t> next{0};
+  std::vector<std::thread> pool;
+  for (unsigned i = 0; i < threads; ++i)
+    pool.emplace_back([&]() {
+      for (size_t n; (n = next++) < files.size();)
+        files[n].version = hashFile(root + '/' + files[n].path);
+    });
+  for (auto &thread : pool)
+    thread.join();
+
+  std::sort(files.begin(), files.end(),
+            [](const File &a, const File &b) { return a.path < b.path; });
+
+  // Write it, replacing the old one in one go
+  std::string temporary = output + ".tmp";
+  std::ofstream file;
+  if (!output.empty()) {
+    file.open(temporary, std::ios::trunc);
+    if (!file) {
+      std::cerr << "Can't write " << temporary << ": " << std::strerror(errno)
+                << '\n';
+      return 1;
+    }
+  }
+  std::ostream &out = output.empty() ? std::cout : file;
+  int unreadable = 0;
+  out << "# Written by cdnalizer-manifest from " << root << '\n';
+  for (const auto &entry : files) {
+    if (entry.version.empty()) {
+      std::cerr << "Can't read " << root << '/' << entry.path << '\n';
+      ++unreadable;
+      continue;
+    }
+    out << cdnalizer::Manifest::encode(prefix.data(), prefix.size())
+        << cdnalizer::Manifest::encode(entry.path.data(), entry.path.size(),
+                                       true)
+        << ' ' << entry.version << '\n';
+  }
+  out.flush();
+  if (!out) {
+    std::cerr << "Error writing the manifest\n";
+    return 1;
+  }
+  if (!output.empty()) {
+    file.close();
+    if (std::rename(temporary.c_str(), output.c_str()) != 0) {
+      std::cerr << "Can't rename " << temporary << " to " << output << ": "
+                << std::strerror(errno) << '\n';
+      return 1;
+    }
+  }
+  return unreadable == 0 ? 0 : 1;
+}
@@ -27,10 +27,11 @@ struct pair : std::pair<iterator, iterator> {
     pair() : ParentClass() {};
     pair(const pair& other) : ParentClass(other.first, other.second) {}
     pair(iterator first, iterator second) : ParentClass(first, second) {};
-    /// Subscript into the selection
+    /// Subscript into the selection; O(1) for iterators that can subtract
     char operator[](size_t i) const {
         auto output = this->first;
-        while ((i-- > 0) && (output++ != this->second));
+        auto size = utils::distance(this->first, this->second);
+        utils::advance(output, std::min<decltype(size)>(i, size));
         return *output;
     }
     /// @returns true if we have some data
@@ -0,0 +1,147 @@
+/**
+ * Times the ragel machines, so we can compare RAGEL_CODE_STYLEs.
+ *
+ * usage: bench_parser [iterations [page.html]]
+ *
+ * Prints one line per machine: 'name MB/s'. 'path' is the PathClassifier,
+ * which isn't ragel, but is a useful yardstick.
+ *
+ * © Copyright 2017 Matthew Sherborne. All Rights Reserved.
+ * License: Apache License, Version 2.0 (See LICENSE.txt)
+ **/
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "css.hpp"
+#include "html.hpp"
+#include "js.hpp"
+#include "../PathClassifier.hpp"
+
+using namespace cdnalizer::parser;
+using Iterator = const char *;
+using Range = boost::iterator_range<Iterator>;
+
+namespace {
+
+/// Stops the compiler optimizing the work away
+volatile size_t sink = 0;
+
+/// Runs @a work @a iterations times over @a bytes of input and prints MB/s
+template <typename Work>
+void time(const char *name, size_t bytes, int iterations, Work work) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i)
+    work();
+  std::chrono::duration<double> seconds =
+      std::chrono::steady_clock::now() - start;
+  std::cout << name << ' '
+            << (bytes * static_cast<double>(iterations)) / seconds.count() /
+                   (1024 * 1024)
+            << std::endl;
+}
+
+std::string readFile(const char *filename) {
+  std::ifstream in(filename);
+  std::stringstream result;
+  result << in.rdbuf();
+  return result.str();
+}
+
+/// A page about the shape of a typical blog post
+std::string makePage() {
+  std::string result = "<!DOCTYPE html>\n<html><head><title>Bench</title>\n";
+  for (int i = 0; i < 20; ++i)
+    result += R"(<link rel="stylesheet" href="/css/style)" +
+              std::to_string(i) + R"(.css" type="text/css" media="all" />)"
+              "\n";
+  result += "</head><body>\n";
+  for (int i = 0; i < 2000; ++i)
+    result += R"(<div class="post" id="post-)" + std::to_string(i) +
+              R"("><p>Some words about things, and more words.</p>)"
+              R"(<a href="/blog/post.php?id=)" +
+              std::to_string(i) +
+              R"("><img src="/images/thumb)" + std::to_string(i) +
+              R"(.jpg" alt="thumbnail" width="64" height="64" /></a>)"
+              R"html(<span style="background: url(/images/bg.png)">x</span></div>)html"
+              "\n";
+  return result + "</body></html>\n";
+}
+
+std::string makeCSS() {
+  std::string result;
+  for (int i = 0; i < 5000; ++i)
+    result += ".item" + std::to_string(i) +
+              " { color: #333; margin: 0 auto; background: url('/images/i" +
+              std::to_string(i) + ".png') no-repeat; }\n";
+  return result;
+}
+
+std::string makeJS() {
+  std::string result;
+  for (int i = 0; i < 5000; ++i)
+    result += "var img" + std::to_string(i) +
+              " = new Image(); img.src = \"/images/j" + std::to_string(i) +
+              ".gif\"; if (a < b) { c = 'd'; }\n";
+  return result;
+}
+}
+
+int main(int argc, char **argv) {
+  int iterations = (argc > 1) ? std::atoi(argv[1]) : 50;
+  std::string html = (argc > 2) ? readFile(argv[2]) : makePage();
+  std::string css = makeCSS();
+  std::string js = makeJS();
+  std::vector<std::string> paths;
+  for (int i = 0; i < 1000; ++i) {
+    paths.push_back("/images/some/deep/path/picture" + std::to_string(i) +
+                    ".jpg");
+    paths.push_back("/blog/index.php?page=" + std::to_string(i));
+  }
+  size_t pathBytes = 0;
+  for (const auto &path : paths)
+    pathBytes += path.size();
+
+  std::function<void(Range)> onTag = [](Range name) { sink += name.size(); };
+  std::function<void(Range, Range)> onAttribute = [](Range, Range value) {
+    sink += value.size();
+  };
+  std::function<void(Iterator, Iterator)> onPath = [](Iterator a, Iterator b) {
+    sink += b - a;
+  };
+
+  time("tag", html.size(), iterations, [&]() {
+    Iterator p = html.data();
+    Iterator pe = html.data() + html.size();
+    while (p != pe) {
+      while ((p != pe) && (*p != '<'))
+        ++p;
+      if (p == pe)
+        break;
+      parseHTMLTag<Iterator>(p, pe, onTag, onAttribute);
+    }
+  });
+  time("css", css.size(), iterations, [&]() {
+    Iterator p = css.data();
+    Iterator pe = css.data() + css.size();
+    while (p != pe)
+      parseCSS(p, pe, onPath);
+  });
+  time("js", js.size(), iterations, [&]() {
+    Iterator p = js.data();
+    Iterator pe = js.data() + js.size();
+    while (p != pe)
+      parseJS(p, pe, onPath);
+  });
+  cdnalizer::PathClassifier classifier;
+  time("path", pathBytes, iterations * 10, [&]() {
+    for (const auto &path : paths)
+      sink += classifier.isStatic(path);
+  });
+  return 0;
+}
@@ -1,83 +1,25 @@
-
-#line 1 "/home/ubuntu/projects/cdnalizer/src/parser/css.hpp.rl"
 #pragma once
 
+// ragel's -G2 goto code falls from each state's case into the next one on
+// purpose. (-Wpragmas keeps compilers without -Wimplicit-fallthrough quiet.)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpragmas"
+#pragma GCC diagnostic ignored "-Wimplicit-fallthrough"
+
 namespace cdnalizer {
 namespace parser {
 
 
-#line 9 "/home/ubuntu/projects/cdnalizer/src/parser/css.hpp.rl"
-
-
 // State machine exports
 
-#line 15 "/home/ubuntu/projects/cdnalizer/src/parser/css.hpp"
-
-#line 13 "/home/ubuntu/projects/cdnalizer/src/parser/css.hpp.rl"
 
 // State machine data
-
-#line 21 "/home/ubuntu/projects/cdnalizer/src/parser/css.hpp"
-static const char _css_actions[] = {
-	0, 1, 0, 1, 1
-};
-
-static const char _css_key_offsets[] = {
-	0, 0, 1, 3, 5, 9, 15, 21, 
-	25, 26, 27, 28, 29
-};
-
-static const char _css_trans_keys[] = {
-	117, 114, 117, 108, 117, 32, 40, 9, 
-	13, 32, 34, 39, 41, 9, 13, 32, 
-	34, 39, 41, 9, 13, 32, 41, 9, 
-	13, 34, 34, 39, 39, 117, 0
-};
-
-static const char _css_single_lengths[] = {
-	0, 1, 2, 2, 2, 4, 4, 2, 
-	1, 1, 1, 1, 1
-};
-
-static const char _css_range_lengths[] = {
-	0, 0, 0, 0, 1, 1, 1, 1, 
-	0, 0, 0, 0, 0
-};
-
-static const char _css_index_offsets[] = {
-	0, 0, 2, 5, 8, 12, 18, 24, 
-	28, 30, 32, 34, 36
-};
-
-static const char _css_indicies[] = {
-	1, 0, 2, 1, 0, 3, 1, 0, 
-	3, 5, 3, 4, 5, 7, 8, 4, 
-	5, 6, 10, 4, 4, 11, 10, 9, 
-	12, 13, 12, 4, 4, 14, 10, 15, 
-	4, 16, 10, 17, 1, 0, 0
-};
-
-static const char _css_trans_targs[] = {
-	1, 2, 3, 4, 0, 5, 6, 8, 
-	10, 6, 7, 12, 7, 12, 9, 9, 
-	11, 11
-};
-
-static const char _css_trans_actions[] = {
-	0, 0, 0, 0, 0, 0, 1, 0, 
-	0, 0, 3, 3, 0, 0, 1, 0, 
-	1, 0
-};
-
 static const int css_start = 12;
 static const int css_first_final = 12;
 static const int css_error = 0;
 
 static const int css_en_css = 12;
 
-
-#line 16 "/home/ubuntu/projects/cdnalizer/src/parser/css.hpp.rl"
-
 /// Parses some CSS, looking for url() functions
 /// @param A reference to the pointer to the start of the data. This will be incremented as our search continues
 /// @param pe A const reference to the pointer to the end of the input
@@ -95,119 +37,176 @@ Iterator parseCSS(Iterator &p, const Iterator& pe,
 
   // State machine initialization
   
-#line 99 "/home/ubuntu/projects/cdnalizer/src/parser/css.hpp"
 	{
 	cs = css_start;
 	}
 
-#line 34 "/home/ubuntu/projects/cdnalizer/src/parser/css.hpp.rl"
-
   // State machine code
   
-#line 108 "/home/ubuntu/projects/cdnalizer/src/parser/css.hpp"
 	{
-	int _klen;
-	unsigned int _trans;
-	const char *_acts;
-	unsigned int _nacts;
-	const char *_keys;
-
 	if ( p == pe )
 		goto _test_eof;
-	if ( cs == 0 )
-		goto _out;
-_resume:
-	_keys = _css_trans_keys + _css_key_offsets[cs];
-	_trans = _css_index_offsets[cs];
-
-	_klen = _css_single_lengths[cs];
-	if ( _klen > 0 ) {
-		const char *_lower = _keys;
-		const char *_mid;
-		const char *_upper = _keys + _klen - 1;
-		while (1) {
-			if ( _upper < _lower )
-				break;
-
-			_mid = _lower + ((_upper-_lower) >> 1);
-			if ( (*p) < *_mid )
-				_upper = _mid - 1;
-			else if ( (*p) > *_mid )
-				_lower = _mid + 1;
-			else {
-				_trans += (unsigned int)(_mid - _keys);
-				goto _match;
-			}
-		}
-		_keys += _klen;
-		_trans += _klen;
+	switch ( cs )
+	{
+st12:
+	if ( ++p == pe )
+		goto _test_eof12;
+case 12:
+	if ( (*p) == 117 )
+		goto st2;
+	goto st1;
+st1:
+	if ( ++p == pe )
+		goto _test_eof1;
+case 1:
+	if ( (*p) == 117 )
+		goto st2;
+	goto st1;
+st2:
+	if ( ++p == pe )
+		goto _test_eof2;
+case 2:
+	switch( (*p) ) {
+		case 114: goto st3;
+		case 117: goto st2;
 	}
-
-	_klen = _css_range_lengths[cs];
-	if ( _klen > 0 ) {
-		const char *_lower = _keys;
-		const char *_mid;
-		const char *_upper = _keys + (_klen<<1) - 2;
-		while (1) {
-			if ( _upper < _lower )
-				break;
-
-			_mid = _lower + (((_upper-_lower) >> 1) & ~1);
-			if ( (*p) < _mid[0] )
-				_upper = _mid - 2;
-			else if ( (*p) > _mid[1] )
-				_lower = _mid + 2;
-			else {
-				_trans += (unsigned int)((_mid - _keys)>>1);
-				goto _match;
-			}
-		}
-		_trans += _klen;
+	goto st1;
+st3:
+	if ( ++p == pe )
+		goto _test_eof3;
+case 3:
+	switch( (*p) ) {
+		case 108: goto st4;
+		case 117: goto st2;
 	}
-
-_match:
-	_trans = _css_indicies[_trans];
-	cs = _css_trans_targs[_trans];
-
-	if ( _css_trans_actions[_trans] == 0 )
-		goto _again;
-
-	_acts = _css_actions + _css_trans_actions[_trans];
-	_nacts = (unsigned int) *_acts++;
-	while ( _nacts-- > 0 )
-	{
-		switch ( *_acts++ )
-		{
-	case 0:
-#line 4 "/home/ubuntu/projects/cdnalizer/src/parser/css.machine.rl"
+	goto st1;
+st4:
+	if ( ++p == pe )
+		goto _test_eof4;
+case 4:
+	switch( (*p) ) {
+		case 32: goto st4;
+		case 40: goto st5;
+	}
+	if ( 9 <= (*p) && (*p) <= 13 )
+		goto st4;
+	goto st0;
+st0:
+cs = 0;
+	goto _out;
+st5:
+	if ( ++p == pe )
+		goto _test_eof5;
+case 5:
+	switch( (*p) ) {
+		case 32: goto st5;
+		case 34: goto st8;
+		case 39: goto st10;
+		case 41: goto st0;
+	}
+	if ( 9 <= (*p) && (*p) <= 13 )
+		goto st5;
+	goto tr6;
+tr6:
 	{
       url_start = p;
     }
-	break;
-	case 1:
-#line 8 "/home/ubuntu/projects/cdnalizer/src/parser/css.machine.rl"
+	goto st6;
+st6:
+	if ( ++p == pe )
+		goto _test_eof6;
+case 6:
+	switch( (*p) ) {
+		case 32: goto tr10;
+		case 34: goto st0;
+		case 39: goto st0;
+		case 41: goto tr11;
+	}
+	if ( 9 <= (*p) && (*p) <= 13 )
+		goto tr10;
+	goto st6;
+tr10:
+	{
+      path_found(url_start, p);
+    }
+	goto st7;
+st7:
+	if ( ++p == pe )
+		goto _test_eof7;
+case 7:
+	switch( (*p) ) {
+		case 32: goto st7;
+		case 41: goto st12;
+	}
+	if ( 9 <= (*p) && (*p) <= 13 )
+		goto st7;
+	goto st0;
+tr11:
 	{
       path_found(url_start, p);
     }
-	break;
-#line 194 "/home/ubuntu/projects/cdnalizer/src/parser/css.hpp"
-		}
+	goto st12;
+st8:
+	if ( ++p == pe )
+		goto _test_eof8;
+case 8:
+	if ( (*p) == 34 )
+		goto st0;
+	goto tr13;
+tr13:
+	{
+      url_start = p;
+    }
+	goto st9;
+st9:
+	if ( ++p == pe )
+		goto _test_eof9;
+case 9:
+	if ( (*p) == 34 )
+		goto tr10;
+	goto st9;
+st10:
+	if ( ++p == pe )
+		goto _test_eof10;
+case 10:
+	if ( (*p) == 39 )
+		goto st0;
+	goto tr15;
+tr15:
+	{
+      url_start = p;
+    }
+	goto st11;
+st11:
+	if ( ++p == pe )
+		goto _test_eof11;
+case 11:
+	if ( (*p) == 39 )
+		goto tr10;
+	goto st11;
 	}
+	_test_eof12: cs = 12; goto _test_eof; 
+	_test_eof1: cs = 1; goto _test_eof; 
+	_test_eof2: cs = 2; goto _test_eof; 
+	_test_eof3: cs = 3; goto _test_eof; 
+	_test_eof4: cs = 4; goto _test_eof; 
+	_test_eof5: cs = 5; goto _test_eof; 
+	_test_eof6: cs = 6; goto _test_eof; 
+	_test_eof7: cs = 7; goto _test_eof; 
+	_test_eof8: cs = 8; goto _test_eof; 
+	_test_eof9: cs = 9; goto _test_eof; 
+	_test_eof10: cs = 10; goto _test_eof; 
+	_test_eof11: cs = 11; goto _test_eof; 
 
-_again:
-	if ( cs == 0 )
-		goto _out;
-	if ( ++p != pe )
-		goto _resume;
 	_test_eof: {}
 	_out: {}
 	}
 
-#line 37 "/home/ubuntu/projects/cdnalizer/src/parser/css.hpp.rl"
-
   return p;
 }
 
 
 } /* parser */ 
 } /* cdnalizer  */ 
+
+#pragma GCC diagnostic pop
@@ -1,5 +1,11 @@
 #pragma once
 
+// ragel's -G2 goto code falls from each state's case into the next one on
+// purpose. (-Wpragmas keeps compilers without -Wimplicit-fallthrough quiet.)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpragmas"
+#pragma GCC diagnostic ignored "-Wimplicit-fallthrough"
+
 namespace cdnalizer {
 namespace parser {
 
@@ -41,3 +47,5 @@ Iterator parseCSS(Iterator &p, const Iterator& pe,
 
 } /* parser */ 
 } /* cdnalizer  */ 
+
+#pragma GCC diagnostic pop
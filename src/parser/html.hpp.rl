@@ -1,5 +1,11 @@
 #pragma once
 
+// ragel's -G2 goto code falls from each state's case into the next one on
+// purpose. (-Wpragmas keeps compilers without -Wimplicit-fallthrough quiet.)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpragmas"
+#pragma GCC diagnostic ignored "-Wimplicit-fallthrough"
+
 #include <boost/range/iterator_range.hpp>
 
 namespace cdnalizer {
@@ -54,3 +60,4 @@ bool parseHTMLTag(
 } /* parser */ 
 } /* cdnalizer  */ 
 
+#pragma GCC diagnostic pop
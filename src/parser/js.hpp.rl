@@ -0,0 +1,53 @@
+#pragma once
+
+// ragel's -G2 goto code falls from each state's case into the next one on
+// purpose. (-Wpragmas keeps compilers without -Wimplicit-fallthrough quiet.)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpragmas"
+#pragma GCC diagnostic ignored "-Wimplicit-fallthrough"
+
+#include <functional>
+
+namespace cdnalizer {
+namespace parser {
+
+%%{ 
+  machine js;
+  include js "js.machine.rl";
+}%%
+
+// State machine exports
+%%write exports;
+
+// State machine data
+%%write data;
+
+/// Parses some java script, looking for string literals (and regexes)
+/// @param A reference to the pointer to the start of the data. This will be incremented as our search continues
+/// @param pe A const reference to the pointer to the end of the input
+/// @param onStringFound This function will be called every time a string is found,
+///        passing two iterators, the first letter inside the quotes, and the closing quote.
+/// p is a reference because when dealing with Apache bucket brigades, it can change, and we changed it also
+/// pe is a const reference because apache bucket brigade splitting may change it (but we don't change it).
+template <typename Iterator>
+Iterator parseJS(Iterator &p, const Iterator& pe,
+                 std::function<void(Iterator, Iterator)> onStringFound) {
+  int cs;
+
+  // Data needed for the actions
+  auto string_start = p;
+
+  // State machine initialization
+  %%write init;
+
+  // State machine code
+  %%write exec;
+
+  return p;
+}
+
+
+} /* parser */ 
+} /* cdnalizer  */ 
+
+#pragma GCC diagnostic pop
@@ -0,0 +1,359 @@
+/**
+ * © Copyright 2017 Matthew Sherborne. All Rights Reserved.
+ * License: Apache License, Version 2.0 (See LICENSE.txt)
+ **/
+#include "Tree.hpp"
+
+#include "../Parallel.hpp"
+#include "../WorkPool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+#include <climits>
+#include <cstdlib>
+
+#include <fcntl.h>
+#include <ftw.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace cdnalizer {
+namespace standalone {
+
+namespace {
+
+TreeError failed(const std::string &what, const std::string &filename) {
+  return TreeError(what + ' ' + filename + ": " + std::strerror(errno));
+}
+
+/// Closes a file descriptor when it goes out of scope
+struct FileCloser {
+  int fd;
+  ~FileCloser() {
+    if (fd >= 0)
+      close(fd);
+  }
+};
+
+/// A read only mmap() of a whole file
+struct Mapping {
+  const char *data = nullptr;
+  size_t size = 0;
+  Mapping(int fd, size_t size, const std::string &filename) : size(size) {
+    if (size == 0)
+      return;
+    void *memory = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (memory == MAP_FAILED)
+      throw failed("Can't map", filename);
+    madvise(memory, size, MADV_SEQUENTIAL);
+    data = static_cast<const char *>(memory);
+  }
+  ~Mapping() {
+    if (data)
+      munmap(const_cast<char *>(data), size);
+  }
+};
+
+/// mkdir -p
+void makeDirectories(const std::string &path) {
+  for (size_t slash = path.find('/', 1);; slash = path.find('/', slash + 1)) {
+    std::string part = path.substr(0, slash);
+    if ((mkdir(part.c_str(), 0755) != 0) && (errno != EEXIST))
+      throw failed("Can't make directory", part);
+    if (slash == std::string::npos)
+      return;
+  }
+}
+
+/// Writes @a filename in one go: a temporary file next to it, then rename()
+void writeFile(const std::string &filename, const char *data, size_t size,
+               mode_t mode) {
+  std::string temporary = filename + ".cdnalizer-XXXXXX";
+  int fd = mkstemp(&temporary[0]);
+  if (fd < 0)
+    throw failed("Can't write", temporary);
+  bool ok = true;
+  while (ok && (size != 0)) {
+    ssize_t wrote = write(fd, data, size);
+    if (wrote < 0) {
+      ok = errno == EINTR;
+      continue;
+    }
+    data += wrote;
+    size -= static_cast<size_t>(wrote);
+  }
+  ok = ok && (fchmod(fd, mode) == 0);
+  ok = (close(fd) == 0) && ok;
+  ok = ok && (std::rename(temporary.c_str(), filename.c_str()) == 0);
+  if (!ok) {
+    TreeError error = failed("Can't write", filename);
+    unlink(temporary.c_str());
+    throw error;
+  }
+}
+
+/// Filled in by nftw()
+struct Found {
+  std::string relative;
+  off_t size;
+};
+std::vector<Found> *found = nullptr;
+size_t rootLength = 0;
+
+int addFile(const char *path, const struct stat *info, int type,
+            struct FTW *) {
+  if (type == FTW_F)
+    found->push_back({path + rootLength, info->st_size});
+  return 0;
+}
+
+/// Fills in the defaults, and takes the trailing '/'s off the directories
+TreeOptions normalised(TreeOptions options) {
+  for (std::string *path : {&options.input, &options.output})
+    while ((path->size() > 1) && (path->back() == '/'))
+      path->pop_back();
+  if (options.prefix.empty() || (options.prefix.back() != '/'))
+    options.prefix.push_back('/');
+  if (options.stateFile.empty())
+    options.stateFile = options.output + "/.cdnalizer-state";
+  return options;
+}
+
+std::uint64_t hashOf(const Config &config, const TreeOptions &options) {
+  std::hash<std::string> hasher;
+  std::uint64_t hash = config.fingerprint();
+  // boost::hash_combine's mixing, like Config
+  hash ^= hasher(options.server_url) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+  hash ^= hasher(options.prefix) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+  return hash;
+}
+
+/// @returns the absolute path of the directory @a path, with a '/' on the end
+std::string realDirectory(const std::string &path) {
+  char buffer[PATH_MAX];
+  if (realpath(path.c_str(), buffer) == nullptr)
+    throw failed("Can't find", path);
+  std::string result(buffer);
+  if (result.back() != '/')
+    result.push_back('/');
+  return result;
+}
+}
+
+TreeState::TreeState(std::string filename) : filename(std::move(filename)) {
+  std::ifstream in(this->filename);
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.empty() || (line.front() == '#'))
+      continue;
+    std::istringstream words(line);
+    FileStamp stamp;
+    if (!(words >> stamp.mtime >> stamp.size >> stamp.config) ||
+        (words.get() != ' '))
+      continue;
+    std::string path;
+    if (std::getline(words, path) && !path.empty())
+      files[path] = stamp;
+  }
+}
+
+bool TreeState::unchanged(const std::string &path,
+                          const FileStamp &stamp) const {
+  std::lock_guard<std::mutex> guard(lock);
+  auto found = files.find(path);
+  return (found != files.end()) && (found->second == stamp);
+}
+
+void TreeState::record(const std::string &path, const FileStamp &stamp) {
+  std::lock_guard<std::mutex> guard(lock);
+  files[path] = stamp;
+}
+
+void TreeState::forget(const std::string &path) {
+  std::lock_guard<std::mutex> guard(lock);
+  files.erase(path);
+}
+
+std::vector<std::string>
+TreeState::under(const std::string &directory) const {
+  std::string prefix = directory + '/';
+  std::vector<std::string> result;
+  std::lock_guard<std::mutex> guard(lock);
+  for (const auto &file : files)
+    if (file.first.compare(0, prefix.size(), prefix) == 0)
+      result.push_back(file.first);
+  return result;
+}
+
+std::vector<std::string>
+TreeState::retain(const std::unordered_set<std::string> &keep) {
+  std::vector<std::string> dropped;
+  std::lock_guard<std::mutex> guard(lock);
+  for (auto i = files.begin(); i != files.end();) {
+    if (keep.count(i->first) == 0) {
+      dropped.push_back(i->first);
+      i = files.erase(i);
+    } else {
+      ++i;
+    }
+  }
+  return dropped;
+}
+
+void TreeState::save() const {
+  std::ostringstream out;
+  out << "# cdnalizer tree state: mtime size config path\n";
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    for (const auto &file : files)
+      out << file.second.mtime << ' ' << file.second.size << ' '
+          << file.second.config << ' ' << file.first << '\n';
+  }
+  std::string contents = out.str();
+  writeFile(filename, contents.data(), contents.size(), 0644);
+}
+
+Tree::Tree(const Config &config, TreeOptions options)
+    : config(config), options(normalised(std::move(options))),
+      configHash(hashOf(config, this->options)),
+      state(this->options.stateFile) {
+  makeDirectories(this->options.output);
+  std::string input = realDirectory(this->options.input);
+  std::string output = realDirectory(this->options.output);
+  // We'd find our own output as we walked the input
+  if (output.compare(0, input.size(), input) == 0)
+    throw TreeError("The output can't be the input, or inside it");
+}
+
+bool Tree::isRewritten(const std::string &relative) {
+  size_t dot = relative.rfind('.');
+  if ((dot == std::string::npos) || (relative.find('/', dot) != std::string::npos))
+    return false;
+  std::string extension = relative.substr(dot + 1);
+  std::transform(extension.begin(), extension.end(), extension.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+  return (extension == "html") || (extension == "htm") ||
+         (extension == "xhtml") || (extension == "shtml") ||
+         (extension == "css");
+}
+
+Tree::Outcome Tree::file(const std::string &relative, unsigned threads) {
+  std::string from = options.input + '/' + relative;
+  std::string to = options.output + '/' + relative;
+  FileCloser in{open(from.c_str(), O_RDONLY | O_CLOEXEC)};
+  if (in.fd < 0)
+    throw failed("Can't read", from);
+  struct stat info;
+  if (fstat(in.fd, &info) != 0)
+    throw failed("Can't stat", from);
+  FileStamp stamp{static_cast<std::int64_t>(info.st_mtim.tv_sec) * 1000000000 +
+                      info.st_mtim.tv_nsec,
+                  static_cast<std::int64_t>(info.st_size), configHash};
+  if (state.unchanged(relative, stamp) && (access(to.c_str(), F_OK) == 0))
+    return Outcome::skipped;
+
+  Mapping input(in.fd, static_cast<size_t>(info.st_size), from);
+  size_t slash = to.rfind('/');
+  makeDirectories(to.substr(0, slash));
+  if (!isRewritten(relative)) {
+    writeFile(to, input.data, input.size, info.st_mode & 07777);
+    state.record(relative, stamp);
+    return Outcome::copied;
+  }
+
+  // The page's own url directory, for its relative links
+  size_t dir = relative.rfind('/');
+  std::string location =
+      options.prefix +
+      (dir == std::string::npos ? std::string() : relative.substr(0, dir + 1));
+  bool isCSS = relative.size() > 4 &&
+               (strcasecmp(relative.c_str() + relative.size() - 4, ".css") == 0);
+  // Big pages are cut up and done on threads of their own
+  std::string result =
+      parallel::rewrite(options.server_url, location, config, input.data,
+                        input.size, isCSS, threads);
+  writeFile(to, result.data(), result.size(), info.st_mode & 07777);
+  state.record(relative, stamp);
+  return Outcome::rewritten;
+}
+
+void Tree::remove(const std::string &relative) {
+  std::string to = options.output + '/' + relative;
+  if ((unlink(to.c_str()) != 0) && (errno != ENOENT))
+    throw failed("Can't remove", to);
+  state.forget(relative);
+}
+
+Tree::Totals Tree::all(const volatile std::sig_atomic_t *stop) {
+  std::vector<Found> files;
+  found = &files;
+  rootLength = options.input.size() + 1;
+  if (nftw(options.input.c_str(), addFile, 64, FTW_PHYS) != 0)
+    throw failed("Can't read", options.input);
+  // Biggest last: they go on the back of the queues, which is where each
+  // worker takes from, and the small ones left at the front get stolen
+  std::sort(files.begin(), files.end(), [](const Found &a, const Found &b) {
+    return a.size < b.size;
+  });
+
+  // With fewer files than workers, the spare workers help with big ones.
+  // Otherwise the pool is busy enough, and splitting would only start more
+  // threads than cores.
+  unsigned split = 1;
+  if (!files.empty() && (files.size() < options.threads))
+    split = options.threads / static_cast<unsigned>(files.size());
+
+  // By Outcome
+  std::atomic<size_t> counts[3] = {};
+  std::atomic<size_t> failures{0};
+  std::mutex errorLock;
+  {
+    WorkPool pool(options.threads);
+    for (const Found &entry : files)
+      pool.submit([&, relative = entry.relative]() {
+        if (stop && *stop)
+          return;
+        try {
+          ++counts[static_cast<int>(file(relative, split))];
+        } catch (const std::exception &error) {
+          std::lock_guard<std::mutex> guard(errorLock);
+          std::cerr << error.what() << '\n';
+          ++failures;
+        }
+      });
+    pool.wait();
+  }
+
+  std::unordered_set<std::string> seen;
+  for (const Found &entry : files)
+    seen.insert(entry.relative);
+  // Whatever we've done that isn't in the input any more has been deleted
+  for (const std::string &relative : state.retain(seen)) {
+    try {
+      remove(relative);
+    } catch (const std::exception &error) {
+      std::cerr << error.what() << '\n';
+      ++failures;
+    }
+  }
+  state.save();
+  Totals totals;
+  totals.rewritten = counts[static_cast<int>(Outcome::rewritten)];
+  totals.copied = counts[static_cast<int>(Outcome::copied)];
+  totals.skipped = counts[static_cast<int>(Outcome::skipped)];
+  totals.failed = failures;
+  return totals;
+}
+}
+}
@@ -0,0 +1,145 @@
+#pragma once
+/** Rewrites a whole directory tree, eg. a static site export, into a copy
+ *
+ * HTML and CSS files are rewritten; everything else is copied as is. Files
+ * are spread over a WorkPool, biggest last so the stealing evens out the
+ * tail. Each one is mmap()ed and rewritten as one contiguous buffer, then
+ * written to a temporary file that's renamed into place, so a web server
+ * reading the copy never sees half a file. (The input has to hold still
+ * while we read it, though: a mapped file that shrinks kills us.)
+ *
+ * A state file remembers each input file's mtime and size, and a hash of the
+ * config, when we last wrote it. Files that match are skipped, so running it
+ * again after a deploy only redoes what changed.
+ *
+ * © Copyright 2017 Matthew Sherborne. All Rights Reserved.
+ * License: Apache License, Version 2.0 (See LICENSE.txt)
+ **/
+
+#include "../Config.hpp"
+
+#include <csignal>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace cdnalizer {
+namespace standalone {
+
+/// Thrown when a file can't be read or written
+class TreeError : public std::runtime_error {
+public:
+  using std::runtime_error::runtime_error;
+};
+
+/// Where to read and write, and how
+struct TreeOptions {
+  /// The tree to read
+  std::string input;
+  /// Where the rewritten copy goes; not inside input
+  std::string output;
+  /// Our own server, eg. 'http://www.supa.ws'; links to it are rewritten too
+  std::string server_url;
+  /// The url of the input directory
+  std::string prefix = "/";
+  /// Where we remember what we've done; "" for .cdnalizer-state in output
+  std::string stateFile;
+  unsigned threads = std::thread::hardware_concurrency();
+};
+
+/// What an input file looked like when we wrote its copy
+struct FileStamp {
+  std::int64_t mtime; // Nanoseconds
+  std::int64_t size;
+  std::uint64_t config; // Tree::hash()
+  bool operator==(const FileStamp &other) const {
+    return (mtime == other.mtime) && (size == other.size) &&
+           (config == other.config);
+  }
+};
+
+/// The state file: a FileStamp per path. Safe to share between threads.
+class TreeState {
+private:
+  std::string filename;
+  mutable std::mutex lock;
+  std::unordered_map<std::string, FileStamp> files;
+
+public:
+  /// Loads @a filename if it's there. Lines we can't read are dropped; the
+  /// worst that does is rewrite a file again.
+  explicit TreeState(std::string filename);
+  /// @returns true if we wrote @a path's copy from a file stamped @a stamp
+  bool unchanged(const std::string &path, const FileStamp &stamp) const;
+  void record(const std::string &path, const FileStamp &stamp);
+  void forget(const std::string &path);
+  /// @returns every path we have a stamp for under @a directory
+  std::vector<std::string> under(const std::string &directory) const;
+  /// Forgets every path not in @a keep
+  /// @returns the paths it forgot
+  std::vector<std::string> retain(const std::unordered_set<std::string> &keep);
+  /// Writes the file, through a temporary file and rename
+  /// @throws TreeError if it can't
+  void save() const;
+};
+
+class Tree {
+public:
+  /// What file() did
+  enum class Outcome { rewritten, copied, skipped };
+  /// What all() did
+  struct Totals {
+    size_t rewritten = 0;
+    size_t copied = 0;
+    size_t skipped = 0;
+    size_t failed = 0;
+  };
+
+private:
+  const Config &config;
+  const TreeOptions options;
+  const std::uint64_t configHash;
+  TreeState state;
+
+public:
+  /// @throws TreeError if the output is inside the input
+  Tree(const Config &config, TreeOptions options);
+
+  /** Rewrites or copies one file, if it's changed since we last did it.
+   * Safe to call from many threads at once.
+   *
+   * @param relative its path, relative to the input
+   * @param threads how many threads a big page or stylesheet can be split
+   *        over. Called from a pool, that's the workers it would otherwise
+   *        leave idle; it's 1 (not split) when they're all busy.
+   * @throws TreeError if it can't be read or written
+   */
+  Outcome file(const std::string &relative, unsigned threads = 1);
+  /// Deletes the copy of @a relative, which has gone from the input
+  /// @throws TreeError if it's there and we can't
+  void remove(const std::string &relative);
+  /// @returns every file under @a directory that we've done
+  std::vector<std::string> done(const std::string &directory) const {
+    return state.under(directory);
+  }
+  /// Does every file in the tree, deletes the copies of files that have gone,
+  /// then saves the state. Errors are written to std::cerr and counted.
+  /// @param stop if given, files not started once it's set are left for
+  ///        next time. Can be set by a signal handler.
+  Totals all(const volatile std::sig_atomic_t *stop = nullptr);
+  /// Writes the state file
+  void save() { state.save(); }
+
+  /// A hash of the config and options, so changing either redoes every file
+  std::uint64_t hash() const { return configHash; }
+  const TreeOptions &settings() const { return options; }
+  /// @returns true if @a relative is a file we rewrite, not just copy
+  static bool isRewritten(const std::string &relative);
+};
+}
+}
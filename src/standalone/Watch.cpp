@@ -0,0 +1,270 @@
+/**
+ * © Copyright 2017 Matthew Sherborne. All Rights Reserved.
+ * License: Apache License, Version 2.0 (See LICENSE.txt)
+ **/
+#include "Watch.hpp"
+
+#include "../WorkPool.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <unordered_set>
+
+#include <ftw.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace cdnalizer {
+namespace standalone {
+
+volatile std::sig_atomic_t Watch::stopping = 0;
+int Watch::wakeup = -1;
+
+namespace {
+
+/// What we want to hear about in each directory
+constexpr std::uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM |
+                               IN_DELETE | IN_CREATE | IN_ONLYDIR |
+                               IN_DONT_FOLLOW;
+
+TreeError failed(const std::string &what, const std::string &filename) {
+  return TreeError(what + ' ' + filename + ": " + std::strerror(errno));
+}
+
+/// Filled in by nftw(), for watchDirectory()
+int watching = -1;
+std::unordered_map<int, std::string> *watched = nullptr;
+std::vector<std::string> *foundFiles = nullptr;
+size_t rootLength = 0;
+
+int addWatch(const char *path, const struct stat *, int type, struct FTW *) {
+  const char *relative = (std::strlen(path) >= rootLength) ? path + rootLength : "";
+  if (type == FTW_D) {
+    int wd = inotify_add_watch(watching, path, mask);
+    if (wd < 0) {
+      if (errno == ENOSPC)
+        std::cerr << "Out of inotify watches; raise fs.inotify.max_user_watches\n";
+      return -1;
+    }
+    (*watched)[wd] = relative;
+  } else if ((type == FTW_F) && foundFiles) {
+    foundFiles->push_back(relative);
+  }
+  return 0;
+}
+}
+
+Watch::Watch(Tree &tree, std::chrono::milliseconds quiet)
+    : tree(tree), quiet(quiet) {
+  events = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (events < 0)
+    throw failed("Can't watch", tree.settings().input);
+  wakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (wakeup < 0) {
+    close(events);
+    throw failed("Can't make an eventfd for", tree.settings().input);
+  }
+  try {
+    watchDirectory("");
+  } catch (...) {
+    close(events);
+    close(wakeup);
+    wakeup = -1;
+    throw;
+  }
+}
+
+Watch::~Watch() {
+  int fd = wakeup;
+  wakeup = -1;
+  close(fd);
+  close(events);
+}
+
+void Watch::stop() {
+  stopping = 1;
+  // poll() may be about to sleep; this makes it return
+  if (wakeup >= 0) {
+    std::uint64_t one = 1;
+    ssize_t ignored = write(wakeup, &one, sizeof(one));
+    (void)ignored;
+  }
+}
+
+void Watch::watchDirectory(const std::string &relative,
+                           std::vector<std::string> *files) {
+  const std::string &input = tree.settings().input;
+  std::string path = relative.empty() ? input : input + '/' + relative;
+  watching = events;
+  watched = &directories;
+  foundFiles = files;
+  rootLength = input.size() + 1;
+  if (nftw(path.c_str(), addWatch, 64, FTW_PHYS) != 0)
+    throw failed("Can't watch", path);
+}
+
+void Watch::run() {
+  using clock = std::chrono::steady_clock;
+  const std::string &input = tree.settings().input;
+  /// When we last heard about each changed file
+  std::unordered_map<std::string, clock::time_point> pending;
+  /// Files in the pool; the main thread's to look after
+  std::unordered_set<std::string> busy;
+  /// Files the pool has finished with, and a way to wake us up for them
+  std::mutex doneLock;
+  std::vector<std::string> done;
+  bool rescan = false;
+  bool dirty = false;
+  alignas(inotify_event) char buffer[64 * 1024];
+  {
+    WorkPool pool(tree.settings().threads);
+    // Enough to keep every worker busy, without queueing a whole deploy
+    const size_t maxBusy = pool.size() * 2;
+    auto finish = [&]() {
+      std::lock_guard<std::mutex> guard(doneLock);
+      for (const std::string &path : done)
+        busy.erase(path);
+      done.clear();
+    };
+
+    while (!stopping) {
+      finish();
+      // Send off the files that have gone quiet
+      clock::time_point now = clock::now();
+      clock::duration wait = std::chrono::hours(1);
+      for (auto i = pending.begin(); i != pending.end();) {
+        clock::duration quietFor = now - i->second;
+        if (quietFor < quiet) {
+          wait = std::min(wait, quiet - quietFor);
+          ++i;
+          continue;
+        }
+        // We'll hear when one finishes
+        if ((busy.size() >= maxBusy) || (busy.count(i->first) != 0)) {
+          ++i;
+          continue;
+        }
+        std::string relative = i->first;
+        i = pending.erase(i);
+        busy.insert(relative);
+        dirty = true;
+        // The workers nobody else is using can help with a big file
+        unsigned split = static_cast<unsigned>(
+            std::max<size_t>(1, pool.size() / busy.size()));
+        pool.submit([&, relative, split]() {
+          try {
+            std::string from = input + '/' + relative;
+            if ((access(from.c_str(), F_OK) != 0) && (errno == ENOENT))
+              tree.remove(relative);
+            else
+              tree.file(relative, split);
+          } catch (const std::exception &error) {
+            std::lock_guard<std::mutex> guard(doneLock);
+            std::cerr << error.what() << '\n';
+          }
+          {
+            std::lock_guard<std::mutex> guard(doneLock);
+            done.push_back(relative);
+          }
+          std::uint64_t one = 1;
+          ssize_t ignored = write(wakeup, &one, sizeof(one));
+          (void)ignored;
+        });
+      }
+      if (rescan && busy.empty()) {
+        // Any file could have changed, and any directory moved
+        rescan = false;
+        directories.clear();
+        watchDirectory("");
+        Tree::Totals totals = tree.all(&stopping);
+        std::cerr << "Rescanned: " << totals.rewritten << " rewritten, "
+                  << totals.copied << " copied, " << totals.failed
+                  << " failed\n";
+        dirty = false;
+        continue;
+      }
+      if (dirty && busy.empty() && pending.empty()) {
+        try {
+          tree.save();
+        } catch (const std::exception &error) {
+          std::cerr << error.what() << '\n';
+        }
+        dirty = false;
+      }
+
+      pollfd fds[2] = {{events, POLLIN, 0}, {wakeup, POLLIN, 0}};
+      int timeout =
+          pending.empty()
+              ? -1
+              : static_cast<int>(
+                    std::chrono::duration_cast<std::chrono::milliseconds>(wait)
+                        .count()) + 1;
+      if (poll(fds, 2, timeout) < 0) {
+        if (errno == EINTR)
+          continue;
+        throw failed("Can't wait for changes to", input);
+      }
+      if (fds[1].revents & POLLIN) {
+        std::uint64_t count;
+        ssize_t ignored = read(wakeup, &count, sizeof(count));
+        (void)ignored;
+      }
+      if (!(fds[0].revents & POLLIN))
+        continue;
+      ssize_t got;
+      while ((got = read(events, buffer, sizeof(buffer))) > 0) {
+        now = clock::now();
+        for (char *at = buffer; at < buffer + got;) {
+          const inotify_event &event = *reinterpret_cast<inotify_event *>(at);
+          at += sizeof(inotify_event) + event.len;
+          if (event.mask & IN_Q_OVERFLOW) {
+            rescan = true;
+            continue;
+          }
+          auto directory = directories.find(event.wd);
+          if (event.mask & IN_IGNORED) {
+            if (directory != directories.end())
+              directories.erase(directory);
+            continue;
+          }
+          if ((directory == directories.end()) || (event.len == 0))
+            continue;
+          std::string relative = directory->second.empty()
+                                     ? std::string(event.name)
+                                     : directory->second + '/' + event.name;
+          if (event.mask & IN_ISDIR) {
+            // Its files may have been there before we watched it
+            if (event.mask & (IN_CREATE | IN_MOVED_TO)) {
+              std::vector<std::string> files;
+              watchDirectory(relative, &files);
+              for (const std::string &file : files)
+                pending[file] = now;
+            }
+            // Its copies have to go, and the watches under it now have the
+            // wrong paths
+            if (event.mask & IN_MOVED_FROM) {
+              for (const std::string &file : tree.done(relative))
+                pending[file] = now;
+              rescan = true;
+            }
+            continue;
+          }
+          // A new file is done with when it's closed
+          if (!(event.mask & IN_CREATE))
+            pending[relative] = now;
+        }
+      }
+    }
+    pool.wait();
+    finish();
+  }
+  tree.save();
+}
+}
+}
@@ -0,0 +1,63 @@
+#pragma once
+/** Keeps a Tree's copy up to date as its input changes
+ *
+ * Watches every directory under the input with inotify. Each file that's
+ * written, moved in or deleted goes on a pending list; a burst of events for
+ * one file (an editor's save, a deploy unpacking) becomes one entry, and it
+ * isn't touched until it has been quiet for a while. Then Tree::file() does
+ * it on a WorkPool, with only a few files in flight per worker, and never
+ * the same file twice at once. Deleted files lose their copy too.
+ *
+ * If the kernel's event queue overflows, or a directory is moved, we can't
+ * trust what we've been told, so we go over the whole tree again; the state
+ * file makes that cheap.
+ *
+ * © Copyright 2017 Matthew Sherborne. All Rights Reserved.
+ * License: Apache License, Version 2.0 (See LICENSE.txt)
+ **/
+
+#include "Tree.hpp"
+
+#include <chrono>
+#include <csignal>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace cdnalizer {
+namespace standalone {
+
+class Watch {
+private:
+  Tree &tree;
+  const std::chrono::milliseconds quiet;
+  int events = -1;
+  /// Directory (relative to the input; "" for the input) of each inotify
+  /// watch
+  std::unordered_map<int, std::string> directories;
+  /// Set by stop()
+  static volatile std::sig_atomic_t stopping;
+  /// An eventfd that wakes run() up: for stop(), and when a worker finishes
+  /// a file. Static so a signal handler can get at it.
+  static int wakeup;
+  /// Watches @a relative and every directory under it
+  /// @param files if given, every file in them is added to it
+  void watchDirectory(const std::string &relative,
+                      std::vector<std::string> *files = nullptr);
+
+public:
+  /// Starts watching the whole tree
+  /// @throws TreeError if inotify won't have it
+  Watch(Tree &tree, std::chrono::milliseconds quiet);
+  Watch(const Watch &) = delete;
+  Watch &operator=(const Watch &) = delete;
+  ~Watch();
+
+  /// Rewrites changed files until stop(), then saves the state
+  void run();
+  /// Makes run() finish what it's doing and return. Safe in a signal handler;
+  /// if it comes just before run() goes to sleep, run() still wakes up.
+  static void stop();
+};
+}
+}
@@ -2,24 +2,109 @@
  *
  * Ports html resource references to cdn urls.
  *
+ * Given a directory and -o, it rewrites the whole tree into a copy instead;
+ * see Tree.hpp. -w keeps it up to date after that; see Watch.hpp.
+ *
  * © Copyright 2014 Matthew Sherborne. All Rights Reserved.
  * License: Apache License, Version 2.0 (See LICENSE.txt)
  **/
 
+#include "../MappingFile.hpp"
 #include "../stream/stream.hpp"
+#include "Tree.hpp"
+#include "Watch.hpp"
 
 #include <iostream>
 #include <fstream>
 #include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <memory>
+
+#include <unistd.h>
+
+namespace {
+
+void usage(const char* name) {
+    std::cerr << "Usage: " << name << " [-m mappings] [-l location] [-c] < in > out\n"
+                 "       " << name << " -m mappings -o output [-j threads] [-u server_url] [-p url_prefix] [-t state_file]\n"
+                 "          [-w [-q quiet_ms]] input\n"
+                 "The first rewrites stdin (css with -c) to stdout. The second rewrites every html and css\n"
+                 "file under input into output, and copies the rest; files that haven't changed since\n"
+                 "the last run are skipped. With -w it then watches input and rewrites each file again once it\n"
+                 "has been left alone for quiet_ms (default 200), until SIGINT or SIGTERM. Either signal saves\n"
+                 "the state of the files done so far before it stops.\n"
+                 "mappings is a CDN_URL_FILE.\n";
+}
+
+volatile std::sig_atomic_t interrupted = 0;
+
+void stop(int) {
+    interrupted = 1;
+    cdnalizer::standalone::Watch::stop();
+}
+
+}
+
+int main(int argc, char** argv) {
+    using namespace cdnalizer;
+    std::string mappings;
+    std::string location = "/";
+    bool isCSS = false;
+    standalone::TreeOptions tree;
+    bool watch = false;
+    long quiet = 200;
+    int option;
+    while ((option = getopt(argc, argv, "m:l:co:j:u:p:t:wq:h")) != -1) {
+        switch (option) {
+        case 'm': mappings = optarg; break;
+        case 'l': location = optarg; break;
+        case 'c': isCSS = true; break;
+        case 'o': tree.output = optarg; break;
+        case 'j': tree.threads = static_cast<unsigned>(std::max(1, std::atoi(optarg))); break;
+        case 'u': tree.server_url = optarg; break;
+        case 'p': tree.prefix = optarg; break;
+        case 't': tree.stateFile = optarg; break;
+        case 'w': watch = true; break;
+        case 'q': quiet = std::max(0L, std::atol(optarg)); break;
+        default:
+            usage(argv[0]);
+            return option == 'h' ? 0 : 2;
+        }
+    }
+    bool batch = !tree.output.empty();
+    if ((batch && ((argc - optind != 1) || mappings.empty())) || (!batch && ((optind != argc) || watch))) {
+        usage(argv[0]);
+        return 2;
+    }
 
-int main(int, char**) {
-    cdnalizer::Config cfg{
-    {{"/images", "http://cdn.supa.ws/imgs"}}
-    };
-    // Because cin doesn't allow you to hold to or re-use iterators, we'll just copy the whole of stdin to a tmp file for now
-    //  TODO: Make a buffered, copyable, re-useable istream iterator
-    std::fstream f("data.tmp");
-    
-    cdnalizer::stream::rewriteHTML("", cfg, std::cin, std::cout, false);
-    std::cout.flush();
+    try {
+        cdnalizer::Config cfg = mappings.empty()
+            ? cdnalizer::Config{{{"/images", "http://cdn.supa.ws/imgs"}}}
+            : loadMappings(mappings, tree.prefix.c_str());
+        if (batch) {
+            tree.input = argv[optind];
+            standalone::Tree files(cfg, tree);
+            // Watch before the first pass, so we miss nothing that changes during it
+            std::unique_ptr<standalone::Watch> watcher;
+            if (watch)
+                watcher.reset(new standalone::Watch(files, std::chrono::milliseconds(quiet)));
+            // Before the first pass, so stopping part way through it still saves the state
+            std::signal(SIGINT, stop);
+            std::signal(SIGTERM, stop);
+            standalone::Tree::Totals totals = files.all(&interrupted);
+            std::cerr << totals.rewritten << " rewritten, " << totals.copied << " copied, "
+                      << totals.skipped << " unchanged, " << totals.failed << " failed\n";
+            if (!watcher)
+                return (totals.failed == 0) && !interrupted ? 0 : 1;
+            watcher->run();
+            return 0;
+        }
+        cdnalizer::stream::rewriteHTML(location, cfg, std::cin, std::cout, isCSS);
+        std::cout.flush();
+    } catch (const std::exception& error) {
+        std::cerr << error.what() << '\n';
+        return 1;
+    }
 }
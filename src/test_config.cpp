@@ -82,6 +82,89 @@ go_bandit([](){
             Config::CDNPair expected{"/x", "/y"};
             AssertThat(result, Equals(expected));
         });
+        it("4. entries can be referred to by index", [&] {
+            Config cfg{Container{map}};
+            AssertThat(cfg.size(), Equals(map.size()));
+            size_t i = cfg.indexOf("/aab");
+            AssertThat(i, Equals((size_t)1));
+            Config::CDNPair expected{"/aab", "http://cdn.supa.ws/aab"};
+            AssertThat(cfg.entry(i), Equals(expected));
+            AssertThat(cfg.indexOf("/nothing"), Equals(cfg.size()));
+            // Indexes must survive a copy
+            Config copy(cfg);
+            AssertThat(copy.entry(copy.indexOf("/images")).second,
+                       Equals("http://cdn.supa.ws/imgs"));
+        });
+        it("5. fingerprint changes with the content", [&] {
+            Config a{Container{map}};
+            Config b{Container{map}};
+            AssertThat(a.fingerprint(), Equals(b.fingerprint()));
+            b.addPath("/aad", "http://cdn.supa.ws/aad");
+            AssertThat(a.fingerprint(), !Equals(b.fingerprint()));
+        });
+        it("6. generation changes with every modification, but not copies", [&] {
+            Config a{Container{map}};
+            Config copy(a);
+            AssertThat(copy.generation(), Equals(a.generation()));
+            auto before = a.generation();
+            a.addPath("/aad", "http://cdn.supa.ws/aad");
+            AssertThat(a.generation(), !Equals(before));
+            AssertThat(a.generation(), !Equals(Config{}.generation()));
+        });
+        it("7. only finds keys that are a prefix of the path", [&] {
+            Config cfg{Container{map}};
+            cfg.addPath("/images/thumbs/small", "http://cdn.supa.ws/small");
+            // '/images2' sorts just before it, but isn't a prefix
+            Config::CDNPair expected{"/images", "http://cdn.supa.ws/imgs"};
+            AssertThat(cfg.findCDNUrl("/images/thumbs/big.gif"), Equals(expected));
+            AssertThat(cfg.findCDNUrl("/index.html").first, Equals(""));
+            AssertThat(cfg.findCDNUrl("/aad/x.gif").first, Equals(""));
+            AssertThat(cfg.findCDNUrl("/").first, Equals(""));
+        });
+        it("8. spreads paths over a key's hosts, moving few when one is added", [&] {
+            Config cfg{Container{map}};
+            cfg.addHost("/images", "http://cdn2.supa.ws/imgs");
+            size_t images = cfg.indexOf("/images");
+            AssertThat(cfg.hosts(images), Equals(2u));
+            AssertThat(cfg.hosts(cfg.indexOf("/aaa")), Equals(1u));
+            AssertThat(cfg.url(images, 1), Equals("http://cdn2.supa.ws/imgs"));
+            AssertThat(cfg.entry(images).second, Equals("http://cdn.supa.ws/imgs"));
+            Config three(cfg);
+            three.addHost("/images", "http://cdn3.supa.ws/imgs");
+            AssertThat(three.fingerprint(), !Equals(cfg.fingerprint()));
+            std::vector<int> counts(3);
+            int moved = 0;
+            for (int i = 0; i < 3000; ++i) {
+                std::string path = "/images/" + std::to_string(i) + ".gif";
+                size_t two = cfg.hostOf(images, path);
+                size_t now = three.hostOf(images, path);
+                // The query string doesn't change the host
+                AssertThat(three.hostOf(images, path + "?v=2"), Equals(now));
+                ++counts[now];
+                if (now != two) {
+                    AssertThat(now, Equals(2u));
+                    ++moved;
+                }
+            }
+            for (int count : counts)
+                AssertThat(count, IsGreaterThan(800));
+            AssertThat(moved, Equals(counts[2]));
+        });
+        it("9. lists the origins of its cdn urls, once each", [&] {
+            AssertThat(Config::originOf("https://cdn.supa.ws:8443/imgs?x"),
+                       Equals("https://cdn.supa.ws:8443"));
+            AssertThat(Config::originOf("//cdn.supa.ws/imgs"), Equals("//cdn.supa.ws"));
+            AssertThat(Config::originOf("/static/"), Equals(""));
+            AssertThat(Config::originOf("/go?to=http://x"), Equals(""));
+            AssertThat(Config::originOf("http://site$1.supa.ws/"), Equals(""));
+            Config cfg{Container{map}};
+            cfg.addHost("/images", "http://cdn2.supa.ws/imgs");
+            cfg.addPath("/local", "/static/local");
+            cfg.addPath("/sites/*/", "http://cdn3.supa.ws/$1/");
+            std::vector<std::string> expected{"http://cdn.supa.ws", "http://cdn2.supa.ws",
+                                              "http://cdn3.supa.ws"};
+            AssertThat(cfg.origins(), Equals(expected));
+        });
     });
 });
 
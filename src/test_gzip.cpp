@@ -0,0 +1,170 @@
+/**
+ * © Copyright 2017 Matthew Sherborne. All Rights Reserved.
+ * License: Apache License, Version 2.0 (See LICENSE.txt)
+ **/
+#include "Gzip.hpp"
+#include "Config.hpp"
+#include "Rewriter.hpp"
+#include "Rewriter_impl.hpp"
+
+#include <bandit/bandit.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace bandit;
+using namespace snowhouse;
+using namespace cdnalizer::gzip;
+
+go_bandit([]() {
+
+  std::string html;
+  for (int i = 0; i < 500; ++i)
+    html += R"(<p>Some text <img src="/images/a.gif" /> more text</p>)";
+
+  auto appendTo = [](std::string &out) {
+    return [&out](const char *data, size_t size) { out.append(data, size); };
+  };
+
+  // Compresses in one go
+  auto compress = [&](const std::string &in, Format format) {
+    std::string out;
+    Deflater deflater(format, 9);
+    deflater.feed(in.data(), in.size(), appendTo(out));
+    deflater.finish(appendTo(out));
+    return out;
+  };
+
+  // Decompresses feeding the inflater @a step bytes at a time
+  auto decompress = [&](const std::string &in, size_t step) {
+    std::string out;
+    Inflater inflater;
+    for (size_t i = 0; i < in.size(); i += step)
+      inflater.feed(in.data() + i, std::min(step, in.size() - i),
+                    appendTo(out));
+    AssertThat(inflater.done(), Is().EqualTo(true));
+    return out;
+  };
+
+  describe("gzip", [&]() {
+    it("1. round trips gzip, one byte at a time", [&]() {
+      std::string packed = compress(html, Format::gzip);
+      AssertThat(packed.size() < html.size(), Is().EqualTo(true));
+      AssertThat(decompress(packed, 1), Equals(html));
+    });
+    it("2. round trips the zlib format", [&]() {
+      std::string packed = compress(html, Format::deflate);
+      AssertThat(decompress(packed, 100), Equals(html));
+    });
+    it("3. reads raw deflate data", [&]() {
+      // Raw deflate is what you get when you take the zlib header and
+      // checksum off
+      std::string packed = compress(html, Format::deflate);
+      std::string raw(packed.begin() + 2, packed.end() - 4);
+      AssertThat(decompress(raw, 7), Equals(html));
+    });
+    it("4. sync flushes give decompressible output mid stream", [&]() {
+      std::string packed;
+      Deflater deflater(Format::gzip);
+      deflater.feed(html.data(), 100, appendTo(packed));
+      deflater.flush(appendTo(packed));
+      std::string unpacked;
+      Inflater inflater;
+      inflater.feed(packed.data(), packed.size(), appendTo(unpacked));
+      AssertThat(unpacked, Equals(html.substr(0, 100)));
+      AssertThat(inflater.done(), Is().EqualTo(false));
+    });
+    it("5. rewrites chunk by chunk between an inflater and a deflater", [&]() {
+      using Iterator = const char *;
+      cdnalizer::Config cfg{{{"/images", "http://cdn.supa.ws/imgs"}}};
+      std::string packed = compress(html, Format::gzip);
+      std::string repacked;
+      Deflater deflater(Format::gzip);
+      cdnalizer::RangeEvent<Iterator> unchanged = [&](Iterator a,
+                                                      Iterator b) {
+        deflater.feed(a, b - a, appendTo(repacked));
+        return b;
+      };
+      cdnalizer::DataEvent newData = [&](std::string data) {
+        deflater.feed(data.data(), data.size(), appendTo(repacked));
+      };
+      // Chunks won't end mid tag here, because each paragraph is 53 bytes
+      // and the inflater hands us 8000 byte chunks at most
+      std::string leftover;
+      Inflater inflater;
+      inflater.feed(packed.data(), packed.size(),
+                    [&](const char *data, size_t size) {
+                      leftover.append(data, size);
+                      size_t whole = leftover.rfind("</p>") + 4;
+                      cdnalizer::rewriteHTML("/", cfg, leftover.data(),
+                                             leftover.data() + whole,
+                                             unchanged, newData, false);
+                      leftover.erase(0, whole);
+                    });
+      deflater.finish(appendTo(repacked));
+      std::string expected;
+      for (int i = 0; i < 500; ++i)
+        expected +=
+            R"(<p>Some text <img src="http://cdn.supa.ws/imgs/a.gif" /> more text</p>)";
+      AssertThat(decompress(repacked, 4096), Equals(expected));
+    });
+    it("6. unpacks a highly compressible tail fed in one chunk", [&]() {
+      // A few input bytes here unpack to more than one output chunk
+      std::string big = html + std::string(1024 * 1024, ' ') + "</html>";
+      std::string packed = compress(big, Format::gzip);
+      AssertThat(packed.size(), IsLessThan(chunkSize));
+      // One byte at a time never fills an output chunk, so this is how much
+      // each prefix of the input unpacks to
+      std::vector<size_t> expected;
+      std::string unpacked;
+      Inflater slow;
+      for (size_t i = 0; i < packed.size(); ++i) {
+        slow.feed(packed.data() + i, 1, appendTo(unpacked));
+        expected.push_back(unpacked.size());
+      }
+      AssertThat(unpacked == big, Is().EqualTo(true));
+      // Wherever the body gets cut off, one feed() gives all of it
+      size_t cutShort = 0;
+      for (size_t cut = 1; cut <= packed.size(); ++cut) {
+        std::string body;
+        Inflater inflater;
+        inflater.feed(packed.data(), cut, appendTo(body));
+        cutShort += body.size() != expected[cut - 1];
+      }
+      AssertThat(cutShort, Equals(0u));
+      // ... and finish() has nothing left over
+      std::string body;
+      Inflater truncated;
+      truncated.feed(packed.data(), packed.size() - 8, appendTo(body));
+      truncated.finish(appendTo(body));
+      AssertThat(body == big, Is().EqualTo(true));
+    });
+
+    it("7. unpacks a bounded amount at a time, however well it packed", [&]() {
+      std::string big = html + std::string(4 * 1024 * 1024, ' ') + "</html>";
+      std::string packed = compress(big, Format::gzip);
+      const size_t most = 65536;
+      std::string unpacked;
+      Inflater inflater;
+      size_t used = 0;
+      size_t calls = 0;
+      size_t biggest = 0;
+      while (used < packed.size()) {
+        size_t before = unpacked.size();
+        used += inflater.feed(packed.data() + used, packed.size() - used, most,
+                              appendTo(unpacked));
+        biggest = std::max(biggest, unpacked.size() - before);
+        ++calls;
+      }
+      inflater.finish(appendTo(unpacked));
+      AssertThat(unpacked == big, Is().EqualTo(true));
+      // It never runs more than one output chunk past the limit
+      AssertThat(biggest, IsLessThan(most + chunkSize + 1));
+      AssertThat(calls, IsGreaterThan(big.size() / (most + chunkSize)));
+    });
+  });
+
+});
+
+int main(int argc, char **argv) { return bandit::run(argc, argv); }
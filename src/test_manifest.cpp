@@ -0,0 +1,242 @@
+/**
+ * © Copyright 2017 Matthew Sherborne. All Rights Reserved.
+ * License: Apache License, Version 2.0 (See LICENSE.txt)
+ **/
+#include "ManifestFile.hpp"
+#include "Rewriter_impl.hpp"
+#include "Search.hpp"
+
+#include <bandit/bandit.h>
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace bandit;
+using namespace snowhouse;
+using namespace cdnalizer;
+
+go_bandit([]() {
+
+  describe("Manifest", []() {
+    it("1. Knows exactly which paths it holds", []() {
+      Manifest manifest({"/images/a.gif", "/css/site.css", "/images/a.gif"});
+      AssertThat(manifest.size(), Equals(2u));
+      AssertThat(manifest.contains("/images/a.gif"), Equals(true));
+      AssertThat(manifest.contains("/css/site.css"), Equals(true));
+      AssertThat(manifest.contains("/images/a.gi"), Equals(false));
+      AssertThat(manifest.contains("/images/a.gif2"), Equals(false));
+      AssertThat(manifest.contains("/images/"), Equals(false));
+      AssertThat(Manifest().contains("/images/a.gif"), Equals(false));
+    });
+    it("2. Ignores query strings and fragments", []() {
+      Manifest manifest({"/css/site.css"});
+      AssertThat(manifest.contains("/css/site.css?v=2"), Equals(true));
+      AssertThat(manifest.contains("/css/site.css#x"), Equals(true));
+      AssertThat(manifest.contains("/css/site.cs?s"), Equals(false));
+    });
+    it("3. Holds many paths", []() {
+      std::vector<Manifest::Entry> list;
+      for (int i = 0; i < 10000; ++i)
+        list.push_back("/files/" + std::to_string(i) + ".js");
+      Manifest manifest(list);
+      AssertThat(manifest.size(), Equals(10000u));
+      int found = 0;
+      for (int i = 0; i < 20000; ++i)
+        found += manifest.contains("/files/" + std::to_string(i) + ".js");
+      AssertThat(found, Equals(10000));
+    });
+    it("4. Only lets a config rewrite uploaded paths", []() {
+      Config config{{{"/images", "http://cdn.supa.ws/imgs"}}};
+      auto before = config.fingerprint();
+      config.setManifest(std::make_shared<const Manifest>(
+          std::vector<Manifest::Entry>{"/images/a.gif"}));
+      AssertThat(config.fingerprint(), !Equals(before));
+      std::string output;
+      std::string input(R"**(<img src="/images/a.gif"><img src="/images/b.gif">)**");
+      using iterator = std::string::const_iterator;
+      rewriteHTML<iterator>(
+          "", "/", config, input.cbegin(), input.cend(),
+          [&](iterator start, iterator end) {
+            output.append(start, end);
+            return end;
+          },
+          [&](std::string data) { output.append(data); }, false);
+      AssertThat(output, Equals(R"**(<img src="http://cdn.supa.ws/imgs/a.gif"><img src="/images/b.gif">)**"));
+    });
+  });
+
+  describe("ManifestFile", []() {
+    std::string filename;
+
+    auto write = [&](const std::string &contents) {
+      // Like a sync tool: write a new file, then rename it into place
+      std::string temporary = filename + ".new";
+      {
+        std::ofstream out(temporary, std::ios::trunc);
+        out << contents;
+      }
+      std::rename(temporary.c_str(), filename.c_str());
+    };
+
+    before_each([&]() {
+      char name[] = "/tmp/cdnalizer_manifestXXXXXX";
+      int fd = mkstemp(name);
+      close(fd);
+      filename = name;
+      write("# Uploaded\n"
+            "/images/a.gif\n"
+            "\n"
+            "  css/site.css  \n");
+    });
+
+    after_each([&]() { std::remove(filename.c_str()); });
+
+    it("5. Loads paths, relative to the base, and their versions", [&]() {
+      write("/images/a.gif 3f9a1c\n"
+            "css/site.css\n");
+      Manifest manifest = loadManifest(filename, "/site");
+      AssertThat(manifest.size(), Equals(2u));
+      AssertThat(manifest.contains("/images/a.gif"), Equals(true));
+      AssertThat(manifest.contains("/site/css/site.css"), Equals(true));
+      AssertThat(manifest.version("/images/a.gif?x"), Equals("3f9a1c"));
+      AssertThat(manifest.version("/site/css/site.css"), Equals(""));
+      AssertThat(manifest.version("/images/b.gif"), Equals(""));
+      write("/images/a.gif 3f9a1c extra\n");
+      bool threw = false;
+      try {
+        loadManifest(filename, "/");
+      } catch (const ManifestError &) {
+        threw = true;
+      }
+      AssertThat(threw, Equals(true));
+    });
+
+    it("6. Reloads a replaced file, and re-applies it to configs", [&]() {
+      ManifestFile manifest(filename, "/", std::chrono::seconds(0));
+      auto config = std::make_shared<const Config>(
+          Container{{"/images", "http://cdn.supa.ws/imgs"}});
+      auto applied = manifest.apply(config);
+      AssertThat(applied->isUploaded("/images/a.gif"), Equals(true));
+      AssertThat(applied->isUploaded("/images/b.gif"), Equals(false));
+      AssertThat(manifest.apply(config) == applied, Equals(true));
+      write("/images/b.gif\n");
+      std::string error;
+      AssertThat(manifest.refresh(error) == ManifestFile::Reload::reloaded,
+                 Equals(true));
+      auto reapplied = manifest.apply(config);
+      AssertThat(reapplied == applied, Equals(false));
+      AssertThat(reapplied->isUploaded("/images/b.gif"), Equals(true));
+      AssertThat(applied->isUploaded("/images/b.gif"), Equals(false));
+    });
+
+    it("7. Keeps the last good manifest when the file is gone", [&]() {
+      ManifestFile manifest(filename, "/", std::chrono::seconds(0));
+      std::remove(filename.c_str());
+      std::string error;
+      AssertThat(manifest.refresh(error) == ManifestFile::Reload::failed,
+                 Equals(true));
+      AssertThat(error.empty(), Equals(false));
+      AssertThat(manifest.get()->contains("/images/a.gif"), Equals(true));
+    });
+
+    it("8. Keeps an applied config for each directory sharing it", [&]() {
+      ManifestFile manifest(filename, "/", std::chrono::seconds(0));
+      auto images = std::make_shared<const Config>(
+          Container{{"/images", "http://cdn.supa.ws/imgs"}});
+      auto css = std::make_shared<const Config>(
+          Container{{"/css", "http://cdn.supa.ws/css"}});
+      auto forImages = manifest.apply(images);
+      auto forCSS = manifest.apply(css);
+      auto versioned = manifest.apply(images, Versioning::query);
+      AssertThat(forCSS == forImages, Equals(false));
+      AssertThat(versioned == forImages, Equals(false));
+      // Taking turns, they're all still there
+      AssertThat(manifest.apply(images) == forImages, Equals(true));
+      AssertThat(manifest.apply(css) == forCSS, Equals(true));
+      AssertThat(manifest.apply(images, Versioning::query) == versioned,
+                 Equals(true));
+      AssertThat(manifest.apply(images) == forImages, Equals(true));
+      // However many directories there are
+      std::vector<std::shared_ptr<const Config>> configs, made;
+      for (int i = 0; i < 100; ++i) {
+        configs.push_back(std::make_shared<const Config>(Container{
+            {"/images", "http://cdn" + std::to_string(i) + ".supa.ws/imgs"}}));
+        made.push_back(manifest.apply(configs.back()));
+      }
+      for (int i = 0; i < 100; ++i)
+        AssertThat(manifest.apply(configs[i]) == made[i], Equals(true));
+    });
+
+    it("9. Matches paths by their percent encoding", [&]() {
+      AssertThat(Manifest::encode("/a b/%7e%2f100%.png", 19),
+                 Equals("/a%20b/~%2F100%25.png"));
+      AssertThat(Manifest::encode("/100%25.png", 11, true),
+                 Equals("/100%2525.png"));
+      Manifest manifest({{"/images/a b.gif", "v1"}, "/images/c%20d.gif",
+                         "/images/e%2Cf.gif"});
+      AssertThat(manifest.contains("/images/a%20b.gif"), Equals(true));
+      AssertThat(manifest.contains("/images/a b.gif"), Equals(true));
+      AssertThat(manifest.version("/images/a%20b.gif?x=1"), Equals("v1"));
+      AssertThat(manifest.contains("/images/c d.gif"), Equals(true));
+      AssertThat(manifest.contains("/images/%63%20d.gif"), Equals(true));
+      AssertThat(manifest.contains("/images/e%2cf.gif"), Equals(true));
+      AssertThat(manifest.contains("/images/e,f.gif"), Equals(false));
+      // What cdnalizer-manifest writes for a file called "g h.gif"
+      write("/images/g%20h.gif 77\n");
+      Manifest loaded = loadManifest(filename, "/");
+      AssertThat(loaded.version("/images/g h.gif"), Equals("77"));
+    });
+  });
+
+  describe("Versioning", []() {
+    Config config{{{"/images", "http://cdn.supa.ws/imgs/"}}};
+    config.setManifest(std::make_shared<const Manifest>(
+        std::vector<Manifest::Entry>{{"/images/a.gif", "3f9a1c"},
+                                     {"/images/b", "77"},
+                                     "/images/c.gif"}));
+    using iterator = std::string::const_iterator;
+    std::string output;
+    auto rewrite = [&](const std::string &input, Engine engine) {
+      output.clear();
+      RangeEvent<iterator> unchanged = [&](iterator start, iterator end) {
+        output.append(start, end);
+        return end;
+      };
+      DataEvent newData = [&](std::string data) { output.append(data); };
+      if (engine == Engine::search)
+        searchAndRewrite<iterator>("http://supa.ws", "/", config,
+                                   input.cbegin(), input.cend(), unchanged,
+                                   newData);
+      else
+        rewriteHTML<iterator>("http://supa.ws", "/", config, input.cbegin(),
+                              input.cend(), unchanged, newData, false);
+      return output;
+    };
+    const std::string input(
+        R"**(<img src="/images/a.gif"><img src="http://supa.ws/images/a.gif?x=1#top"><a href="/images/b"><img src="/images/c.gif">)**");
+
+    it("10. Puts versions in the query string", [&]() {
+      config.setVersioning(Versioning::query);
+      std::string expected(
+          R"**(<img src="http://cdn.supa.ws/imgs/a.gif?v=3f9a1c"><img src="http://cdn.supa.ws/imgs/a.gif?x=1&v=3f9a1c#top"><a href="http://cdn.supa.ws/imgs/b?v=77"><img src="http://cdn.supa.ws/imgs/c.gif">)**");
+      AssertThat(rewrite(input, Engine::parser), Equals(expected));
+      // The second time comes from the memo table
+      AssertThat(rewrite(input, Engine::parser), Equals(expected));
+      AssertThat(rewrite(input, Engine::search), Equals(expected));
+    });
+    it("11. Puts versions in the file name", [&]() {
+      config.setVersioning(Versioning::name);
+      std::string expected(
+          R"**(<img src="http://cdn.supa.ws/imgs/a.3f9a1c.gif"><img src="http://cdn.supa.ws/imgs/a.3f9a1c.gif?x=1#top"><a href="http://cdn.supa.ws/imgs/b.77"><img src="http://cdn.supa.ws/imgs/c.gif">)**");
+      AssertThat(rewrite(input, Engine::parser), Equals(expected));
+      AssertThat(rewrite(input, Engine::search), Equals(expected));
+    });
+  });
+
+});
+
+int main(int argc, char **argv) { return bandit::run(argc, argv); }
@@ -0,0 +1,167 @@
+/**
+ * © Copyright 2017 Matthew Sherborne. All Rights Reserved.
+ * License: Apache License, Version 2.0 (See LICENSE.txt)
+ **/
+#include "MappingFile.hpp"
+#include "Published.hpp"
+
+#include <bandit/bandit.h>
+
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace bandit;
+using namespace snowhouse;
+using namespace cdnalizer;
+
+go_bandit([]() {
+
+  describe("Published", []() {
+    it("1. Old snapshots live on after a new one is published", []() {
+      Published<std::string> published(std::make_shared<std::string>("one"));
+      auto before = published.get();
+      published.publish(std::make_shared<std::string>("two"));
+      AssertThat(*before, Equals("one"));
+      AssertThat(*published.get(), Equals("two"));
+    });
+    it("2. Readers always see a whole object while a writer publishes", []() {
+      using Numbers = std::vector<int>;
+      Published<Numbers> published(std::make_shared<Numbers>(100, 0));
+      std::atomic<bool> stop{false};
+      std::atomic<int> torn{0};
+      std::vector<std::thread> readers;
+      for (int i = 0; i < 4; ++i)
+        readers.emplace_back([&]() {
+          while (!stop) {
+            auto numbers = published.get();
+            for (int n : *numbers)
+              if (n != numbers->front())
+                ++torn;
+          }
+        });
+      for (int i = 1; i <= 200; ++i)
+        published.publish(std::make_shared<Numbers>(100, i));
+      stop = true;
+      for (auto &reader : readers)
+        reader.join();
+      AssertThat(torn.load(), Equals(0));
+      AssertThat(published.get()->front(), Equals(200));
+    });
+  });
+
+  describe("MappingFile", []() {
+    std::string filename;
+
+    auto write = [&](const std::string &contents) {
+      std::ofstream out(filename, std::ios::trunc);
+      out << contents;
+    };
+
+    before_each([&]() {
+      char name[] = "/tmp/cdnalizer_mappingsXXXXXX";
+      int fd = mkstemp(name);
+      close(fd);
+      filename = name;
+      write("# Comment\n"
+            "/images  http://cdn.supa.ws/imgs\n"
+            "\n"
+            "css      http://cdn.supa.ws/css\n");
+    });
+
+    after_each([&]() { std::remove(filename.c_str()); });
+
+    it("3. Loads paths and urls, relative to the base", [&]() {
+      Config config = loadMappings(filename, "/site");
+      AssertThat(config.size(), Equals(2u));
+      AssertThat(config.findCDNUrl("/images/a.gif").second,
+                 Equals("http://cdn.supa.ws/imgs"));
+      AssertThat(config.findCDNUrl("/site/css/a.css").second,
+                 Equals("http://cdn.supa.ws/css"));
+    });
+
+    it("4. Reloads a changed file; old snapshots stay the same", [&]() {
+      MappingFile mappings(filename, "/", std::chrono::seconds(0));
+      auto before = mappings.get();
+      std::string error;
+      AssertThat(mappings.refresh(error) == MappingFile::Reload::none,
+                 Equals(true));
+      write("/images  http://backup.supa.ws/imgs\n");
+      AssertThat(mappings.refresh(error) == MappingFile::Reload::reloaded,
+                 Equals(true));
+      auto after = mappings.get();
+      AssertThat(after->findCDNUrl("/images/a.gif").second,
+                 Equals("http://backup.supa.ws/imgs"));
+      AssertThat(before->findCDNUrl("/images/a.gif").second,
+                 Equals("http://cdn.supa.ws/imgs"));
+      AssertThat(after->generation() != before->generation(), Equals(true));
+    });
+
+    it("5. Keeps the last good mappings when the file is broken", [&]() {
+      MappingFile mappings(filename, "/", std::chrono::seconds(0));
+      write("/images\n");
+      std::string error;
+      AssertThat(mappings.refresh(error) == MappingFile::Reload::failed,
+                 Equals(true));
+      AssertThat(error.empty(), Equals(false));
+      AssertThat(mappings.get()->findCDNUrl("/images/a.gif").second,
+                 Equals("http://cdn.supa.ws/imgs"));
+    });
+
+    it("6. Doesn't look at the file again until the interval is up", [&]() {
+      MappingFile mappings(filename, "/", std::chrono::hours(1));
+      write("/images  http://backup.supa.ws/imgs\n");
+      std::string error;
+      AssertThat(mappings.refresh(error) == MappingFile::Reload::none,
+                 Equals(true));
+      AssertThat(mappings.get()->findCDNUrl("/images/a.gif").second,
+                 Equals("http://cdn.supa.ws/imgs"));
+    });
+
+    it("7. Uses the path rules of each directory that inherits it", [&]() {
+      MappingFile mappings(filename, "/", std::chrono::seconds(0));
+      // The file is set in the parent; the child only adds a rule
+      PathClassifier parent;
+      PathClassifier child;
+      child.setExtension("php", true);
+      PathClassifier merged = parent;
+      merged += child;
+      auto forParent = mappings.apply(parent);
+      auto forChild = mappings.apply(merged);
+      AssertThat(forParent->isStatic("/images/a.php"), Equals(false));
+      AssertThat(forChild->isStatic("/images/a.php"), Equals(true));
+      AssertThat(forChild->findCDNUrl("/images/a.php").second,
+                 Equals("http://cdn.supa.ws/imgs"));
+      // Taking turns, they're both still there
+      AssertThat(mappings.apply(parent) == forParent, Equals(true));
+      AssertThat(mappings.apply(merged) == forChild, Equals(true));
+      // However many directories there are
+      std::vector<PathClassifier> rules(100);
+      std::vector<MappingFile::Snapshot> made;
+      for (size_t i = 0; i < rules.size(); ++i) {
+        rules[i].setExtension("x" + std::to_string(i), true);
+        made.push_back(mappings.apply(rules[i]));
+      }
+      for (size_t i = 0; i < rules.size(); ++i)
+        AssertThat(mappings.apply(rules[i]) == made[i], Equals(true));
+      // A reload re-applies the rules to the new mappings
+      write("/images  http://backup.supa.ws/imgs\n");
+      std::string error;
+      AssertThat(mappings.refresh(error) == MappingFile::Reload::reloaded,
+                 Equals(true));
+      auto reloaded = mappings.apply(merged);
+      AssertThat(reloaded == forChild, Equals(false));
+      AssertThat(reloaded->isStatic("/images/a.php"), Equals(true));
+      AssertThat(reloaded->findCDNUrl("/images/a.php").second,
+                 Equals("http://backup.supa.ws/imgs"));
+    });
+  });
+
+});
+
+int main(int argc, char **argv) { return bandit::run(argc, argv); }
@@ -0,0 +1,172 @@
+/**
+ * © Copyright 2017 Matthew Sherborne. All Rights Reserved.
+ * License: Apache License, Version 2.0 (See LICENSE.txt)
+ **/
+#include "Parallel.hpp"
+#include "Rewriter_impl.hpp"
+
+#include <bandit/bandit.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace bandit;
+using namespace snowhouse;
+using namespace cdnalizer;
+
+namespace {
+
+/// What the one pass engine makes of @a input
+std::string sequential(const Config &config, const std::string &input,
+                       bool isCSS) {
+  std::string output;
+  using iterator = const char *;
+  const char *end = input.data() + input.size();
+  iterator done = rewriteHTML<iterator>(
+      "http://supa.ws", "/blog/", config, input.data(), end,
+      [&](iterator from, iterator to) {
+        output.append(from, to);
+        return to;
+      },
+      [&](std::string data) { output.append(data); }, isCSS);
+  output.append(done, end);
+  return output;
+}
+
+/// A document made of @a count random @a parts
+std::string jumble(const std::vector<std::string> &parts, size_t count,
+                   unsigned seed) {
+  std::mt19937 random(seed);
+  std::uniform_int_distribution<size_t> pick(0, parts.size() - 1);
+  std::string result;
+  for (size_t i = 0; i < count; ++i)
+    result += parts[pick(random)];
+  return result;
+}
+}
+
+go_bandit([]() {
+
+  Config config{{{"/images", "http://cdn.supa.ws/imgs"},
+                 {"/blog/css", "http://cdn.supa.ws/css"}}};
+
+  const std::vector<std::string> html{
+      "<img src=\"/images/a.gif\">",
+      "<a href='/images/b.png' title=\"x > <y\">",
+      "<div style=\"background: url(/images/c.gif)\">",
+      "<script>var s = \"<img src='/images/no.gif'>\";</script>",
+      "<SCRIPT type=\"x\">if (a<b) {}</sCrIpT>",
+      "<!-- <img src=\"/images/comment.gif\"> -->",
+      "<!-- a - b <link href=\"css/x.css\"> -->",
+      "text < more text",
+      "<p title=\"never closed ",
+      "\">",
+      "<a href=/images/bare.gif>",
+      "<link rel=stylesheet href=\"css/site.css\">",
+      "<br/>",
+      "</div>\n",
+      "\n",
+  };
+
+  const std::vector<std::string> css{
+      "a{background:url(/images/x.gif)}\n",
+      "b{background:url( '/images/y.png' )}",
+      "url(\"/images/z)q.png\")",
+      "urls",
+      "url(",
+      "url('')",
+      "c{d:e}",
+      "uurl(/images/u.gif)",
+      "/* url(/images/comment.gif) */",
+      "content:\"url(/images/q.gif)\";",
+      "url(/images/a b)",
+      "url(css/i.png)",
+      " ",
+      "\n",
+  };
+
+  describe("Parallel rewriting", [&]() {
+    it("1. Only cuts html at a '<' outside of scripts", [&]() {
+      std::string page;
+      for (int i = 0; i < 50; ++i)
+        page += "<p><img src=\"/images/a.gif\"></p>\n";
+      page += "<script>";
+      for (int i = 0; i < 50; ++i)
+        page += "document.write('<img src=\"/images/b.gif\">');\n";
+      page += "</script><p>end</p>";
+      auto points = parallel::splitPoints(page.data(), page.size(), false, 200);
+      AssertThat(points.size(), IsGreaterThan(5u));
+      AssertThat(points.front(), Equals(0u));
+      size_t scriptStart = page.find("<script>");
+      size_t scriptEnd = page.find("</script>") + 9;
+      for (size_t i = 1; i < points.size(); ++i) {
+        AssertThat(points[i], IsGreaterThan(points[i - 1]));
+        AssertThat(page[points[i]], Equals('<'));
+        AssertThat(points[i] <= scriptStart || points[i] > scriptEnd,
+                   Equals(true));
+      }
+    });
+
+    it("2. Only cuts css outside of url()", [&]() {
+      std::string sheet;
+      for (int i = 0; i < 100; ++i)
+        sheet += ".a" + std::to_string(i) +
+                 "{background:url( \"/images/long/path/to/a/picture.gif\" )}\n";
+      auto points = parallel::splitPoints(sheet.data(), sheet.size(), true, 100);
+      AssertThat(points.size(), IsGreaterThan(10u));
+      for (size_t cut : points) {
+        size_t open = sheet.rfind("url(", cut);
+        size_t close = sheet.rfind(')', cut == 0 ? 0 : cut - 1);
+        AssertThat(open == std::string::npos ||
+                       (close != std::string::npos && close > open),
+                   Equals(true));
+      }
+    });
+
+    it("3. Leaves small documents in one piece", [&]() {
+      std::string page = jumble(html, 20, 1);
+      AssertThat(parallel::splitPoints(page.data(), page.size(), false,
+                                       page.size()),
+                 HasLength(1));
+      AssertThat(parallel::rewrite("http://supa.ws", "/blog/", config,
+                                   page.data(), page.size(), false, 4),
+                 Equals(sequential(config, page, false)));
+    });
+
+    it("4. Makes the same html as one pass", [&]() {
+      for (unsigned seed = 0; seed < 100; ++seed) {
+        std::string page = jumble(html, 400, seed);
+        std::string result =
+            parallel::rewrite("http://supa.ws", "/blog/", config, page.data(),
+                              page.size(), false, 4, 512);
+        AssertThat(result, Equals(sequential(config, page, false)));
+      }
+    });
+
+    it("5. Makes the same css as one pass", [&]() {
+      for (unsigned seed = 0; seed < 100; ++seed) {
+        std::string sheet = jumble(css, 400, seed);
+        std::string result =
+            parallel::rewrite("http://supa.ws", "/blog/", config, sheet.data(),
+                              sheet.size(), true, 4, 512);
+        AssertThat(result, Equals(sequential(config, sheet, true)));
+      }
+    });
+
+    it("6. Makes the same big page as one pass", [&]() {
+      std::string page = jumble(html, 80000, 42);
+      AssertThat(page.size(), IsGreaterThan(parallel::defaultThreshold));
+      AssertThat(parallel::splitPoints(page.data(), page.size(), false,
+                                       page.size() / 16)
+                     .size(),
+                 IsGreaterThan(8u));
+      std::string result = parallel::rewrite(
+          "http://supa.ws", "/blog/", config, page.data(), page.size(), false, 4);
+      AssertThat(result, Equals(sequential(config, page, false)));
+    });
+  });
+
+});
+
+int main(int argc, char **argv) { return bandit::run(argc, argv); }
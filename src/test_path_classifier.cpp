@@ -0,0 +1,85 @@
+/**
+ * © Copyright 2017 Matthew Sherborne. All Rights Reserved.
+ * License: Apache License, Version 2.0 (See LICENSE.txt)
+ **/
+#include "PathClassifier.hpp"
+
+#include <bandit/bandit.h>
+
+using namespace bandit;
+using namespace snowhouse;
+using cdnalizer::PathClassifier;
+
+go_bandit([]() {
+
+  describe("PathClassifier", []() {
+    PathClassifier paths;
+
+    before_each([&]() { paths = PathClassifier(); });
+
+    it("1. By default only .php, .pl and .py are dynamic", [&]() {
+      AssertThat(paths.isStatic("/images/a.gif"), Equals(true));
+      AssertThat(paths.isStatic("/index.php"), Equals(false));
+      AssertThat(paths.isStatic("/cgi/run.pl"), Equals(false));
+      AssertThat(paths.isStatic("/app.py?x=1"), Equals(false));
+      AssertThat(paths.isStatic("/INDEX.PHP"), Equals(false));
+      AssertThat(paths.isStatic("/blog/my-post"), Equals(true));
+      AssertThat(paths.isStatic("/images/"), Equals(true));
+      AssertThat(paths.isStatic("/a.php.gif"), Equals(true));
+      AssertThat(paths.isStatic("/v1.php/a"), Equals(true));
+    });
+    it("2. Only looks at the path before the first '?' or '#'", [&]() {
+      AssertThat(paths.isStatic("/a.jpg?x=.php"), Equals(true));
+      AssertThat(paths.isStatic("/a.jpg?x=1&y=/b.php"), Equals(true));
+      AssertThat(paths.isStatic("/a.php?x=1?y=2"), Equals(false));
+      AssertThat(paths.isStatic("/a?x=/b.php"), Equals(true));
+      AssertThat(paths.isStatic("/a.php#top"), Equals(false));
+      AssertThat(paths.isStatic("/a.jpg#b.php"), Equals(true));
+    });
+    it("3. Extensions can be added, overridden, and have dots", [&]() {
+      paths.setExtension(".aspx", false);
+      paths.setExtension("cgi", false);
+      paths.setExtension("php", true);
+      paths.setExtension("css.php", false);
+      AssertThat(paths.isStatic("/default.aspx"), Equals(false));
+      AssertThat(paths.isStatic("/run.CGI"), Equals(false));
+      AssertThat(paths.isStatic("/image.php"), Equals(true));
+      AssertThat(paths.isStatic("/style.css.php"), Equals(false));
+      AssertThat(paths.isStatic("/x.ph"), Equals(true));
+    });
+    it("4. Extensionless paths can be dynamic", [&]() {
+      paths.setExtensionless(false);
+      AssertThat(paths.isStatic("/blog/my-post"), Equals(false));
+      AssertThat(paths.isStatic("/v1.2/route"), Equals(false));
+      AssertThat(paths.isStatic("/images/"), Equals(false));
+      AssertThat(paths.isStatic("/images/a.gif"), Equals(true));
+    });
+    it("5. Query strings can make a url dynamic, except static params", [&]() {
+      paths.setQueryDynamic(true);
+      paths.addStaticParam("ver");
+      paths.addStaticParam("v");
+      AssertThat(paths.isStatic("/style.css"), Equals(true));
+      AssertThat(paths.isStatic("/style.css?"), Equals(true));
+      AssertThat(paths.isStatic("/style.css?ver=4.7"), Equals(true));
+      AssertThat(paths.isStatic("/style.css?v=1&ver=2"), Equals(true));
+      AssertThat(paths.isStatic("/style.css?ver=1&user=2"), Equals(false));
+      AssertThat(paths.isStatic("/style.css?version=1"), Equals(false));
+      AssertThat(paths.isStatic("/style.css?1234"), Equals(false));
+      AssertThat(paths.isStatic("/style.css?ver=1#x?y=2"), Equals(true));
+    });
+    it("6. Merging keeps our rules unless the other one sets them", [&]() {
+      PathClassifier child;
+      child.setExtension("aspx", false);
+      paths.setExtension("php", true);
+      paths.setExtensionless(false);
+      paths += child;
+      AssertThat(paths.isStatic("/a.php"), Equals(true));
+      AssertThat(paths.isStatic("/a.aspx"), Equals(false));
+      AssertThat(paths.isStatic("/route"), Equals(false));
+      AssertThat(paths.hash(), !Equals(PathClassifier().hash()));
+    });
+  });
+
+});
+
+int main(int argc, char **argv) { return bandit::run(argc, argv); }
@@ -398,6 +398,38 @@ go_bandit([]() {
                            newData, false);
     AssertThat(whatWeGot, Equals(expected));
     });
+
+  it("11. Hands back the '<' of a tag cut at the end, wherever it's cut", [&]() {
+    const std::string data(
+        R"--(<p>text <img alt=">" src="/images/good.jpg" /> and
+             <A boolean style="background-image: url('/images/happy.jpg'); filter: url('/images/filter.css');" check_something_else>link</a>
+             <img src = '/images/a.jpg'><br/>)--");
+    const std::string expected(
+        R"--(<p>text <img alt=">" src="http://cdn.supa.ws/imgs/good.jpg" /> and
+             <A boolean style="background-image: url('http://cdn.supa.ws/imgs/happy.jpg'); filter: url('http://cdn.supa.ws/imgs/filter.css');" check_something_else>link</a>
+             <img src = 'http://cdn.supa.ws/imgs/a.jpg'><br/>)--");
+    for (size_t cut = 0; cut <= data.size(); ++cut) {
+      std::string whatWeGot;
+      RangeEvent<Iterator> unchanged = [&](auto start, auto end) {
+        std::copy(start, end, std::back_inserter(whatWeGot));
+        return end;
+      };
+      DataEvent newData = [&](std::string data) { whatWeGot.append(data); };
+      bool unfinished = false;
+      Iterator carried = cdnalizer::rewriteHTML(
+          location, cfg, data.begin(), data.begin() + cut, unchanged, newData,
+          false, {}, [&]() { unfinished = true; });
+      if (carried != data.begin() + cut) {
+        AssertThat(unfinished, IsTrue());
+        AssertThat(*carried, Equals('<'));
+      }
+      // The next slice starts with what we carried
+      Iterator done = cdnalizer::rewriteHTML(location, cfg, carried, data.end(),
+                                             unchanged, newData, false);
+      whatWeGot.append(done, data.end());
+      AssertThat(whatWeGot, Equals(expected));
+    }
+  });
 });
 
 int main(int argc, char **argv) { return bandit::run(argc, argv); }
@@ -11,6 +11,7 @@
 #include <ostream>
 #include <sstream>
 #include <string>
+#include <vector>
 
 #include <bandit/bandit.h>
 
@@ -69,6 +70,80 @@ go_bandit([]() {
           output,
           Is().EqualTo(R"**(<img src="http://cdn.supa.ws/imgs/a.gif">)**"));
     });
+    it("4. Reports the key and cut length of each splice", [&]() {
+      std::vector<std::pair<std::string, size_t>> splices;
+      SpliceEvent onSplice = [&](const std::string &key, size_t,
+                                 size_t cut) {
+        splices.emplace_back(key, cut);
+      };
+      std::string input(R"**(<a href="https://supa.ws/images/a.gif"><img src="/images/b.gif">)**");
+      cdnalizer::rewriteHTML(server, location, cfg, input.cbegin(),
+                             input.cend(), unchanged, newData, false, onSplice);
+      AssertThat(
+          output,
+          Is().EqualTo(R"**(<a href="http://cdn.supa.ws/imgs/a.gif"><img src="http://cdn.supa.ws/imgs/b.gif">)**"));
+      AssertThat(splices, HasLength(2));
+      // 'https://supa.ws/images'
+      AssertThat(splices.at(0).first, Equals("/images"));
+      AssertThat(splices.at(0).second, Equals((size_t)22));
+      // '/images'
+      AssertThat(splices.at(1).second, Equals((size_t)7));
+    });
+    it("5. Skips scripts, whatever the case of their end tag", [&]() {
+      std::string input(R"**(<script>x = '<img src="/images/a.gif">'</SCRIPT><ScRiPt>y</sCrIpT><img src="/images/b.gif">)**");
+      doRewrite(input);
+      AssertThat(
+          output,
+          Is().EqualTo(R"**(<script>x = '<img src="/images/a.gif">'</SCRIPT><ScRiPt>y</sCrIpT><img src="http://cdn.supa.ws/imgs/b.gif">)**"));
+    });
+    it("6. Remembers repeated urls, but not across configs", [&]() {
+      memo::local().clear();
+      auto before = stats::collect();
+      std::string input(R"**(<img src="/images/a.gif"><img src="/images/a.gif"><a href="/other"><a href="/other">)**");
+      doRewrite(input);
+      auto after = stats::collect();
+      std::string expected(R"**(<img src="http://cdn.supa.ws/imgs/a.gif"><img src="http://cdn.supa.ws/imgs/a.gif"><a href="/other"><a href="/other">)**");
+      AssertThat(output, Equals(expected));
+      AssertThat(after[stats::Counter::memoHits] - before[stats::Counter::memoHits], Equals(2u));
+      AssertThat(after[stats::Counter::memoMisses] - before[stats::Counter::memoMisses], Equals(2u));
+      // Same url, different mapping
+      cdnalizer::Config other{{{"/images", "http://cdn2.supa.ws/"}}};
+      output.clear();
+      cdnalizer::rewriteHTML(server, location, other, input.cbegin(),
+                             input.cend(), unchanged, newData, false);
+      AssertThat(output, Equals(R"**(<img src="http://cdn2.supa.ws/a.gif"><img src="http://cdn2.supa.ws/a.gif"><a href="/other"><a href="/other">)**"));
+    });
+    it("7. Sends each path to the same one of a key's hosts", [&]() {
+      cdnalizer::Config sharded{{{"/images", "http://a.supa.ws/"}}};
+      sharded.addHost("/images", "http://b.supa.ws/");
+      std::string input;
+      for (int i = 0; i < 20; ++i)
+        input += "<img src=\"/images/" + std::to_string(i) + ".gif\">";
+      std::vector<size_t> hosts;
+      SpliceEvent onSplice = [&](const std::string &, size_t host, size_t) {
+        hosts.push_back(host);
+      };
+      output.clear();
+      cdnalizer::rewriteHTML(server, location, sharded, input.cbegin(),
+                             input.cend(), unchanged, newData, false, onSplice);
+      std::string first = output;
+      // Again, from the memo table this time
+      output.clear();
+      cdnalizer::rewriteHTML(server, location, sharded, input.cbegin(),
+                             input.cend(), unchanged, newData, false, onSplice);
+      AssertThat(output, Equals(first));
+      AssertThat(hosts, HasLength(40));
+      size_t onB = 0;
+      for (size_t i = 0; i < 20; ++i) {
+        AssertThat(hosts[i + 20], Equals(hosts[i]));
+        std::string url = std::string(hosts[i] ? "http://b" : "http://a") +
+                          ".supa.ws/" + std::to_string(i) + ".gif";
+        AssertThat(first.find(url) != std::string::npos, Equals(true));
+        onB += hosts[i];
+      }
+      AssertThat(onB, IsGreaterThan(0u));
+      AssertThat(onB, IsLessThan(20u));
+    });
   });
 
 });
@@ -0,0 +1,108 @@
+/**
+ * © Copyright 2017 Matthew Sherborne. All Rights Reserved.
+ * License: Apache License, Version 2.0 (See LICENSE.txt)
+ **/
+#include "Search.hpp"
+
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <bandit/bandit.h>
+
+using namespace cdnalizer;
+using namespace bandit;
+using namespace snowhouse;
+
+go_bandit([]() {
+
+  std::string output;
+
+  using iterator = std::string::const_iterator;
+
+  cdnalizer::Config cfg{{{"/images", "http://cdn.supa.ws/imgs"},
+                         {"/images/big", "http://big.supa.ws/"},
+                         {"/blog/css", "http://cdn.supa.ws/css"}}};
+  std::string server = "https://supa.ws";
+  std::string location = "/blog/";
+
+  RangeEvent<iterator> unchanged = [&](iterator start, iterator end) {
+    std::copy(start, end, std::back_inserter(output));
+    return end;
+  };
+
+  DataEvent newData = [&](std::string data) { output.append(data); };
+
+  auto doRewrite = [&](const std::string &input) {
+    return searchAndRewrite(server, location, cfg, input.cbegin(),
+                            input.cend(), unchanged, newData);
+  };
+
+  before_each([&]() { output.clear(); });
+
+  describe("searchAndRewrite", [&]() {
+    it("1. Rewrites quoted paths and server urls", [&]() {
+      std::string input(R"**(<img src="/images/a.gif"><a href='https://supa.ws/images/b.png'>)**");
+      auto result = doRewrite(input);
+      AssertThat(result == input.cend(), Equals(true));
+      AssertThat(output, Equals(R"**(<img src="http://cdn.supa.ws/imgs/a.gif"><a href='http://cdn.supa.ws/imgs/b.png'>)**"));
+    });
+    it("2. Rewrites css urls, and paths relative to the location", [&]() {
+      std::string input("a { background: url( /images/a.gif ) } b { x: url(css/b.css) }");
+      doRewrite(input);
+      AssertThat(output, Equals("a { background: url( http://cdn.supa.ws/imgs/a.gif ) } b { x: url(http://cdn.supa.ws/css/b.css) }"));
+    });
+    it("3. Uses the longest key, and avoids '//'", [&]() {
+      std::string input(R"**(<img src="/images/big/a.gif">)**");
+      doRewrite(input);
+      AssertThat(output, Equals(R"**(<img src="http://big.supa.ws/a.gif">)**"));
+    });
+    it("4. Leaves alone dynamic paths, text with spaces and non matches", [&]() {
+      std::string input(R"**(<a href="/images/x.php">"/images of cats" '/imagination.gif' <a href="/index.html">)**");
+      doRewrite(input);
+      AssertThat(output, Equals(input));
+    });
+    it("5. Returns the start of a candidate cut off by the end", [&]() {
+      std::string input(R"**(<img src="/images/a.gif"><img src="/images/b)**");
+      auto result = doRewrite(input);
+      AssertThat(std::string(result, input.cend()), Equals(R"**("/images/b)**"));
+      AssertThat(output, Equals(R"**(<img src="http://cdn.supa.ws/imgs/a.gif"><img src=)**"));
+      input = R"**(<img src=")**";
+      output.clear();
+      result = doRewrite(input);
+      AssertThat(std::string(result, input.cend()), Equals("\""));
+    });
+    it("6. Reports the key and cut of each splice", [&]() {
+      std::vector<std::pair<std::string, size_t>> splices;
+      SpliceEvent onSplice = [&](const std::string &key, size_t,
+                                 size_t cut) {
+        splices.emplace_back(key, cut);
+      };
+      std::string input(R"**(<a href="https://supa.ws/images/a.gif"><img src="/images/big/b.gif">)**");
+      searchAndRewrite(server, location, cfg, input.cbegin(), input.cend(),
+                       unchanged, newData, onSplice);
+      AssertThat(splices.size(), Equals(2u));
+      AssertThat(splices[0].first, Equals("/images"));
+      AssertThat(splices[0].second, Equals(22u));
+      AssertThat(splices[1].first, Equals("/images/big"));
+      AssertThat(splices[1].second, Equals(12u));
+    });
+    it("7. Finds quotes and brackets at any offset in a word", [&]() {
+      for (size_t at = 0; at != 40; ++at) {
+        for (char c : std::string("\"'(")) {
+          std::string input(40, ')');
+          input[at] = c;
+          const char *found =
+              search::findContext(input.data(), input.data() + input.size());
+          AssertThat(found - input.data(), Equals(static_cast<long>(at)));
+        }
+      }
+      std::string none(40, 'x');
+      AssertThat(search::findContext(none.data(), none.data() + 40) ==
+                     none.data() + 40,
+                 Equals(true));
+    });
+  });
+});
+
+int main(int argc, char *argv[]) { return bandit::run(argc, argv); }
@@ -0,0 +1,56 @@
+/**
+ * © Copyright 2017 Matthew Sherborne. All Rights Reserved.
+ * License: Apache License, Version 2.0 (See LICENSE.txt)
+ **/
+#include "Stats.hpp"
+#include "Config.hpp"
+#include "Rewriter.hpp"
+#include "Rewriter_impl.hpp"
+
+#include <bandit/bandit.h>
+
+#include <string>
+#include <thread>
+
+using namespace bandit;
+using namespace snowhouse;
+using namespace cdnalizer;
+using stats::Counter;
+
+go_bandit([]() {
+
+  describe("stats", []() {
+    it("1. Adds up the counters of every thread, even finished ones", []() {
+      auto before = stats::collect()[Counter::bucketSplits];
+      std::thread other([]() { stats::add(Counter::bucketSplits, 5); });
+      other.join();
+      stats::add(Counter::bucketSplits, 2);
+      AssertThat(stats::collect()[Counter::bucketSplits] - before, Equals(7u));
+    });
+    it("2. Counts what the rewriter does", []() {
+      Config config{{{"/images", "http://cdn.supa.ws/imgs"}}};
+      std::string html = R"(<img src="/images/a.gif" /><a href="/images/index.php">)"
+                         R"(<img src="/css/b.gif">)";
+      using Iterator = std::string::const_iterator;
+      RangeEvent<Iterator> unchanged = [](Iterator, Iterator b) { return b; };
+      DataEvent newData = [](std::string) {};
+      auto before = stats::collect();
+      rewriteHTML("/", config, html.cbegin(), html.cend(), unchanged, newData,
+                  false);
+      auto after = stats::collect();
+      auto delta = [&](Counter counter) {
+        return after[counter] - before[counter];
+      };
+      AssertThat(delta(Counter::tagsParsed), Equals(3u));
+      AssertThat(delta(Counter::attributesTested), Equals(3u));
+      AssertThat(delta(Counter::dynamicPaths), Equals(1u));
+      AssertThat(delta(Counter::lookups), Equals(3u));
+      AssertThat(delta(Counter::hits), Equals(1u));
+      AssertThat(after.hits["/images"] - before.hits["/images"], Equals(1u));
+      AssertThat(delta(Counter::rewriteNanoseconds) > 0, Equals(true));
+    });
+  });
+
+});
+
+int main(int argc, char **argv) { return bandit::run(argc, argv); }
@@ -0,0 +1,99 @@
+/**
+ * © Copyright 2017 Matthew Sherborne. All Rights Reserved.
+ * License: Apache License, Version 2.0 (See LICENSE.txt)
+ **/
+#include "Rewriter_impl.hpp"
+#include "Wildcards.hpp"
+
+#include <bandit/bandit.h>
+
+#include <string>
+
+using namespace bandit;
+using namespace snowhouse;
+using namespace cdnalizer;
+
+go_bandit([]() {
+
+  describe("Wildcards", []() {
+    Container keys{
+        {"/wp-content/uploads/sites/*/", "http://site$1.cdn.supa.ws/uploads/"},
+        {"/static/**/img/", "http://cdn.supa.ws/$1/"},
+        {"/a*", "http://a.cdn.supa.ws/"},
+        {"/ab*", "http://ab.cdn.supa.ws/$1-"}};
+    std::string url;
+    size_t length;
+
+    it("1. Fills in what '*' matched", [&]() {
+      Wildcards patterns(keys);
+      const std::string *key = patterns.find(
+          "/wp-content/uploads/sites/12/logo.png", url, length);
+      AssertThat(key == nullptr, Equals(false));
+      AssertThat(*key, Equals("/wp-content/uploads/sites/*/"));
+      AssertThat(url, Equals("http://site12.cdn.supa.ws/uploads/"));
+      AssertThat(length, Equals(29u));
+      // '*' stays inside a segment
+      AssertThat(patterns.find("/wp-content/uploads/sites/12", url, length) ==
+                     nullptr,
+                 Equals(true));
+    });
+    it("2. Lets '**' cross segments", [&]() {
+      Wildcards patterns(keys);
+      AssertThat(*patterns.find("/static/js/v2/img/x.png", url, length),
+                 Equals("/static/**/img/"));
+      AssertThat(url, Equals("http://cdn.supa.ws/js/v2/"));
+      AssertThat(length, Equals(18u));
+      // Neither crosses into the query string
+      AssertThat(patterns.find("/static/?/img/", url, length) == nullptr,
+                 Equals(true));
+    });
+    it("3. Prefers the longest match, then the most plain chars", [&]() {
+      Wildcards patterns(keys);
+      AssertThat(*patterns.find("/abc", url, length), Equals("/ab*"));
+      AssertThat(url, Equals("http://ab.cdn.supa.ws/c-"));
+      AssertThat(*patterns.find("/a/x.png", url, length), Equals("/a*"));
+      AssertThat(length, Equals(2u));
+      AssertThat(patterns.find("/b", url, length) == nullptr, Equals(true));
+    });
+    it("4. Gives the same answers with or without the DFA", [&]() {
+      Wildcards fast(keys);
+      Wildcards slow(keys);
+      slow.tooBig = true;
+      for (const char *path :
+           {"/wp-content/uploads/sites/3/a.gif", "/static/a/b/img/c", "/abc",
+            "/a/", "/static/img/", "/nothing"}) {
+        std::string fastUrl, slowUrl;
+        size_t fastLength = 0, slowLength = 0;
+        const std::string *fastKey = fast.find(path, fastUrl, fastLength);
+        const std::string *slowKey = slow.find(path, slowUrl, slowLength);
+        AssertThat(fastKey == nullptr, Equals(slowKey == nullptr));
+        if (fastKey != nullptr)
+          AssertThat(*fastKey, Equals(*slowKey));
+        AssertThat(fastUrl, Equals(slowUrl));
+        AssertThat(fastLength, Equals(slowLength));
+      }
+    });
+    it("5. Rewrites html with plain and wildcard keys together", [&]() {
+      Config config{{{"/wp-content/uploads/", "http://cdn.supa.ws/uploads/"}}};
+      config.addPath("/wp-content/uploads/sites/*/",
+                     "http://site$1.cdn.supa.ws/uploads/");
+      AssertThat(config.hasPatterns(), Equals(true));
+      AssertThat(config.size(), Equals(1u));
+      std::string input(
+          R"**(<img src="/wp-content/uploads/a.png"><img src="/wp-content/uploads/sites/7/b.png"><img src="http://supa.ws/wp-content/uploads/sites/8/c.png">)**");
+      std::string output;
+      using iterator = std::string::const_iterator;
+      rewriteHTML<iterator>(
+          "http://supa.ws", "/", config, input.cbegin(), input.cend(),
+          [&](iterator start, iterator end) {
+            output.append(start, end);
+            return end;
+          },
+          [&](std::string data) { output.append(data); }, false);
+      AssertThat(output, Equals(R"**(<img src="http://cdn.supa.ws/uploads/a.png"><img src="http://site7.cdn.supa.ws/uploads/b.png"><img src="http://site8.cdn.supa.ws/uploads/c.png">)**"));
+    });
+  });
+
+});
+
+int main(int argc, char **argv) { return bandit::run(argc, argv); }
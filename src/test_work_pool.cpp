@@ -0,0 +1,71 @@
+/**
+ * © Copyright 2017 Matthew Sherborne. All Rights Reserved.
+ * License: Apache License, Version 2.0 (See LICENSE.txt)
+ **/
+#include "WorkPool.hpp"
+
+#include <bandit/bandit.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+
+using namespace bandit;
+using namespace snowhouse;
+using namespace cdnalizer;
+
+go_bandit([]() {
+
+  describe("WorkPool", []() {
+    it("1. Runs every task, including ones tasks submit", []() {
+      WorkPool pool(4);
+      std::atomic<int> done{0};
+      for (int i = 0; i < 100; ++i)
+        pool.submit([&]() {
+          ++done;
+          pool.submit([&]() { ++done; });
+        });
+      pool.wait();
+      AssertThat(done.load(), Equals(200));
+    });
+    it("2. Idle workers steal from a busy one's queue", []() {
+      WorkPool pool(4);
+      std::mutex lock;
+      std::set<std::thread::id> workers;
+      std::atomic<int> done{0};
+      // Everything lands on the first task's worker queue
+      pool.submit([&]() {
+        for (int i = 0; i < 40; ++i)
+          pool.submit([&]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            std::lock_guard<std::mutex> guard(lock);
+            workers.insert(std::this_thread::get_id());
+            ++done;
+          });
+      });
+      pool.wait();
+      AssertThat(done.load(), Equals(40));
+      AssertThat(workers.size() > 1, Equals(true));
+    });
+    it("3. Hands a task's exception to wait()", []() {
+      WorkPool pool(2);
+      pool.submit([]() { throw std::runtime_error("oops"); });
+      bool threw = false;
+      try {
+        pool.wait();
+      } catch (const std::runtime_error &) {
+        threw = true;
+      }
+      AssertThat(threw, Equals(true));
+      // And only once
+      pool.submit([]() {});
+      pool.wait();
+    });
+  });
+
+});
+
+int main(int argc, char **argv) { return bandit::run(argc, argv); }
@@ -3,32 +3,142 @@
  * © Copyright 2014 Matthew Sherborne. All Rights Reserved.
  * License: Apache License, Version 2.0 (See LICENSE.txt)
  **/
-#include <functional>
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <type_traits>
 
 namespace cdnalizer {
 namespace utils {
 
-/// Our safe std::equal test for use with forward input iterators, with no way of knowing length
-template <typename iter1, typename iter2,
-          typename value_type1=typename iter1::value_type, typename value_type2=typename iter2::value_type,
-          typename predicate=std::function<bool(value_type1, value_type2)>>
-bool equal(iter1 first1, iter1 last1, iter2 first2, iter2 last2, predicate pred) {
-    while ((first1 != last1) && (first2 != last2)) {
-        if (!pred(*first1++, *first2++))
-            return false;
-    }
-    return ((first1 == last1) && (first2 == last2));
+/// True for iterators over one contiguous array of chars, where we can use
+/// memchr and friends
+template <typename Iterator> struct is_contiguous : std::false_type {};
+template <> struct is_contiguous<const char *> : std::true_type {};
+template <> struct is_contiguous<char *> : std::true_type {};
+template <>
+struct is_contiguous<std::string::const_iterator> : std::true_type {};
+template <> struct is_contiguous<std::string::iterator> : std::true_type {};
+
+/// True when both ranges are contiguous chars, so we can compare them a
+/// word at a time
+template <typename iter1, typename iter2>
+using both_contiguous =
+    std::integral_constant<bool, is_contiguous<iter1>::value &&
+                                     is_contiguous<iter2>::value>;
+
+/// The default predicate for equal and mismatch. Being a plain type (not a
+/// std::function or a function pointer) lets the compiler inline it.
+struct same {
+  template <typename T1, typename T2>
+  constexpr bool operator()(const T1 &a, const T2 &b) const {
+    return a == b;
+  }
+};
+
+namespace detail {
+/// Picks the first overload that compiles
+template <int n> struct priority : priority<n - 1> {};
+template <> struct priority<0> {};
+
+template <typename Iterator>
+constexpr auto distance(const Iterator &first, const Iterator &last,
+                        priority<1>) -> decltype(last - first) {
+  return last - first;
+}
+template <typename Iterator>
+auto distance(const Iterator &first, const Iterator &last, priority<0>) {
+  return std::distance(first, last);
+}
+template <typename Iterator, typename Distance>
+constexpr auto advance(Iterator &i, Distance n, priority<1>)
+    -> decltype(void(i += n)) {
+  i += n;
+}
+template <typename Iterator, typename Distance>
+void advance(Iterator &i, Distance n, priority<0>) {
+  std::advance(i, n);
+}
+
+/// @returns how many chars @a a and @a b have in common at the start,
+/// looking at no more than @a n; compares 8 bytes at a time
+inline std::size_t commonPrefix(const char *a, const char *b, std::size_t n) {
+  std::size_t i = 0;
+  for (; i + sizeof(std::uint64_t) <= n; i += sizeof(std::uint64_t)) {
+    std::uint64_t x, y;
+    std::memcpy(&x, a + i, sizeof(x));
+    std::memcpy(&y, b + i, sizeof(y));
+    if (x != y)
+      break;
+  }
+  while ((i < n) && (a[i] == b[i]))
+    ++i;
+  return i;
+}
+
+template <typename iter1, typename iter2, typename predicate>
+constexpr std::pair<iter1, iter2> mismatch(iter1 first1, iter1 last1,
+                                           iter2 first2, iter2 last2,
+                                           predicate pred, std::false_type) {
+  while ((first1 != last1) && (first2 != last2) && pred(*first1, *first2)) {
+    ++first1;
+    ++first2;
+  }
+  return std::make_pair(first1, first2);
+}
+template <typename iter1, typename iter2>
+std::pair<iter1, iter2> mismatch(iter1 first1, iter1 last1, iter2 first2,
+                                 iter2 last2, same, std::true_type) {
+  std::size_t n = std::min<std::size_t>(last1 - first1, last2 - first2);
+  if (n == 0)
+    return std::make_pair(first1, first2);
+  std::size_t common = commonPrefix(&*first1, &*first2, n);
+  return std::make_pair(first1 + common, first2 + common);
+}
+/// Any other predicate has to look at each char
+template <typename iter1, typename iter2, typename predicate>
+constexpr std::pair<iter1, iter2> mismatch(iter1 first1, iter1 last1,
+                                           iter2 first2, iter2 last2,
+                                           predicate pred, std::true_type) {
+  return detail::mismatch(first1, last1, first2, last2, pred,
+                          std::false_type());
 }
 
-template <typename T1, typename T2>
-bool default_pred(T1 a, T2 b) { return a == b; }
+template <typename iter1, typename iter2, typename predicate>
+constexpr bool equal(iter1 first1, iter1 last1, iter2 first2, iter2 last2,
+                     predicate pred, std::false_type) {
+  while ((first1 != last1) && (first2 != last2)) {
+    if (!pred(*first1++, *first2++))
+      return false;
+  }
+  return ((first1 == last1) && (first2 == last2));
+}
+template <typename iter1, typename iter2>
+bool equal(iter1 first1, iter1 last1, iter2 first2, iter2 last2, same,
+           std::true_type) {
+  auto length = last1 - first1;
+  if (length != last2 - first2)
+    return false;
+  return (length == 0) || (std::memcmp(&*first1, &*first2, length) == 0);
+}
+template <typename iter1, typename iter2, typename predicate>
+constexpr bool equal(iter1 first1, iter1 last1, iter2 first2, iter2 last2,
+                     predicate pred, std::true_type) {
+  return (last1 - first1 == last2 - first2) &&
+         detail::equal(first1, last1, first2, last2, pred, std::false_type());
+}
+}
 
-template <typename iter1, typename iter2,
-          typename value_type1 = typename iter1::value_type,
-          typename value_type2 = typename iter2::value_type>
-bool equal(iter1 first1, iter1 last1, iter2 first2, iter2 last2) {
-  return utils::equal(first1, last1, first2, last2,
-                      &default_pred<value_type1, value_type2>);
+/// Our safe std::equal test for use with forward input iterators, with no
+/// way of knowing length. Two contiguous ranges are checked with memcmp.
+template <typename iter1, typename iter2, typename predicate = same>
+constexpr bool equal(iter1 first1, iter1 last1, iter2 first2, iter2 last2,
+                     predicate pred = predicate()) {
+  return detail::equal(first1, last1, first2, last2, pred,
+                       both_contiguous<iter1, iter2>());
 }
 
 /// @return a pair of iterators:
@@ -40,48 +150,110 @@ bool equal(iter1 first1, iter1 last1, iter2 first2, iter2 last2) {
 ///             (last1, first2 + distance(first1, last1)),
 /// If 2nd matches the start of 1nd, it'll return
 ///       (first1 + distance(first2, last2, last2),
-template <typename iter1, typename iter2>
-std::pair<iter1, iter2> mismatch(iter1 first1, iter1 last1, iter2 first2,
-                                 iter2 last2) {
-  while ((first1 != last1) && (first2 != last2) && (*first1 == *first2)) {
-    ++first1;
-    ++first2;
+/// Two contiguous ranges are compared a word at a time.
+template <typename iter1, typename iter2, typename predicate = same>
+constexpr std::pair<iter1, iter2> mismatch(iter1 first1, iter1 last1,
+                                           iter2 first2, iter2 last2,
+                                           predicate pred = predicate()) {
+  return detail::mismatch(first1, last1, first2, last2, pred,
+                          both_contiguous<iter1, iter2>());
+}
+
+namespace detail {
+template <typename Iterator>
+Iterator find(Iterator first, const Iterator &last, char c, std::true_type) {
+  if (first == last)
+    return last;
+  const char *start = &*first;
+  const void *found = std::memchr(start, c, last - first);
+  if (found == nullptr)
+    return last;
+  return first + (static_cast<const char *>(found) - start);
+}
+template <typename Iterator>
+Iterator find(Iterator first, const Iterator &last, char c, std::false_type) {
+  while ((first != last) && (*first != c))
+    ++first;
+  return first;
+}
+}
+
+/// @returns the first @a c in [first, last), or last. Contiguous iterators
+/// use memchr.
+template <typename Iterator>
+Iterator find(Iterator first, const Iterator &last, char c) {
+  return detail::find(first, last, c, is_contiguous<Iterator>());
+}
+
+/// @returns the first place in [first, last) that @a needle is, ignoring
+/// case, or last. @a needle must be lower case, and its first character is
+/// matched exactly, so make it a non letter (eg. '<').
+template <typename Iterator>
+Iterator searchCaseless(Iterator first, const Iterator &last,
+                        const std::string &needle) {
+  auto same = [](char a, char b) { return std::tolower(a) == b; };
+  if (needle.empty())
+    return first;
+  // Jump from one first character of needle to the next, and compare there;
+  // for contiguous data, the jumps are memchr
+  while ((first = utils::find(first, last, needle.front())) != last) {
+    auto match = first;
+    auto n = needle.cbegin();
+    while ((match != last) && (n != needle.cend()) && same(*match, *n)) {
+      ++match;
+      ++n;
+    }
+    if (n == needle.cend())
+      return first;
+    if (match == last)
+      return last;
+    ++first;
   }
-  return std::make_pair(first1, first2);
+  return last;
+}
+
+/// std::distance, but uses the iterator's own operator- when it has one.
+/// Our block iterators are only forward iterators, so std::distance would
+/// step through them a byte at a time, but they can subtract in O(1).
+template <typename Iterator>
+auto distance(const Iterator &first, const Iterator &last) {
+  return detail::distance(first, last, detail::priority<1>());
 }
 
-/// @return first position where two ranges differ
-template <typename iter1, typename iter2,
-          typename value_type1=typename iter1::value_type, typename value_type2=typename iter2::value_type,
-          typename predicate=std::function<bool(value_type1, value_type2)>>
-std::pair<iter1, iter2> mismatch(iter1 first1, iter1, iter2 last1, iter2 first2, iter2 last2, predicate pred) {
-    while ( (first1!=last1) && (first2!=last2) && (pred(*first1, *first2)) )
-        { ++first1; ++first2; }
-    return std::make_pair(first1,first2);
+/// std::advance, but uses the iterator's own operator+= when it has one, so
+/// block iterators can skip whole blocks
+template <typename Iterator, typename Distance>
+void advance(Iterator &i, Distance n) {
+  detail::advance(i, n, detail::priority<1>());
+}
+
+namespace detail {
+constexpr char http[] = "http";
+constexpr char protocol[] = "://";
 }
 
 /// @returns true if the path/url between 'start' and 'end' is relative
 template <typename Iterator>
-bool is_relative(Iterator start, const Iterator& end) {
+constexpr bool is_relative(Iterator start, const Iterator& end) {
     if (start == end)
         return false; // Empty path counts as '/'
     if (*start == '/')
         return false; // Absolute path
     // Check http and friends
-    std::string http{"http"};
-    auto match = utils::mismatch(http.cbegin(), http.cend(), start, end);
-    if (match.first == http.cend()) {
+    const char *http = detail::http;
+    const char *httpEnd = http + sizeof(detail::http) - 1;
+    auto match = utils::mismatch(http, httpEnd, start, end);
+    if ((match.first == httpEnd) && (match.second != end)) {
         // Check http:// and https://
         auto checkStart = match.second;
         if (*checkStart == 's')
             ++checkStart;
-        std::string protocol{"://"};
-        auto match = utils::mismatch(protocol.cbegin(), protocol.cend(), checkStart, end);
-        if (match.first == protocol.cend())
+        const char *protocol = detail::protocol;
+        const char *protocolEnd = protocol + sizeof(detail::protocol) - 1;
+        if (utils::mismatch(protocol, protocolEnd, checkStart, end).first == protocolEnd)
             return false;
     }
     return true;
 }
-
 }
 }